@@ -0,0 +1,94 @@
+#include "AllocCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local uint64_t t_allocations = 0;
+std::atomic<uint64_t> g_allocations{0};
+
+void* countedAlloc(size_t size) noexcept {
+    ++t_allocations;
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* countedAlloc(size_t size, std::align_val_t alignment) noexcept {
+    ++t_allocations;
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    // aligned_alloc() wants a multiple of the alignment
+    const auto align = static_cast<size_t>(alignment);
+    const size_t rounded = (size + align - 1) / align * align;
+    return std::aligned_alloc(align, rounded == 0 ? align : rounded);
+}
+
+void* orThrow(void* p) {
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+} // namespace
+
+namespace hayai::bench {
+
+uint64_t threadAllocations() { return t_allocations; }
+
+uint64_t totalAllocations() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+} // namespace hayai::bench
+
+// Everything from malloc()/aligned_alloc() goes back through free()
+void* operator new(size_t size) { return orThrow(countedAlloc(size)); }
+void* operator new[](size_t size) { return orThrow(countedAlloc(size)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+    return orThrow(countedAlloc(size, alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return orThrow(countedAlloc(size, alignment));
+}
+void* operator new(size_t size, std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept {
+    return countedAlloc(size, alignment);
+}
+void* operator new[](size_t size, std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept {
+    return countedAlloc(size, alignment);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+    std::free(p);
+}
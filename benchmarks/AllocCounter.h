@@ -0,0 +1,21 @@
+#pragma once
+
+/**
+ * AllocCounter - counts global heap allocations for the benchmarks.
+ *
+ * Linking AllocCounter.cc into a benchmark replaces the whole set of
+ * global operator new / delete (plain, array, nothrow, sized and aligned
+ * forms), so every allocation is counted no matter which form it came
+ * through. Each call to an operator new counts once, for the calling
+ * thread and for the process.
+ */
+#include <cstdint>
+
+namespace hayai::bench {
+
+// operator new calls made by the calling thread so far
+uint64_t threadAllocations();
+// operator new calls made by every thread so far
+uint64_t totalAllocations();
+
+} // namespace hayai::bench
@@ -0,0 +1,115 @@
+/**
+ * BufferBench - Buffer append and read throughput from 1KB to 1MB.
+ *
+ * BM_AppendFresh fills a new Buffer in 1KB appends, so every growth step
+ * (allocation plus move of the readable bytes) is on the clock.
+ * BM_AppendReuse appends one payload to a long-lived Buffer and retrieves
+ * it, the steady state of an output or codec buffer.
+ * BM_ReadFdFresh reads the payload from a socketpair into a new Buffer in
+ * 64KB writes, the path a fresh connection's input buffer takes.
+ * BM_StreamPartial appends 16KB reads into a long-lived 256KB buffer and
+ * consumes all but a partial record each time, linear (/0) against ring
+ * (/1): the linear buffer compacts the residue whenever the tail fills,
+ * the ring lets the residue wrap in place.
+ */
+#include "hayai/utils/Buffer.h"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using hayai::Buffer;
+
+void BM_AppendFresh(benchmark::State& state) {
+    const size_t total = static_cast<size_t>(state.range(0));
+    const std::string piece(1024, 'a');
+
+    for (auto _ : state) {
+        Buffer buf;
+        for (size_t n = 0; n < total; n += piece.size()) {
+            buf.append(piece);
+        }
+        benchmark::DoNotOptimize(buf.peek());
+    }
+    state.SetBytesProcessed(state.iterations() * total);
+}
+
+void BM_AppendReuse(benchmark::State& state) {
+    const size_t total = static_cast<size_t>(state.range(0));
+    const std::string payload(total, 'a');
+    Buffer buf;
+
+    for (auto _ : state) {
+        buf.append(payload);
+        benchmark::DoNotOptimize(buf.peek());
+        buf.retrieveAll();
+    }
+    state.SetBytesProcessed(state.iterations() * total);
+}
+
+void BM_ReadFdFresh(benchmark::State& state) {
+    const size_t total = static_cast<size_t>(state.range(0));
+    const std::string chunk(std::min<size_t>(total, 64 * 1024), 'r');
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+    int size = 256 * 1024;
+    ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    ::setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    for (auto _ : state) {
+        Buffer buf;
+        int savedErrno = 0;
+        while (buf.readableBytes() < total) {
+            if (::write(fds[0], chunk.data(), chunk.size()) < 0) {
+                state.SkipWithError("write failed");
+                break;
+            }
+            const size_t target = buf.readableBytes() + chunk.size();
+            while (buf.readableBytes() < target) {
+                if (buf.readFd(fds[1], &savedErrno) <= 0) {
+                    state.SkipWithError("read failed");
+                    break;
+                }
+            }
+        }
+        benchmark::DoNotOptimize(buf.peek());
+    }
+    state.SetBytesProcessed(state.iterations() * total);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+void BM_StreamPartial(benchmark::State& state) {
+    const bool ring = state.range(0) != 0;
+    const size_t residue = static_cast<size_t>(state.range(1));
+    const std::string chunk(16 * 1024, 's');
+    Buffer buf(256 * 1024 - Buffer::kCheapPrepend);
+    if (ring && !buf.makeRing(256 * 1024)) {
+        state.SkipWithError("ring mapping unavailable");
+        return;
+    }
+    buf.append(std::string(residue, 'p'));
+
+    for (auto _ : state) {
+        buf.append(chunk);
+        benchmark::DoNotOptimize(buf.peek());
+        buf.retrieve(chunk.size()); // the partial record stays behind
+    }
+    state.SetBytesProcessed(state.iterations() * chunk.size());
+}
+
+} // namespace
+
+BENCHMARK(BM_AppendFresh)->RangeMultiplier(4)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_AppendReuse)->RangeMultiplier(4)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_ReadFdFresh)->RangeMultiplier(4)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_StreamPartial)->ArgsProduct({{0, 1}, {512, 8 * 1024}});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,102 @@
+/**
+ * ByteScanBench - delimiter search over 64B to 1MB with the match at the
+ * end, so every byte is scanned.
+ *
+ * The Buffer::find* calls (SIMD) run against the scalar versions they
+ * replace: std::search for CRLF and a find_first_of loop for a set.
+ * BM_ResumedLineScan appends a long line in 1KB reads and looks for its
+ * end after each one, with and without resuming from the last offset.
+ */
+#include "hayai/utils/Buffer.h"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <string>
+
+namespace {
+
+using hayai::Buffer;
+
+Buffer filled(size_t size, std::string_view tail) {
+    Buffer buf(size);
+    buf.append(std::string(size - tail.size(), 'a'));
+    buf.append(tail);
+    return buf;
+}
+
+void BM_FindCRLF(benchmark::State& state) {
+    const Buffer buf = filled(static_cast<size_t>(state.range(0)), "\r\n");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(buf.findCRLF());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void BM_FindCRLFSearch(benchmark::State& state) {
+    const Buffer buf = filled(static_cast<size_t>(state.range(0)), "\r\n");
+    static constexpr char kCRLF[] = "\r\n";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            std::search(buf.peek(), buf.peek() + buf.readableBytes(), kCRLF,
+                        kCRLF + 2));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void BM_FindByte(benchmark::State& state) {
+    const Buffer buf = filled(static_cast<size_t>(state.range(0)), "\n");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(buf.findEOL());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void BM_FindAnyOf(benchmark::State& state) {
+    const Buffer buf = filled(static_cast<size_t>(state.range(0)), ";");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(buf.findAnyOf("\r\n;:"));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void BM_FindAnyOfScalar(benchmark::State& state) {
+    const Buffer buf = filled(static_cast<size_t>(state.range(0)), ";");
+    static constexpr std::string_view kSet = "\r\n;:";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            std::find_first_of(buf.peek(), buf.peek() + buf.readableBytes(),
+                               kSet.begin(), kSet.end()));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void BM_ResumedLineScan(benchmark::State& state) {
+    const size_t size = static_cast<size_t>(state.range(0));
+    const bool resume = state.range(1) != 0;
+    const std::string read(1024, 'a');
+
+    for (auto _ : state) {
+        Buffer buf(size);
+        size_t scanned = 0;
+        for (size_t n = 0; n < size; n += read.size()) {
+            buf.append(read);
+            benchmark::DoNotOptimize(buf.findCRLF(resume ? scanned : 0));
+            scanned = buf.readableBytes();
+        }
+        buf.append("\r\n");
+        benchmark::DoNotOptimize(buf.findCRLF(resume ? scanned : 0));
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+} // namespace
+
+BENCHMARK(BM_FindCRLF)->RangeMultiplier(16)->Range(64, 1 << 20);
+BENCHMARK(BM_FindCRLFSearch)->RangeMultiplier(16)->Range(64, 1 << 20);
+BENCHMARK(BM_FindByte)->RangeMultiplier(16)->Range(64, 1 << 20);
+BENCHMARK(BM_FindAnyOf)->RangeMultiplier(16)->Range(64, 1 << 20);
+BENCHMARK(BM_FindAnyOfScalar)->RangeMultiplier(16)->Range(64, 1 << 20);
+BENCHMARK(BM_ResumedLineScan)
+    ->ArgsProduct({{16 << 10, 256 << 10}, {0, 1}})
+    ->ArgNames({"bytes", "resume"});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,109 @@
+/**
+ * ChurnBench - connection churn cost on one EventLoop.
+ *
+ * With N long-lived connections already registered, repeatedly create a
+ * TcpConnection, establish it, run one loop round (so its registration
+ * reaches the kernel) and tear it down again. This is the per-connection
+ * work of the accept/close path minus the TCP handshake.
+ *
+ * pooled:1 creates the connection with TcpConnection::create() (the
+ * loop's SlabPool, as TcpServer does), pooled:0 with make_shared. The
+ * threads:4 runs churn on four loops at once, where every global-heap
+ * allocation competes with the other threads. Global operator new is
+ * counted per thread: allocs/conn is the heap traffic left per connection.
+ */
+#include "AllocCounter.h"
+#include "hayai/net/Channel.h"
+#include "hayai/net/EventLoop.h"
+#include "hayai/net/TcpConnection.h"
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using hayai::Channel;
+using hayai::EventLoop;
+using hayai::InetAddress;
+using hayai::TcpConnection;
+using hayai::TcpConnectionPtr;
+using hayai::bench::threadAllocations;
+
+void BM_ConnectionChurn(benchmark::State& state) {
+    const int background = static_cast<int>(state.range(0));
+    const bool pooled = state.range(1) != 0;
+
+    EventLoop loop;
+    std::vector<int> idleFds;
+    std::vector<std::unique_ptr<Channel>> idle;
+    for (int i = 0; i < background; ++i) {
+        int fds[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) < 0) {
+            state.SkipWithError("socketpair failed (raise ulimit -n)");
+            break;
+        }
+        idleFds.push_back(fds[0]);
+        idleFds.push_back(fds[1]);
+        idle.push_back(std::make_unique<Channel>(&loop, fds[0]));
+        idle.back()->enableReading();
+    }
+
+    // Always-writable channel so each loop round returns immediately
+    int kick[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, kick);
+    Channel kicker(&loop, kick[0]);
+    kicker.setWriteCallback([&loop] { loop.quit(); });
+    kicker.enableWriting();
+
+    const uint64_t allocsBefore = threadAllocations();
+    for (auto _ : state) {
+        int fds[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) < 0) {
+            state.SkipWithError("socketpair failed");
+            break;
+        }
+        auto conn = pooled ? TcpConnection::create(&loop, "churn", fds[0],
+                                                   InetAddress(), InetAddress())
+                           : std::make_shared<TcpConnection>(
+                                 &loop, "churn", fds[0], InetAddress(),
+                                 InetAddress());
+        conn->setCloseCallback([](const TcpConnectionPtr&) {});
+        conn->connectEstablished();
+        loop.loop();
+        conn->connectDestroyed();
+        conn.reset();
+        ::close(fds[1]);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["allocs/conn"] = benchmark::Counter(
+        static_cast<double>(threadAllocations() - allocsBefore) /
+        static_cast<double>(state.iterations()),
+        benchmark::Counter::kAvgThreads);
+
+    kicker.disableAll();
+    kicker.remove();
+    ::close(kick[0]);
+    ::close(kick[1]);
+    for (auto& ch : idle) {
+        ch->disableAll();
+        ch->remove();
+    }
+    for (int fd : idleFds) {
+        ::close(fd);
+    }
+}
+
+BENCHMARK(BM_ConnectionChurn)
+    ->ArgNames({"background", "pooled"})
+    ->ArgsProduct({{0, 1000, 8000}, {0, 1}});
+BENCHMARK(BM_ConnectionChurn)
+    ->ArgNames({"background", "pooled"})
+    ->ArgsProduct({{0}, {0, 1}})
+    ->Threads(4)
+    ->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
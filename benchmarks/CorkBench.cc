@@ -0,0 +1,100 @@
+/**
+ * CorkBench - write syscalls per request for a chatty protocol.
+ *
+ * Each request gets a response made of three send() calls (header, body,
+ * trailer), as an HTTP-style handler would issue. The client end of a
+ * socketpair sends a request and waits for the full response. Counters:
+ *   writes/req - write()/writev() calls on the connection per request
+ */
+#include "hayai/net/EventLoop.h"
+#include "hayai/net/EventLoopThread.h"
+#include "hayai/net/TcpConnection.h"
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <future>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using hayai::Buffer;
+using hayai::EventLoop;
+using hayai::EventLoopThread;
+using hayai::InetAddress;
+using hayai::TcpConnection;
+using hayai::TcpConnectionPtr;
+
+constexpr std::string_view kHeader =
+    "HTTP/1.1 200 OK\r\nContent-Length: 64\r\n\r\n";
+constexpr std::string_view kTrailer = "\r\n";
+const std::string kBody(64, 'b');
+
+void BM_ChattyResponse(benchmark::State& state) {
+    const bool corked = state.range(0) != 0;
+
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+    ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    TcpConnectionPtr conn;
+    std::promise<void> ready;
+    loop->runInLoop([&] {
+        conn = std::make_shared<TcpConnection>(loop, "cork", fds[0],
+                                               InetAddress(), InetAddress());
+        conn->setCorked(corked);
+        conn->setMessageCallback([](const TcpConnectionPtr& c, Buffer* buf) {
+            buf->retrieveAll();
+            c->send(kHeader);
+            c->send(kBody);
+            c->send(kTrailer);
+        });
+        conn->setCloseCallback([](const TcpConnectionPtr&) {});
+        conn->connectEstablished();
+        ready.set_value();
+    });
+    ready.get_future().wait();
+
+    const size_t responseSize = kHeader.size() + kBody.size() + kTrailer.size();
+    char reply[512];
+    for (auto _ : state) {
+        if (::write(fds[1], "GET /", 5) != 5) {
+            state.SkipWithError("write failed");
+            break;
+        }
+        size_t got = 0;
+        while (got < responseSize) {
+            ssize_t n = ::read(fds[1], reply, sizeof(reply));
+            if (n <= 0) {
+                state.SkipWithError("read failed");
+                break;
+            }
+            got += n;
+        }
+    }
+
+    std::promise<uint64_t> closed;
+    loop->runInLoop([&] {
+        uint64_t writes = conn->ioStats().writeCalls;
+        conn->connectDestroyed();
+        conn.reset();
+        closed.set_value(writes);
+    });
+    const uint64_t writes = closed.get_future().get();
+    ::close(fds[1]);
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["writes/req"] =
+        static_cast<double>(writes) / static_cast<double>(state.iterations());
+}
+
+BENCHMARK(BM_ChattyResponse)->ArgName("corked")->Arg(0)->Arg(1)->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,66 @@
+/**
+ * CrossThreadBench - cross-thread submit throughput into one EventLoop.
+ *
+ * K producer threads each post kPerProducer functors with queueInLoop()
+ * while the loop runs on the benchmark thread. Reported counters:
+ *   items_per_second - functors executed per second
+ *   wakeups/1k       - wakeup write() syscalls per 1000 posts
+ */
+#include "hayai/net/EventLoop.h"
+#include <benchmark/benchmark.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using hayai::EventLoop;
+
+constexpr int kPerProducer = 100000;
+
+void BM_QueueInLoop(benchmark::State& state) {
+    const int producers = static_cast<int>(state.range(0));
+    const int64_t total = static_cast<int64_t>(producers) * kPerProducer;
+
+    EventLoop loop;
+    int64_t executed = 0;
+    const uint64_t wakeupsBefore = loop.wakeupWrites();
+
+    for (auto _ : state) {
+        executed = 0;
+        std::vector<std::thread> threads;
+        threads.reserve(producers);
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&] {
+                for (int i = 0; i < kPerProducer; ++i) {
+                    loop.queueInLoop([&] {
+                        if (++executed == total) {
+                            loop.quit();
+                        }
+                    });
+                }
+            });
+        }
+        loop.loop();
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+    const double posts = static_cast<double>(total * state.iterations());
+    state.SetItemsProcessed(total * state.iterations());
+    state.counters["wakeups/1k"] =
+        static_cast<double>(loop.wakeupWrites() - wakeupsBefore) * 1000.0 /
+        posts;
+}
+
+BENCHMARK(BM_QueueInLoop)
+    ->ArgName("producers")
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
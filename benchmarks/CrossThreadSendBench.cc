@@ -0,0 +1,119 @@
+/**
+ * CrossThreadSendBench - bytes/sec of TcpConnection::send() from a worker.
+ *
+ * The benchmark thread plays the worker: it builds each response as a
+ * fresh std::string and sends it to a connection owned by an
+ * EventLoopThread, while a reader thread drains the peer end of the
+ * socketpair. At most kWindow bytes are in flight.
+ *
+ *   BM_SendCopy - send(std::string_view): copied into the task, and what
+ *                 the socket doesn't take is copied again into the queue
+ *   BM_SendMove - send(std::string&&): moved all the way to the queue
+ */
+#include "hayai/net/EventLoop.h"
+#include "hayai/net/EventLoopThread.h"
+#include "hayai/net/TcpConnection.h"
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <future>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using hayai::Buffer;
+using hayai::EventLoop;
+using hayai::EventLoopThread;
+using hayai::InetAddress;
+using hayai::TcpConnection;
+using hayai::TcpConnectionPtr;
+
+constexpr size_t kWindow = 16 * 1024 * 1024;
+
+template <bool kMove>
+void BM_CrossThreadSend(benchmark::State& state) {
+    const size_t size = static_cast<size_t>(state.range(0));
+
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+    ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    TcpConnectionPtr conn;
+    std::promise<void> ready;
+    loop->runInLoop([&] {
+        conn = std::make_shared<TcpConnection>(loop, "send", fds[0],
+                                               InetAddress(), InetAddress());
+        conn->setMessageCallback([](const TcpConnectionPtr&, Buffer*) {});
+        conn->setCloseCallback([](const TcpConnectionPtr&) {});
+        conn->connectEstablished();
+        ready.set_value();
+    });
+    ready.get_future().wait();
+
+    std::atomic<size_t> received{0};
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        char buf[256 * 1024];
+        while (!done.load(std::memory_order_acquire)) {
+            ssize_t n = ::read(fds[1], buf, sizeof(buf));
+            if (n <= 0) {
+                break;
+            }
+            received.fetch_add(n, std::memory_order_release);
+        }
+    });
+
+    size_t sent = 0;
+    for (auto _ : state) {
+        while (sent - received.load(std::memory_order_acquire) > kWindow) {
+            std::this_thread::yield();
+        }
+        std::string response(size, 'x'); // built by the worker
+        if constexpr (kMove) {
+            conn->send(std::move(response));
+        } else {
+            conn->send(std::string_view(response));
+        }
+        sent += size;
+    }
+    while (received.load(std::memory_order_acquire) < sent) {
+        std::this_thread::yield();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(sent));
+
+    done.store(true, std::memory_order_release);
+    std::promise<void> closed;
+    loop->runInLoop([&] {
+        conn->connectDestroyed();
+        conn.reset();
+        closed.set_value();
+    });
+    closed.get_future().wait();
+    ::shutdown(fds[1], SHUT_RDWR);
+    reader.join();
+    ::close(fds[1]);
+}
+
+BENCHMARK_TEMPLATE(BM_CrossThreadSend, false)
+    ->Name("BM_SendCopy")
+    ->RangeMultiplier(16)
+    ->Range(4096, 1 << 20)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_CrossThreadSend, true)
+    ->Name("BM_SendMove")
+    ->RangeMultiplier(16)
+    ->Range(4096, 1 << 20)
+    ->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
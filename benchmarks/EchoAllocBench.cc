@@ -0,0 +1,167 @@
+/**
+ * EchoAllocBench - heap allocations per echo request.
+ *
+ * A TcpConnection on an EventLoopThread echoes every message back; the
+ * benchmark thread writes a request into the peer end of a socketpair and
+ * blocks until the reply arrives. Global operator new is counted, so the
+ * reported counter covers the loop thread's whole request path:
+ *   allocs/req - operator new calls per request (0 in steady state)
+ *
+ * BM_CrossThreadSend posts the reply with send() from a foreign thread
+ * instead, which queues a task on the loop (one queue node per send, plus
+ * the message copy once it outgrows the small-string buffer).
+ */
+#include "AllocCounter.h"
+#include "hayai/net/EventLoop.h"
+#include "hayai/net/EventLoopThread.h"
+#include "hayai/net/TcpConnection.h"
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <future>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using hayai::Buffer;
+using hayai::EventLoop;
+using hayai::EventLoopThread;
+using hayai::InetAddress;
+using hayai::TcpConnection;
+using hayai::TcpConnectionPtr;
+using hayai::bench::totalAllocations;
+
+struct EchoFixture {
+    EventLoopThread thread;
+    EventLoop* loop{nullptr};
+    TcpConnectionPtr conn;
+    int fds[2]{-1, -1};
+
+    bool open(TcpConnection::MessageCallback onMessage) {
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+            return false;
+        }
+        // Only the loop side is non-blocking; the client end blocks
+        ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        loop = thread.startLoop();
+
+        std::promise<void> ready;
+        loop->runInLoop([&] {
+            conn = std::make_shared<TcpConnection>(loop, "echo", fds[0],
+                                                   InetAddress(), InetAddress());
+            conn->setMessageCallback(std::move(onMessage));
+            conn->setCloseCallback([](const TcpConnectionPtr&) {});
+            conn->connectEstablished();
+            ready.set_value();
+        });
+        ready.get_future().wait();
+        return true;
+    }
+
+    void close() {
+        std::promise<void> done;
+        loop->runInLoop([&] {
+            conn->connectDestroyed();
+            conn.reset();
+            done.set_value();
+        });
+        done.get_future().wait();
+        ::close(fds[1]);
+    }
+
+    // One request/response round trip from the client end
+    bool roundTrip(const std::string& request, std::string& reply) {
+        if (::write(fds[1], request.data(), request.size()) !=
+            static_cast<ssize_t>(request.size())) {
+            return false;
+        }
+        size_t got = 0;
+        while (got < request.size()) {
+            ssize_t n = ::read(fds[1], reply.data() + got, reply.size() - got);
+            if (n <= 0) {
+                return false;
+            }
+            got += n;
+        }
+        return true;
+    }
+};
+
+void runRequests(benchmark::State& state, EchoFixture& fx) {
+    const std::string request(static_cast<size_t>(state.range(0)), 'r');
+    std::string reply(request.size(), '\0');
+
+    // Warm up buffers so growth is not counted as steady state
+    for (int i = 0; i < 16; ++i) {
+        fx.roundTrip(request, reply);
+    }
+
+    const uint64_t before = totalAllocations();
+    for (auto _ : state) {
+        if (!fx.roundTrip(request, reply)) {
+            state.SkipWithError("echo failed");
+            break;
+        }
+    }
+    const uint64_t allocs = totalAllocations() - before;
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["allocs/req"] =
+        static_cast<double>(allocs) / static_cast<double>(state.iterations());
+}
+
+void BM_EchoRequest(benchmark::State& state) {
+    EchoFixture fx;
+    bool ok = fx.open([](const TcpConnectionPtr& conn, Buffer* buf) {
+        conn->send(std::string_view(buf->peek(), buf->readableBytes()));
+        buf->retrieveAll();
+    });
+    if (!ok) {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+    runRequests(state, fx);
+    fx.close();
+}
+
+void BM_CrossThreadSend(benchmark::State& state) {
+    EchoFixture fx;
+    bool ok = fx.open(
+        [](const TcpConnectionPtr&, Buffer* buf) { buf->retrieveAll(); });
+    if (!ok) {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+
+    const std::string request(static_cast<size_t>(state.range(0)), 'r');
+    std::string reply(request.size(), '\0');
+    const uint64_t before = totalAllocations();
+    for (auto _ : state) {
+        // Reply is sent from this thread instead of the loop thread
+        fx.conn->send(request);
+        size_t got = 0;
+        while (got < request.size()) {
+            ssize_t n =
+                ::read(fx.fds[1], reply.data() + got, reply.size() - got);
+            if (n <= 0) {
+                state.SkipWithError("read failed");
+                break;
+            }
+            got += n;
+        }
+    }
+    const uint64_t allocs = totalAllocations() - before;
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["allocs/req"] =
+        static_cast<double>(allocs) / static_cast<double>(state.iterations());
+    fx.close();
+}
+
+BENCHMARK(BM_EchoRequest)->ArgName("bytes")->Arg(8)->Arg(64)->Arg(4096);
+BENCHMARK(BM_CrossThreadSend)->ArgName("bytes")->Arg(8)->Arg(64)->Arg(4096);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,95 @@
+/**
+ * EdgeTriggeredBench - syscalls per MB received, level vs edge triggered.
+ *
+ * A writer thread streams a payload into a socketpair; the loop side is a
+ * TcpConnection in either mode. Reported counters:
+ *   reads/MB  - readv() calls per MB
+ *   polls/MB  - poll round-trips (EventLoop iterations) per MB
+ *   syscalls/MB = reads/MB + polls/MB
+ */
+#include "hayai/net/EventLoop.h"
+#include "hayai/net/TcpConnection.h"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using hayai::Buffer;
+using hayai::EventLoop;
+using hayai::InetAddress;
+using hayai::TcpConnection;
+using hayai::TcpConnectionPtr;
+
+constexpr size_t kPayload = 8 * 1024 * 1024;
+
+void BM_ReceiveStream(benchmark::State& state) {
+    const bool edge = state.range(0) != 0;
+
+    EventLoop loop;
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+    ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    auto conn = std::make_shared<TcpConnection>(&loop, "bench", fds[0],
+                                                InetAddress(), InetAddress());
+    conn->setEdgeTriggered(edge);
+
+    size_t received = 0;
+    conn->setMessageCallback([&](const TcpConnectionPtr&, Buffer* buf) {
+        received += buf->readableBytes();
+        buf->retrieveAll();
+        if (received >= kPayload) {
+            loop.quit();
+        }
+    });
+    conn->setCloseCallback([](const TcpConnectionPtr&) {});
+    conn->connectEstablished();
+
+    const std::string chunk(64 * 1024, 'x');
+    uint64_t polls = 0;
+
+    for (auto _ : state) {
+        received = 0;
+        std::thread writer([&] {
+            for (size_t sent = 0; sent < kPayload;) {
+                ssize_t n = ::write(fds[1], chunk.data(),
+                                    std::min(chunk.size(), kPayload - sent));
+                if (n <= 0) {
+                    break;
+                }
+                sent += n;
+            }
+        });
+
+        const uint64_t before = loop.iteration();
+        loop.loop();
+        polls += loop.iteration() - before;
+        writer.join();
+    }
+
+    const double mb = static_cast<double>(kPayload) / (1024 * 1024) *
+                      static_cast<double>(state.iterations());
+    const double reads = static_cast<double>(conn->ioStats().readCalls);
+    state.SetBytesProcessed(static_cast<int64_t>(kPayload) *
+                            state.iterations());
+    state.counters["reads/MB"] = reads / mb;
+    state.counters["polls/MB"] = static_cast<double>(polls) / mb;
+    state.counters["syscalls/MB"] = (reads + static_cast<double>(polls)) / mb;
+
+    ::close(fds[1]);
+    conn->connectDestroyed();
+}
+
+BENCHMARK(BM_ReceiveStream)->ArgName("edge")->Arg(0)->Arg(1)->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,141 @@
+/**
+ * FanoutBench - one payload sent to many connections across I/O loops.
+ *
+ * The benchmark thread plays a publisher: each iteration fans a 16KB
+ * payload out to every connection, spread over kLoops EventLoopThreads,
+ * while a reader thread drains the peer ends of the socketpairs. Each
+ * iteration waits until every peer has the payload.
+ *
+ *   BM_FanoutCopy  - send(std::string_view) per connection: one copy and
+ *                    one cross-thread post per connection
+ *   BM_FanoutSlice - TcpServer::broadcast() of a SharedSlice: one
+ *                    cross-thread post per loop, bytes never copied
+ */
+#include "hayai/net/EventLoop.h"
+#include "hayai/net/EventLoopThread.h"
+#include "hayai/net/TcpConnection.h"
+#include "hayai/net/TcpServer.h"
+#include "hayai/utils/SharedSlice.h"
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <future>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using hayai::Buffer;
+using hayai::EventLoop;
+using hayai::EventLoopThread;
+using hayai::InetAddress;
+using hayai::SharedSlice;
+using hayai::TcpConnection;
+using hayai::TcpConnectionPtr;
+using hayai::TcpServer;
+
+constexpr int kLoops = 4;
+constexpr size_t kPayload = 16 * 1024;
+
+template <bool kSlice>
+void BM_Fanout(benchmark::State& state) {
+    const int conns = static_cast<int>(state.range(0));
+
+    std::vector<std::unique_ptr<EventLoopThread>> threads;
+    std::vector<EventLoop*> loops;
+    for (int i = 0; i < kLoops; ++i) {
+        threads.push_back(std::make_unique<EventLoopThread>());
+        loops.push_back(threads.back()->startLoop());
+    }
+
+    std::vector<TcpConnectionPtr> connections(conns);
+    std::vector<int> peers;
+    for (int i = 0; i < conns; ++i) {
+        int fds[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+            state.SkipWithError("socketpair failed");
+            return;
+        }
+        ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        ::fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        peers.push_back(fds[1]);
+
+        EventLoop* loop = loops[i % kLoops];
+        std::promise<void> ready;
+        loop->runInLoop([&, loop, i, fd = fds[0]] {
+            auto conn = std::make_shared<TcpConnection>(
+                loop, "fanout", fd, InetAddress(), InetAddress());
+            conn->setMessageCallback([](const TcpConnectionPtr&, Buffer*) {});
+            conn->setCloseCallback([](const TcpConnectionPtr&) {});
+            conn->connectEstablished();
+            connections[i] = std::move(conn);
+            ready.set_value();
+        });
+        ready.get_future().wait();
+    }
+
+    std::atomic<size_t> received{0};
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        char buf[64 * 1024];
+        while (!done.load(std::memory_order_acquire)) {
+            for (int fd : peers) {
+                ssize_t n;
+                while ((n = ::read(fd, buf, sizeof(buf))) > 0) {
+                    received.fetch_add(n, std::memory_order_release);
+                }
+            }
+        }
+    });
+
+    const std::string payload(kPayload, 'p');
+    size_t sent = 0;
+    for (auto _ : state) {
+        if constexpr (kSlice) {
+            TcpServer::broadcast(connections, SharedSlice::copyOf(payload));
+        } else {
+            for (const auto& conn : connections) {
+                conn->send(std::string_view(payload));
+            }
+        }
+        sent += kPayload * conns;
+        while (received.load(std::memory_order_acquire) < sent) {
+            std::this_thread::yield();
+        }
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(sent));
+    state.SetItemsProcessed(state.iterations() * conns);
+
+    done.store(true, std::memory_order_release);
+    reader.join();
+    for (int i = 0; i < conns; ++i) {
+        std::promise<void> closed;
+        connections[i]->getLoop()->runInLoop([&] {
+            connections[i]->connectDestroyed();
+            connections[i].reset();
+            closed.set_value();
+        });
+        closed.get_future().wait();
+        ::close(peers[i]);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Fanout, false)
+    ->Name("BM_FanoutCopy")
+    ->Arg(64)
+    ->Arg(512)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Fanout, true)
+    ->Name("BM_FanoutSlice")
+    ->Arg(64)
+    ->Arg(512)
+    ->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
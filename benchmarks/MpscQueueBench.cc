@@ -0,0 +1,128 @@
+/**
+ * MpscQueueBench - EventLoop task queue: lock-free MPSC vs mutex + vector.
+ *
+ * MutexQueue reproduces the previous EventLoop::pendingFunctors_ (push
+ * under a std::mutex, consumer swaps the vector out). Both queues carry
+ * std::function<void()> and are driven the same way: K producer threads
+ * push, one consumer drains in batches and runs the tasks.
+ */
+#include "hayai/utils/MpscQueue.h"
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Functor = std::function<void()>;
+
+constexpr int kPerProducer = 200000;
+
+class MutexQueue {
+  public:
+    void push(Functor f) {
+        std::scoped_lock lock(mutex_);
+        pending_.push_back(std::move(f));
+    }
+
+    size_t drain() {
+        std::vector<Functor> batch;
+        {
+            std::scoped_lock lock(mutex_);
+            batch.swap(pending_);
+        }
+        for (auto& f : batch) {
+            f();
+        }
+        return batch.size();
+    }
+
+  private:
+    std::mutex mutex_;
+    std::vector<Functor> pending_;
+};
+
+class LockFreeQueue {
+  public:
+    ~LockFreeQueue() {
+        while (Task* t = queue_.pop()) {
+            delete t;
+        }
+    }
+
+    void push(Functor f) { queue_.push(new Task(std::move(f))); }
+
+    size_t drain() {
+        size_t n = 0;
+        while (Task* t = queue_.pop()) {
+            t->fn();
+            delete t;
+            ++n;
+        }
+        return n;
+    }
+
+  private:
+    struct Task : hayai::MpscNode {
+        explicit Task(Functor f) : fn(std::move(f)) {}
+        Functor fn;
+    };
+    hayai::MpscQueue<Task> queue_;
+};
+
+template <typename Queue>
+void BM_Queue(benchmark::State& state) {
+    const int producers = static_cast<int>(state.range(0));
+    const size_t total = static_cast<size_t>(producers) * kPerProducer;
+
+    for (auto _ : state) {
+        Queue queue;
+        uint64_t sum = 0;
+        std::atomic<bool> go{false};
+
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&] {
+                while (!go.load(std::memory_order_acquire)) {
+                }
+                for (int i = 0; i < kPerProducer; ++i) {
+                    queue.push([&sum] { ++sum; });
+                }
+            });
+        }
+
+        go.store(true, std::memory_order_release);
+        size_t consumed = 0;
+        while (consumed < total) {
+            size_t n = queue.drain();
+            if (n == 0) {
+                std::this_thread::yield();
+            }
+            consumed += n;
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(total) * state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_Queue, MutexQueue)
+    ->ArgName("producers")
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Queue, LockFreeQueue)
+    ->ArgName("producers")
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(8)
+    ->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
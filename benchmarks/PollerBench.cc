@@ -0,0 +1,99 @@
+/**
+ * PollerBench - events/sec delivered by the Poller backend.
+ *
+ * Registers N idle + M active fds on one EventLoop. Active fds are kept
+ * permanently readable (level-triggered, never drained), so every poll
+ * round reports exactly M events regardless of N. A backend that scales
+ * with ready fds rather than watched fds keeps a flat events/sec as N grows.
+ *
+ *   ./PollerBench --benchmark_counters_tabular=true
+ *   HAYAI_USE_IO_URING=1 ./PollerBench      # io_uring backend (Linux)
+ */
+#include "hayai/net/Channel.h"
+#include "hayai/net/EventLoop.h"
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using hayai::Channel;
+using hayai::EventLoop;
+
+struct PollerFixture {
+    PollerFixture(EventLoop* loop, int idle, int active) {
+        const int total = idle + active;
+        for (int i = 0; i < total; ++i) {
+            int fds[2];
+            if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+                ok = false; // most likely RLIMIT_NOFILE
+                return;
+            }
+            pairs.push_back({fds[0], fds[1]});
+
+            auto ch = std::make_unique<Channel>(loop, fds[0]);
+            ch->setReadCallback([this] { ++handled; });
+            ch->enableReading();
+            channels.push_back(std::move(ch));
+
+            if (i >= idle) {
+                char c = 'x';
+                ::write(fds[1], &c, 1);
+            }
+        }
+    }
+
+    ~PollerFixture() {
+        for (auto& ch : channels) {
+            ch->disableAll();
+            ch->remove();
+        }
+        for (auto [a, b] : pairs) {
+            ::close(a);
+            ::close(b);
+        }
+    }
+
+    std::vector<std::pair<int, int>> pairs;
+    std::vector<std::unique_ptr<Channel>> channels;
+    int64_t handled{0};
+    bool ok{true};
+};
+
+// One iteration == one EventLoop round (poll + dispatch + pending functors)
+void BM_PollIdleActive(benchmark::State& state) {
+    const int idle = static_cast<int>(state.range(0));
+    const int active = static_cast<int>(state.range(1));
+
+    EventLoop loop;
+    PollerFixture fixture(&loop, idle, active);
+    if (!fixture.ok) {
+        state.SkipWithError("socketpair failed (raise ulimit -n)");
+        return;
+    }
+
+    for (auto _ : state) {
+        loop.queueInLoop([&loop] { loop.quit(); });
+        loop.loop();
+    }
+
+    state.SetItemsProcessed(fixture.handled);
+    state.counters["events/s"] = benchmark::Counter(
+        static_cast<double>(fixture.handled), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_PollIdleActive)
+    ->ArgNames({"idle", "active"})
+    ->Args({0, 1})
+    ->Args({0, 64})
+    ->Args({1000, 1})
+    ->Args({1000, 64})
+    ->Args({8000, 1})
+    ->Args({8000, 64})
+    ->Args({8000, 512});
+
+} // namespace
+
+BENCHMARK_MAIN();
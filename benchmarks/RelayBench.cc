@@ -0,0 +1,150 @@
+/**
+ * RelayBench - loop CPU per GB for an L4 relay between two connections.
+ *
+ * Two connections on an EventLoopThread relay left -> right: the
+ * benchmark thread writes into the left socketpair, a reader thread
+ * drains the right one. loop_cpu_ms_per_GB is the loop thread's CPU
+ * time per GB relayed.
+ *
+ *   BM_RelayCopy   - message callback: read() into the input Buffer, then
+ *                    send() to the other side (copied again when the
+ *                    socket is full); backpressure via the water marks
+ *   BM_RelaySplice - relayTo(): splice() socket -> pipe -> socket
+ */
+#include "hayai/net/EventLoop.h"
+#include "hayai/net/EventLoopThread.h"
+#include "hayai/net/TcpConnection.h"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <ctime>
+#include <fcntl.h>
+#include <future>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using hayai::Buffer;
+using hayai::EventLoop;
+using hayai::EventLoopThread;
+using hayai::InetAddress;
+using hayai::TcpConnection;
+using hayai::TcpConnectionPtr;
+
+double threadCpuMs() {
+    timespec ts{};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+template <bool kSplice>
+void BM_Relay(benchmark::State& state) {
+    const size_t size = static_cast<size_t>(state.range(0));
+
+    int left[2];
+    int right[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, left) < 0 ||
+        ::socketpair(AF_UNIX, SOCK_STREAM, 0, right) < 0) {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+    for (int fd : {left[0], right[0]}) {
+        ::fcntl(fd, F_SETFL, O_NONBLOCK);
+    }
+
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    TcpConnectionPtr a;
+    TcpConnectionPtr b;
+    bool spliced = false;
+    std::promise<double> ready;
+    loop->runInLoop([&] {
+        a = std::make_shared<TcpConnection>(loop, "left", left[0],
+                                            InetAddress(), InetAddress());
+        b = std::make_shared<TcpConnection>(loop, "right", right[0],
+                                            InetAddress(), InetAddress());
+        a->setMessageCallback([&b](const TcpConnectionPtr&, Buffer* buf) {
+            b->send(std::string_view(buf->peek(), buf->readableBytes()));
+            buf->retrieveAll();
+        });
+        b->setMessageCallback([](const TcpConnectionPtr&, Buffer*) {});
+        b->setWaterMarks(1024 * 1024, 256 * 1024);
+        b->setThrottleUpstream(a);
+        for (auto* c : {&a, &b}) {
+            (*c)->setCloseCallback([](const TcpConnectionPtr&) {});
+            (*c)->connectEstablished();
+        }
+        spliced = kSplice && a->relayTo(b);
+        ready.set_value(threadCpuMs());
+    });
+    const double cpuStart = ready.get_future().get();
+    if (kSplice && !spliced) {
+        state.SkipWithError("splice() relay not supported");
+    }
+
+    std::atomic<size_t> received{0};
+    std::thread reader([&] {
+        char buf[256 * 1024];
+        ssize_t n;
+        while ((n = ::read(right[1], buf, sizeof(buf))) > 0) {
+            received.fetch_add(n, std::memory_order_release);
+        }
+    });
+
+    const std::string chunk(size, 'x');
+    size_t sent = 0;
+    for (auto _ : state) {
+        // Blocking write: the relay's backpressure paces us
+        size_t off = 0;
+        while (off < size) {
+            ssize_t n = ::write(left[1], chunk.data() + off, size - off);
+            if (n <= 0) {
+                break;
+            }
+            off += n;
+        }
+        sent += off;
+    }
+    while (received.load(std::memory_order_acquire) < sent) {
+        std::this_thread::yield();
+    }
+
+    std::promise<double> finished;
+    loop->runInLoop([&] { finished.set_value(threadCpuMs()); });
+    const double cpuMs = finished.get_future().get() - cpuStart;
+    state.SetBytesProcessed(static_cast<int64_t>(sent));
+    if (sent > 0) {
+        state.counters["loop_cpu_ms_per_GB"] = cpuMs * 1e9 / sent;
+    }
+
+    std::promise<void> closed;
+    loop->runInLoop([&] {
+        a->connectDestroyed();
+        b->connectDestroyed();
+        a.reset();
+        b.reset();
+        closed.set_value();
+    });
+    closed.get_future().wait();
+    ::shutdown(right[1], SHUT_RDWR);
+    reader.join();
+    ::close(left[1]);
+    ::close(right[1]);
+}
+
+BENCHMARK_TEMPLATE(BM_Relay, false)
+    ->Name("BM_RelayCopy")
+    ->RangeMultiplier(16)
+    ->Range(16 * 1024, 1 << 20)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Relay, true)
+    ->Name("BM_RelaySplice")
+    ->RangeMultiplier(16)
+    ->Range(16 * 1024, 1 << 20)
+    ->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,131 @@
+/**
+ * SendFileBench - bytes/sec of serving a file range over a TcpConnection.
+ *
+ * The connection lives on an EventLoopThread; each iteration asks the
+ * loop to serve the whole file while a reader thread drains the peer end
+ * of the socketpair. At most kWindow bytes are in flight.
+ *
+ *   BM_ReadAndSend - pread() into a string, then send(std::string&&): the bytes
+ *                    are copied kernel -> user -> kernel
+ *   BM_SendFile    - sendFile(): sendfile() moves them inside the kernel
+ */
+#include "hayai/net/EventLoop.h"
+#include "hayai/net/EventLoopThread.h"
+#include "hayai/net/TcpConnection.h"
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <fcntl.h>
+#include <future>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using hayai::Buffer;
+using hayai::EventLoop;
+using hayai::EventLoopThread;
+using hayai::InetAddress;
+using hayai::TcpConnection;
+using hayai::TcpConnectionPtr;
+
+constexpr size_t kWindow = 16 * 1024 * 1024;
+
+template <bool kSendFile>
+void BM_ServeFile(benchmark::State& state) {
+    const size_t size = static_cast<size_t>(state.range(0));
+
+    std::FILE* file = std::tmpfile();
+    int fds[2];
+    if (file == nullptr || ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        state.SkipWithError("setup failed");
+        return;
+    }
+    const int fileFd = ::fileno(file);
+    const std::string content(size, 'f');
+    if (::write(fileFd, content.data(), size) != static_cast<ssize_t>(size)) {
+        state.SkipWithError("write failed");
+        return;
+    }
+    ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    TcpConnectionPtr conn;
+    std::promise<void> ready;
+    loop->runInLoop([&] {
+        conn = std::make_shared<TcpConnection>(loop, "file", fds[0],
+                                               InetAddress(), InetAddress());
+        conn->setMessageCallback([](const TcpConnectionPtr&, Buffer*) {});
+        conn->setCloseCallback([](const TcpConnectionPtr&) {});
+        conn->connectEstablished();
+        ready.set_value();
+    });
+    ready.get_future().wait();
+
+    std::atomic<size_t> received{0};
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        char buf[256 * 1024];
+        while (!done.load(std::memory_order_acquire)) {
+            ssize_t n = ::read(fds[1], buf, sizeof(buf));
+            if (n <= 0) {
+                break;
+            }
+            received.fetch_add(n, std::memory_order_release);
+        }
+    });
+
+    size_t sent = 0;
+    for (auto _ : state) {
+        while (sent - received.load(std::memory_order_acquire) > kWindow) {
+            std::this_thread::yield();
+        }
+        loop->runInLoop([&conn, fileFd, size] {
+            if constexpr (kSendFile) {
+                conn->sendFile(fileFd, 0, size);
+            } else {
+                std::string body(size, '\0');
+                ssize_t n = ::pread(fileFd, body.data(), size, 0);
+                body.resize(n > 0 ? static_cast<size_t>(n) : 0);
+                conn->send(std::move(body));
+            }
+        });
+        sent += size;
+    }
+    while (received.load(std::memory_order_acquire) < sent) {
+        std::this_thread::yield();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(sent));
+
+    done.store(true, std::memory_order_release);
+    std::promise<void> closed;
+    loop->runInLoop([&] {
+        conn->connectDestroyed();
+        conn.reset();
+        closed.set_value();
+    });
+    closed.get_future().wait();
+    ::shutdown(fds[1], SHUT_RDWR);
+    reader.join();
+    ::close(fds[1]);
+    std::fclose(file);
+}
+
+BENCHMARK_TEMPLATE(BM_ServeFile, false)
+    ->Name("BM_ReadAndSend")
+    ->RangeMultiplier(16)
+    ->Range(64 * 1024, 16 << 20)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ServeFile, true)
+    ->Name("BM_SendFile")
+    ->RangeMultiplier(16)
+    ->Range(64 * 1024, 16 << 20)
+    ->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -1,11 +1,13 @@
 #pragma once
 #include "hayai/coro/Task.h"
+#include "hayai/net/LengthFieldCodec.h"
 #include "hayai/net/TcpConnection.h"
 #include "hayai/utils/Buffer.h"
 #include <coroutine>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <string_view>
 
 namespace hayai::coro {
 
@@ -20,7 +22,8 @@ namespace hayai::coro {
  * Design:
  * - Non-invasive: wraps existing TcpConnection
  * - Thread-safe: can be used from any thread
- * - RAII: automatically manages callbacks
+ * - RAII: automatically manages callbacks (takes over the connection's
+ *   message and connection callbacks; a close wakes a pending read)
  */
 class AsyncConnection {
   public:
@@ -37,7 +40,8 @@ class AsyncConnection {
      * @brief Awaitable receive operation.
      *
      * Suspends coroutine until data arrives, then returns the data.
-     * Returns empty Buffer if connection is closed.
+     * Returns empty Buffer once the connection has closed and what it
+     * received before has been returned.
      */
     class RecvAwaiter {
       public:
@@ -54,29 +58,89 @@ class AsyncConnection {
 
     RecvAwaiter recv() { return RecvAwaiter(*this); }
 
+    /**
+     * @brief Awaitable read of one frame decoded by `codec`.
+     *
+     * Suspends until a whole frame has arrived and returns its payload as
+     * a view into the receive buffer. The coroutine must run on the
+     * connection's loop (asserted on resume): more input is appended to
+     * that buffer there, so the view is valid only until the coroutine
+     * next suspends, and the frame is consumed by the next
+     * recv()/readFrame(). Copy it out to keep it longer.
+     *
+     * Returns nullopt once the connection has closed with no whole frame
+     * left (a frame cut off by the close is dropped), and, closing the
+     * connection, if the peer announced a frame over codec.maxFrameSize().
+     */
+    class FrameAwaiter {
+      public:
+        FrameAwaiter(AsyncConnection& self, const LengthFieldCodec& codec);
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> h);
+        std::optional<std::string_view> await_resume();
+
+      private:
+        AsyncConnection& self_;
+        const LengthFieldCodec& codec_;
+    };
+
+    FrameAwaiter readFrame(const LengthFieldCodec& codec) {
+        return FrameAwaiter{*this, codec};
+    }
+
     /**
      * @brief Awaitable send operation.
      *
-     * Suspends coroutine until data is fully written.
+     * Suspends until this send's bytes have been handed to the socket
+     * (other sends around it don't count); returns false if the
+     * connection closed first, or was not connected.
      */
     class SendAwaiter {
       public:
         SendAwaiter(AsyncConnection& self, std::string data);
 
-        bool await_ready() const noexcept;
+        bool await_ready() const noexcept { return false; }
         void await_suspend(std::coroutine_handle<> h);
-        void await_resume();
+        bool await_resume() const noexcept { return sent_; }
 
       private:
         AsyncConnection& self_;
         std::string data_;
-        std::coroutine_handle<> waiting_coroutine_;
+        bool sent_{false};
     };
 
     SendAwaiter send(std::string data) {
         return SendAwaiter{*this, std::move(data)};
     }
 
+    /**
+     * @brief Awaitable sendfile() of a file range.
+     *
+     * Suspends until the range has been handed to the socket; returns
+     * false if the connection closed first. `fd` must stay open until then.
+     */
+    class SendFileAwaiter {
+      public:
+        SendFileAwaiter(AsyncConnection& self, int fd, off_t offset,
+                        size_t length);
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h);
+        bool await_resume() const noexcept { return sent_; }
+
+      private:
+        AsyncConnection& self_;
+        int fd_;
+        off_t offset_;
+        size_t length_;
+        bool sent_{false};
+    };
+
+    SendFileAwaiter sendFile(int fd, off_t offset, size_t length) {
+        return SendFileAwaiter{*this, fd, offset, length};
+    }
+
     // Non-awaitable utilities
     [[nodiscard]] InetAddress localAddr() const {
         return conn_ ? conn_->localAddress() : InetAddress{};
@@ -95,11 +159,15 @@ class AsyncConnection {
 
   private:
     friend class RecvAwaiter;
-    friend class SendAwaiter;
+    friend class FrameAwaiter;
 
     void onMessage(const TcpConnectionPtr& conn, Buffer* buf);
-    void onWriteComplete(const TcpConnectionPtr& conn);
+    void onClose();
+    // Resume the pending recv()/readFrame(), if any (recvMutex_ held)
+    void wakeReader();
     void bindCallbacks();
+    // Drop the frame handed out last (recvMutex_ held)
+    void consumeFrame();
 
     TcpConnectionPtr conn_;
     EventLoop* loop_;
@@ -108,9 +176,10 @@ class AsyncConnection {
     std::mutex recvMutex_;
     std::optional<std::coroutine_handle<>> recvCoroutine_;
     Buffer receivedData_;
-
-    // State for send awaiter
-    std::mutex sendMutex_;
-    std::optional<std::coroutine_handle<>> sendCoroutine_;
+    // Set while a readFrame() waits: wake it only for a decodable frame
+    const LengthFieldCodec* frameCodec_{nullptr};
+    // Bytes at the front of receivedData_ the last frame view points to
+    size_t frameBytes_{0};
+    bool closed_{false}; // no more input will arrive
 };
 } // namespace hayai::coro
\ No newline at end of file
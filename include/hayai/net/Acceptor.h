@@ -3,7 +3,7 @@
 #include "hayai/net/InetAddress.h"
 #include "hayai/net/Socket.h"
 #include "hayai/utils/NonCopyable.h"
-#include <functional>
+#include "hayai/utils/SmallFunction.h"
 
 namespace hayai {
 class EventLoop;
@@ -16,7 +16,7 @@ class EventLoop;
 class Acceptor : NonCopyable {
 public:
   using NewConnectionCallback =
-      std::function<void(int sockfd, const InetAddress &)>;
+      SmallFunction<void(int sockfd, const InetAddress &)>;
 
   Acceptor(EventLoop *loop, const InetAddress &listenAddr,
            bool reuseport = true);
@@ -32,6 +32,9 @@ public:
 
 private:
   void handleRead();
+  // Completion I/O: a connection the poller accepted
+  void handleAccepted(const Channel::Completion &c);
+  void newConnection(int connfd, const InetAddress &peerAddr);
 
   EventLoop *loop_;
   Socket acceptSocket_;
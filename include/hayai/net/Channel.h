@@ -1,6 +1,13 @@
+#pragma once
+
 #include "hayai/utils/NonCopyable.h"
-#include <functional>
+#include "hayai/utils/SmallFunction.h"
+#include <cstdint>
 #include <memory>
+
+struct iovec;
+struct sockaddr;
+
 namespace hayai {
 class EventLoop;
 
@@ -10,7 +17,32 @@ class EventLoop;
  */
 class Channel : NonCopyable {
 public:
-  using EventCallback = std::function<void()>;
+  using EventCallback = SmallFunction<void()>;
+
+  /**
+   * @brief Completion-based I/O, on pollers that perform it
+   * (Poller::completionIo(): io_uring).
+   *
+   * Instead of reporting that the fd is ready and leaving the syscall to
+   * the owner, the poller has the kernel do the operation and hands over
+   * its result. With readOp() set to Recv or Accept, read interest keeps
+   * one such operation armed (re-armed after each completion, cancelled
+   * when read interest goes away); send() submits one send at a time.
+   * Write interest is still served by readiness.
+   */
+  enum class ReadOp : uint8_t { Readiness, Recv, Accept };
+
+  struct Completion {
+    enum class Op : uint8_t { Recv, Accept, Send };
+    Op op;
+    // Recv: bytes received, 0 at EOF; Accept: the new fd; Send: bytes
+    // sent. -errno on failure.
+    int res;
+    const char *data;     // Recv: the bytes, in a poller-owned buffer
+    const sockaddr *peer; // Accept: the peer's address
+  };
+  // `c` and the bytes it points to are valid during the call only
+  using CompletionCallback = SmallFunction<void(const Completion &c)>;
 
   Channel(EventLoop *loop, int fd);
   ~Channel();
@@ -26,6 +58,21 @@ public:
   void setWriteCallback(EventCallback cb) { writeCallback_ = std::move(cb); }
   void setCloseCallback(EventCallback cb) { closeCallback_ = std::move(cb); }
   void setErrorCallback(EventCallback cb) { errorCallback_ = std::move(cb); }
+  void setCompletionCallback(CompletionCallback cb) {
+    completionCallback_ = std::move(cb);
+  }
+
+  // Whether the owner loop's poller performs I/O itself (see ReadOp)
+  [[nodiscard]] bool completionIo() const;
+  // What read interest arms; only honoured when completionIo(). Read
+  // interest already registered is re-armed accordingly.
+  void setReadOp(ReadOp op);
+  [[nodiscard]] ReadOp readOp() const { return readOp_; }
+  // Send the iovecs' bytes (completionIo() only, on a channel with some
+  // interest enabled; one send in flight at a time). The bytes must stay
+  // untouched until the Send completion; the tied owner is kept alive
+  // until then, even past remove().
+  void send(const struct iovec *iov, int iovcnt);
 
   void enableReading() {
     events_ |= kReadEvent;
@@ -52,9 +99,20 @@ public:
   }
   void remove();
 
+  // Edge-triggered readiness (EPOLLET / EV_CLEAR). The owner must then drain
+  // the fd until EAGAIN. Takes effect on the next update().
+  void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+  [[nodiscard]] bool isEdgeTriggered() const { return edgeTriggered_; }
+
   [[nodiscard]] int fd() const { return fd_; }
   [[nodiscard]] int events() const { return events_; }
   void setRevents(int revt) { revents_ = revt; }
+  [[nodiscard]] int revents() const { return revents_; }
+  // From the poller: a finished operation, dispatched with the next
+  // handleEvent() (kReadDoneEvent / kSendDoneEvent in revents)
+  void setCompletion(const Completion &c);
+  // The tied owner, if any and still alive
+  [[nodiscard]] std::shared_ptr<void> tiedOwner() const { return tie_.lock(); }
   [[nodiscard]] bool isNoneEvent() const { return events_ == kNoneEvent; }
   [[nodiscard]] bool isReading() const { return events_ & kReadEvent; }
   [[nodiscard]] bool isWriting() const { return events_ & kWriteEvent; }
@@ -69,16 +127,20 @@ public:
   static constexpr int kWriteEvent = 2;
   static constexpr int kErrorEvent = 4;
   static constexpr int kCloseEvent = 8;
+  static constexpr int kReadDoneEvent = 16; // Recv or Accept completed
+  static constexpr int kSendDoneEvent = 32;
 
 private:
   void update();
-  void handleEventWithGuard();
+  void handleEventWithGuard(int revents);
 
   EventLoop *loop_;
   const int fd_;
   int events_{0};  // Events Poller should watch
   int revents_{0}; // Events actually occurred
-  int index_{-1};
+  int index_{-1}; // Poller-private slot state (-1: unknown to the poller)
+  bool edgeTriggered_{false};
+  ReadOp readOp_{ReadOp::Readiness};
 
   std::weak_ptr<void> tie_; // The "guard" for obj lifetime
   bool tied_{false};
@@ -87,6 +149,9 @@ private:
   EventCallback writeCallback_;
   EventCallback closeCallback_;
   EventCallback errorCallback_;
+  CompletionCallback completionCallback_;
+  Completion readDone_{};
+  Completion sendDone_{};
 };
 
 } // namespace hayai
\ No newline at end of file
@@ -1,27 +1,40 @@
 #pragma once
 #include <atomic>
+#include <chrono>
 #include <coroutine>
-#include <functional>
 #include <memory>
-#include <mutex>
 #include <set>
 #include <thread>
 #include <vector>
 
+#include "hayai/net/TimerQueue.h"
+#include "hayai/utils/MpscQueue.h"
 #include "hayai/utils/NonCopyable.h"
+#include "hayai/utils/SmallFunction.h"
+
+struct iovec;
 
 namespace hayai {
 class Poller;
 class Channel;
+class OutputQueue;
+class PipePool;
+class SlabPool;
+class TcpConnection;
 
 class EventLoop : NonCopyable {
 public:
-  using Functor = std::function<void()>;
+  using Functor = SmallFunction<void()>;
+  using Clock = TimerQueue::Clock;
 
   EventLoop();
   ~EventLoop();
 
-  // The main loop: blocks in Poller until events occur
+  // The main loop: blocks in Poller until events occur. On a completion
+  // poller (io_uring) the last iteration's operations are handed over as
+  // it returns, and completions that arrive at once (a send, and the
+  // shutdown() waiting on it) are dispatched: nothing queued before quit()
+  // is lost. Readiness events wait for the next loop().
   void loop();
   void quit();
 
@@ -30,6 +43,16 @@ public:
   // always queue to be executed after I/O events
   void queueInLoop(Functor cb);
 
+  // Timers (loop thread only; use runInLoop to schedule from elsewhere).
+  // Callbacks run after I/O handling, before queued functors.
+  TimerId runAt(Clock::time_point when, Functor cb);
+  TimerId runAfter(Clock::duration delay, Functor cb);
+  TimerId runEvery(Clock::duration interval, Functor cb);
+  // No-op for timers that already fired or were cancelled
+  void cancel(TimerId timerId);
+
+  [[nodiscard]] size_t timerCount() const { return timerQueue_->size(); }
+
   /**
    * @brief Spawn a fire-and-forget coroutine on this EventLoop.
    *
@@ -48,8 +71,30 @@ public:
    */
   void cleanupSpawnedTask(std::coroutine_handle<> handle);
 
+  // Corked connections with queued output: flushed once after this
+  // iteration's events, before queued functors run (loop thread only)
+  void addDirtyConnection(std::shared_ptr<TcpConnection> conn);
+
+  // Pipes for splice() relays, shared by this loop's connections.
+  // Loop thread only; created on first use.
+  PipePool &pipePool();
+
+  // A closed socket's zero-copy owners (OutputQueue::pinnedCount()),
+  // kept until the kernel reports it is done reading their pages: the
+  // loop reaps the error queue of its own descriptor of `sockfd`, which
+  // it shuts down for writing, on a timer. Loop thread only.
+  void parkZeroCopy(int sockfd, std::unique_ptr<OutputQueue> pins);
+  // Sockets parked that way whose completions are still outstanding
+  [[nodiscard]] size_t parkedZeroCopy() const { return parkedZeroCopy_.size(); }
+
+  // Connection objects and buffer blocks allocated on this thread (see
+  // SlabPool). Lives as long as the loop; stats are loop thread only.
+  SlabPool &slabPool() { return *slabPool_; }
+
   void updateChannel(Channel *channel);
   void removeChannel(Channel *channel);
+  // Completion-based send (Channel::send())
+  void submitSend(Channel *channel, const struct iovec *iov, int iovcnt);
 
   [[nodiscard]] bool isInLoopThread() const {
     return threadId_ == std::this_thread::get_id();
@@ -61,31 +106,83 @@ public:
     }
   }
 
+  // When the current poll() returned; a free timestamp for event handlers
+  [[nodiscard]] Clock::time_point pollReturnTime() const {
+    return pollReturnTime_;
+  }
+
+  // Number of poll() rounds so far (one readiness syscall each)
+  [[nodiscard]] uint64_t iteration() const { return iteration_; }
+
+  [[nodiscard]] const Poller *poller() const { return poller_.get(); }
+
+  // Inside loop(): work queued now is picked up by a coming poll()
+  [[nodiscard]] bool looping() const { return looping_; }
+
+  // Wakeup writes actually issued (bursts of cross-thread posts coalesce)
+  [[nodiscard]] uint64_t wakeupWrites() const {
+    return wakeupWrites_.load(std::memory_order_relaxed);
+  }
+
   // Singleton per thread
   static EventLoop *getEventLoopOfCurrentThread();
 
 private:
   void wakeup();
-  void handleWakeup(); // Read from wakeup pipe
+  void handleWakeup(); // Drain the wakeup fd
   void doPendingFunctors();
+  void flushDirtyConnections();
+  void finishCompletions(); // loop() exit on a completion poller
+  void reapParkedZeroCopy();
 
   std::atomic<bool> looping_{false};
   std::atomic<bool> quit_{false};
   std::atomic<bool> eventHandling_{false};
   std::atomic<bool> callingPendingFunctors_{false};
+  uint64_t iteration_{0};
+  Clock::time_point pollReturnTime_{Clock::now()};
 
   // thread that created this loop
   const std::thread::id threadId_;
+  // First member: pooled blocks may be freed while the others go away
+  std::unique_ptr<SlabPool> slabPool_;
   std::unique_ptr<Poller> poller_;
   std::unique_ptr<Channel> wakeupChannel_;
+  std::unique_ptr<TimerQueue> timerQueue_;
+  std::unique_ptr<PipePool> pipePool_;
 
-  // Wakeup mechanism (using pipe for macOS/POSIX)
-  int wakeupFd_[2]; // 0: read, 1: write
+  // Wakeup mechanism: eventfd on Linux (one fd), pipe elsewhere
+  int wakeupReadFd_;
+  int wakeupWriteFd_;
+  // Set by the first wakeup() of a burst, cleared before the loop drains
+  // pendingFunctors_, so N posts in a row cost one write() syscall
+  std::atomic<bool> wakeupPending_{false};
+  std::atomic<uint64_t> wakeupWrites_{0};
 
   std::vector<Channel *> activeChannels_;
 
-  mutable std::mutex mutex_;
-  std::vector<Functor> pendingFunctors_;
+  struct ParkedZeroCopy {
+    int fd;
+    std::unique_ptr<OutputQueue> pins;
+  };
+  std::vector<ParkedZeroCopy> parkedZeroCopy_;
+  TimerId zeroCopyReaper_;
+
+  std::vector<std::shared_ptr<TcpConnection>> dirtyConnections_;
+  std::vector<std::shared_ptr<TcpConnection>> flushingConnections_;
+
+  // Cross-thread task queue: producers never block each other or the loop.
+  // Nodes come from the posting thread's SlabPool, so posts between loops
+  // recycle blocks instead of hitting the global heap.
+  struct PendingFunctor : MpscNode {
+    explicit PendingFunctor(Functor f) : fn(std::move(f)) {}
+    Functor fn;
+  };
+  static void releaseFunctor(PendingFunctor *task);
+  static constexpr size_t kMaxFunctorBatch = 4096;
+
+  MpscQueue<PendingFunctor> pendingFunctors_;
+  std::vector<PendingFunctor *> functorBatch_; // reused by doPendingFunctors
 
   std::set<std::coroutine_handle<>> spawnedTasks_;
 };
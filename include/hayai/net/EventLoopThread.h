@@ -1,3 +1,5 @@
+#pragma once
+
 #include "hayai/utils/NonCopyable.h"
 #include <condition_variable>
 #include <memory>
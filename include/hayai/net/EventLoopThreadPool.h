@@ -1,3 +1,5 @@
+#pragma once
+
 #include "hayai/net/EventLoopThread.h"
 #include "hayai/utils/NonCopyable.h"
 #include <atomic>
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "hayai/net/TcpConnection.h"
+#include "hayai/utils/Buffer.h"
+#include "hayai/utils/SmallFunction.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace hayai {
+
+/**
+ * @brief Length-prefixed framing: a big-endian length of 1, 2, 4 or 8
+ * bytes, then that many payload bytes.
+ *
+ * Decoding reads the header straight from Buffer::peek() and hands out
+ * each complete payload as a view into the input buffer, so frames are
+ * never copied. Encoding appends the payload and prepends the header in
+ * the buffer's prepend space, so the payload is not moved either.
+ *
+ * A header announcing more than maxFrameSize() is a protocol error: the
+ * peer can't be trusted to make us buffer that much. The codec holds no
+ * per-connection state and may serve every connection of a server:
+ *
+ *   server.setMessageCallback([&codec](const TcpConnectionPtr &c,
+ *                                      Buffer *buf) {
+ *     codec.onMessage(c, buf);
+ *   });
+ */
+class LengthFieldCodec {
+public:
+  // `frame` views the input buffer; valid until the callback returns
+  using FrameCallback =
+      SmallFunction<void(const TcpConnectionPtr &, std::string_view frame)>;
+  // A header announced `length` > maxFrameSize()
+  using ErrorCallback =
+      SmallFunction<void(const TcpConnectionPtr &, uint64_t length)>;
+
+  static constexpr size_t kDefaultMaxFrameSize = 16 * 1024 * 1024;
+
+  enum class Status { Frame, Incomplete, TooLarge };
+
+  // `headerBytes`: 1, 2, 4 or 8; the length counts payload bytes only
+  explicit LengthFieldCodec(size_t headerBytes = 4,
+                            size_t maxFrameSize = kDefaultMaxFrameSize);
+
+  [[nodiscard]] size_t headerBytes() const { return headerBytes_; }
+  [[nodiscard]] size_t maxFrameSize() const { return maxFrameSize_; }
+  // Also capped by what the header can express
+  void setMaxFrameSize(size_t maxFrameSize);
+
+  /**
+   * @brief Look at the frame at the front of `buf` without consuming it.
+   *
+   * On Status::Frame, `frame` views its payload; retrieve
+   * frameBytes(*frame) to consume it. On Status::TooLarge, `length`
+   * (if given) gets the announced length.
+   */
+  Status peekFrame(const Buffer &buf, std::string_view *frame,
+                   uint64_t *length = nullptr) const;
+  // Header plus payload: what a decoded frame occupies in the buffer
+  [[nodiscard]] size_t frameBytes(std::string_view frame) const {
+    return headerBytes_ + frame.size();
+  }
+
+  // Prepend the header for all of `buf`'s readable bytes, in place
+  // (moving them only if a consumed buffer has no prepend space left)
+  void encode(Buffer *buf) const;
+  // Append a header and `payload` to `out`
+  void encode(std::string_view payload, Buffer *out) const;
+
+  // One frame to `conn`: built in a single buffer that is then moved to
+  // the connection, so the payload is copied once at most
+  void send(const TcpConnectionPtr &conn, std::string_view payload) const;
+  void send(const TcpConnectionPtr &conn, Buffer &&payload) const;
+
+  // Callback form: set before the codec starts serving connections
+  void setFrameCallback(FrameCallback cb) { frameCallback_ = std::move(cb); }
+  // Default: force-close the connection
+  void setErrorCallback(ErrorCallback cb) { errorCallback_ = std::move(cb); }
+
+  // A TcpConnection message callback: delivers every complete frame in
+  // `buf` and leaves a partial one for the next read
+  void onMessage(const TcpConnectionPtr &conn, Buffer *buf) const;
+
+private:
+  void prependHeader(Buffer *buf, uint64_t length) const;
+
+  size_t headerBytes_;
+  size_t maxFrameSize_;
+  FrameCallback frameCallback_;
+  ErrorCallback errorCallback_;
+};
+
+} // namespace hayai
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "hayai/utils/NonCopyable.h"
+#include <cstddef>
+#include <vector>
+
+namespace hayai {
+
+/**
+ * @brief Per-loop cache of non-blocking pipes for splice() relaying.
+ *
+ * A relay needs a pipe between the two sockets; creating one (pipe2 plus
+ * resizing) per connection is two syscalls and two fds of churn, so idle
+ * pipes are kept for the next connection. Only empty pipes go back into
+ * the pool: leftover bytes would leak into another stream.
+ *
+ * Not thread-safe: owned by one EventLoop (see EventLoop::pipePool()).
+ */
+class PipePool : NonCopyable {
+  public:
+    struct Pipe {
+        int readFd{-1};
+        int writeFd{-1};
+        size_t capacity{0}; // bytes the pipe buffers
+
+        [[nodiscard]] bool valid() const { return readFd >= 0; }
+    };
+
+    // Requested pipe buffer size; the kernel may cap it (pipe-max-size)
+    static constexpr size_t kPipeSize = 1024 * 1024;
+    // Idle pipes kept beyond this are closed
+    static constexpr size_t kMaxIdle = 64;
+
+    PipePool() = default;
+    ~PipePool();
+
+    // An empty pipe; !valid() if the process is out of fds
+    Pipe acquire();
+    // `empty`: whether the caller drained it; a dirty pipe is closed
+    void release(Pipe pipe, bool empty);
+
+    [[nodiscard]] size_t idleCount() const { return idle_.size(); }
+    [[nodiscard]] size_t created() const { return created_; }
+
+  private:
+    static void close(Pipe& pipe);
+
+    std::vector<Pipe> idle_;
+    size_t created_{0};
+};
+
+} // namespace hayai
@@ -2,32 +2,87 @@
 
 #include "hayai/utils/NonCopyable.h"
 #include <chrono>
-#include <map>
-#include <sys/event.h>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
+struct iovec;
+
 namespace hayai {
 class Channel;
 class EventLoop;
 
+/**
+ * @brief Poller is the I/O multiplexing interface used by EventLoop.
+ *
+ * The concrete backend is picked at build time by newDefaultPoller():
+ * - EpollPoller  on Linux
+ * - KqueuePoller on macOS / BSD
+ *
+ * Interest changes are batched: backends queue them and apply them with
+ * (or right before) the next poll(), instead of one syscall per
+ * updateChannel(). The counters below show how well that works.
+ *
+ * All methods must be called from the owner loop's thread.
+ */
 class Poller : NonCopyable {
-public:
-  using ChannelList = std::vector<Channel *>;
+  public:
+    using ChannelList = std::vector<Channel*>;
+
+    explicit Poller(EventLoop* loop) : ownerLoop_(loop) {}
+    virtual ~Poller() = default;
+
+    // Block up to timeout, then append ready channels to activeChannels
+    virtual void poll(std::chrono::milliseconds timeout,
+                      ChannelList* activeChannels) = 0;
+
+    // Add or modify the interest set of a channel
+    virtual void updateChannel(Channel* channel) = 0;
+
+    // Forget a channel entirely (it must not be watched afterwards)
+    virtual void removeChannel(Channel* channel) = 0;
+
+    [[nodiscard]] virtual const char* backendName() const = 0;
+
+    // Completion-based I/O (Channel::ReadOp, Channel::send()): the backend
+    // performs receives, accepts and sends itself, with no readiness round
+    // trip and no syscall of their own. Only IoUringPoller does.
+    [[nodiscard]] virtual bool completionIo() const { return false; }
+    virtual void submitSend(Channel* channel, const struct iovec* iov,
+                            int iovcnt);
+    // Hand operations queued for the next poll() to the kernel now,
+    // without waiting (for when no poll() is coming)
+    virtual void submitPending() {}
+
+    [[nodiscard]] bool hasChannel(Channel* channel) const;
+
+    // updateChannel() + removeChannel() calls
+    [[nodiscard]] uint64_t interestUpdates() const { return interestUpdates_; }
+    // Syscalls issued only to change interest (not the poll itself)
+    [[nodiscard]] uint64_t changeSyscalls() const { return changeSyscalls_; }
+    // What one-syscall-per-update would have cost on top
+    [[nodiscard]] uint64_t changeSyscallsAvoided() const {
+        return interestUpdates_ - changeSyscalls_;
+    }
 
-  explicit Poller(EventLoop *loop);
-  ~Poller();
+    static std::unique_ptr<Poller> newDefaultPoller(EventLoop* loop);
 
-  void poll(std::chrono::milliseconds timeout, ChannelList *activeChannels);
+  protected:
+    // fd -> Channel lookup; nullptr for fds this poller doesn't know
+    [[nodiscard]] Channel* channelAt(int fd) const {
+        return static_cast<size_t>(fd) < channels_.size() ? channels_[fd]
+                                                          : nullptr;
+    }
+    void setChannelAt(int fd, Channel* channel);
 
-  void updateChannel(Channel *channel);
-  void removeChannel(Channel *channel);
+    EventLoop* ownerLoop_;
 
-private:
-  void fillActiveChannels(int numEvents, ChannelList *activeChannels);
+    // Flat table indexed by fd: fds are small dense integers, so this
+    // replaces a tree walk and node allocation per update with an index.
+    // Grown on demand, never shrunk.
+    std::vector<Channel*> channels_;
 
-  EventLoop *ownerLoop_;
-  int kqueueFd_;
-  std::vector<struct kevent> events_; // For kevent() resutls
-  std::map<int, Channel *> channels_; // fd -> Channel mapping
+    uint64_t interestUpdates_{0};
+    uint64_t changeSyscalls_{0};
 };
-} // namespace hayai
\ No newline at end of file
+} // namespace hayai
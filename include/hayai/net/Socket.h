@@ -31,6 +31,8 @@ public:
   void setReusePort(bool on = true);
   void setTcpNoDelay(bool on = true);
   void setKeepAlive(bool on = true);
+  // SO_ZEROCOPY; false where unsupported (non-Linux, old kernel, not TCP)
+  bool setZeroCopy(bool on = true);
 
   void bind(const InetAddress &addr);
   void listen();
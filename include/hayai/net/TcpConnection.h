@@ -1,16 +1,22 @@
 #pragma once
 
+#include "hayai/net/Channel.h"
 #include "hayai/net/InetAddress.h"
+#include "hayai/net/PipePool.h"
+#include "hayai/net/Socket.h"
+#include "hayai/net/TimerQueue.h"
 #include "hayai/utils/Buffer.h"
 #include "hayai/utils/NonCopyable.h"
-#include <functional>
+#include "hayai/utils/OutputQueue.h"
+#include "hayai/utils/SharedSlice.h"
+#include "hayai/utils/SmallFunction.h"
+#include <vector>
 #include <memory>
 #include <string_view>
+#include <sys/types.h>
 
 namespace hayai {
 class EventLoop;
-class Socket;
-class Channel;
 
 class TcpConnection;
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
@@ -18,25 +24,112 @@ using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
 /**
  * @brief TcpConnection represents an active connection.
  * It uses shared_from_this to ensure its lifetime during callbacks.
+ *
+ * On a loop whose poller performs I/O itself (io_uring; see
+ * Channel::ReadOp), receives and sends are poller completions instead of
+ * read() and write() calls, and what is sent during an iteration goes out
+ * as one operation after it, as if corked. Zero-copy connections and
+ * relays keep readiness I/O.
  */
 class TcpConnection : NonCopyable,
                       public std::enable_shared_from_this<TcpConnection> {
 public:
-  using ConnectionCallback = std::function<void(const TcpConnectionPtr &)>;
+  using ConnectionCallback = SmallFunction<void(const TcpConnectionPtr &)>;
   using MessageCallback =
-      std::function<void(const TcpConnectionPtr &, Buffer *)>;
-  using CloseCallback = std::function<void(const TcpConnectionPtr &)>;
+      SmallFunction<void(const TcpConnectionPtr &, Buffer *)>;
+  using CloseCallback = SmallFunction<void(const TcpConnectionPtr &)>;
+  using HighWaterMarkCallback =
+      SmallFunction<void(const TcpConnectionPtr &, size_t queuedBytes)>;
+  // `sent` is false if the connection closed before the bytes went out
+  using SendCompleteCallback =
+      SmallFunction<void(const TcpConnectionPtr &, bool sent)>;
+  using FileCompleteCallback = SendCompleteCallback;
+  using Clock = TimerQueue::Clock;
+
+  static constexpr size_t kDefaultHighWaterMark = 64 * 1024 * 1024;
+  // Below this, pinning pages and reaping completions costs more than the
+  // copy MSG_ZEROCOPY saves
+  static constexpr size_t kDefaultZeroCopyThreshold = 16 * 1024;
+  // Input ring size for setRingInputBuffer()
+  static constexpr size_t kDefaultRingInputSize = 256 * 1024;
+
+  // Max bytes written per writable event, and read per readable event in
+  // edge-triggered mode
+  static constexpr size_t kDefaultIoBudget = 1024 * 1024;
+
+  // Syscall / byte counters, for measuring e.g. syscalls per MB. Under
+  // completion I/O the calls are ring operations, which make no syscall
+  // of their own.
+  struct IoStats {
+    uint64_t readCalls{0};
+    uint64_t bytesRead{0};
+    uint64_t writeCalls{0};
+    uint64_t bytesWritten{0};
+    uint64_t zeroCopyCompleted{0}; // MSG_ZEROCOPY sends the kernel finished
+    uint64_t zeroCopyCopied{0};    // ... of which it copied after all
+    uint64_t readOverflowCopies{0}; // reads that spilled past the buffer
+    uint64_t readOverflowBytes{0};  // ... and the bytes copied in after
+  };
 
   TcpConnection(EventLoop *loop, std::string name, int sockfd,
                 const InetAddress &localAddr, const InetAddress &peerAddr);
 
+  // Like make_shared, but the object (with its refcount) comes from the
+  // calling thread's SlabPool and returns there, whichever thread drops
+  // the last reference. What TcpServer uses for accepted connections,
+  // called on their I/O loop.
+  static TcpConnectionPtr create(EventLoop *loop, std::string name,
+                                 int sockfd, const InetAddress &localAddr,
+                                 const InetAddress &peerAddr);
+
   ~TcpConnection();
 
   // User APIs
+  // Copies the message (only what the socket doesn't take at once)
   void send(std::string_view message);
+  void send(const char *message) { send(std::string_view(message)); }
+  // Take ownership: the bytes travel to the socket queue without a copy,
+  // also when called from another thread
+  void send(std::string &&message);
+  void send(Buffer &&message);
+  // The same, then `done` runs (queued, exactly once) when this message
+  // has been handed to the socket, whatever else is sent around it
+  void send(std::string &&message, SendCompleteCallback done);
+  // Queued by reference and released once written: large bodies are
+  // never copied, and a header + body go out in one writev()
+  void send(std::shared_ptr<const std::string> message);
+  // The same by slice: one payload fanned out to many connections exists
+  // once (see TcpServer::broadcast)
+  void send(const SharedSlice &message);
+  // Queued by reference without ownership: `message` must stay valid
+  // for the connection's lifetime (static responses and the like)
+  void sendBorrowed(std::string_view message);
+  // Stream `length` bytes of `fd` from `offset` with sendfile(): no copy
+  // through user space. Ordered with the other sends; `fd` must stay open
+  // until `done` runs (queued, exactly once).
+  void sendFile(int fd, off_t offset, size_t length,
+                FileCompleteCallback done = nullptr);
   void shutdown();
   void forceClose();
 
+  /**
+   * @brief L4 relay: move everything read from here to `peer` with
+   * splice(), through a pipe from the loop's PipePool.
+   *
+   * The bytes never enter user space and the message callback stops
+   * running. Backpressure toggles read interest: while `peer` can't take
+   * more, this connection stops reading. EOF is passed on as
+   * peer->shutdown(); a connection closes once its input has ended and
+   * its output is shut down, and an error close on either side closes
+   * the other. Call on both connections for a full-duplex proxy.
+   *
+   * Both connections must belong to this loop; loop thread only. Returns
+   * false where splice() is unavailable (non-Linux) or no pipe could be
+   * made: relay through the message callback then.
+   */
+  bool relayTo(const TcpConnectionPtr &peer);
+  [[nodiscard]] bool relaying() const { return relaying_; }
+
   [[nodiscard]] bool connected() const { return state_ == State::Connected; }
 
   [[nodiscard]] const InetAddress &localAddress() const { return localAddr_; }
@@ -54,10 +147,124 @@ public:
 
   void setCloseCallback(CloseCallback cb) { closeCallback_ = std::move(cb); }
 
+  // Runs (queued) each time the output is fully handed to the socket
   void setWriteCompleteCallback(ConnectionCallback cb) {
     writeCompleteCallback_ = std::move(cb);
   }
 
+  /**
+   * @brief Output backpressure.
+   *
+   * When queued output reaches the high-water mark, the high-water
+   * callback runs (queued, with the queued byte count) and reads are
+   * throttled as configured below. Once a flush brings it down to the
+   * low-water mark, reads resume and the low-water callback runs.
+   * Throttling keeps a slow reader from growing the queue without bound:
+   * no new input, no new responses.
+   */
+  void setWaterMarks(size_t highWaterMark, size_t lowWaterMark);
+
+  void setHighWaterMarkCallback(HighWaterMarkCallback cb) {
+    highWaterMarkCallback_ = std::move(cb);
+  }
+
+  void setLowWaterMarkCallback(ConnectionCallback cb) {
+    lowWaterMarkCallback_ = std::move(cb);
+  }
+
+  // Above the high-water mark, stop reading from this connection
+  void setThrottleReads(bool on) { throttleReads_ = on; }
+
+  // Above the high-water mark, stop reading from `upstream` instead (the
+  // source a proxy relays into us; may live on another loop)
+  void setThrottleUpstream(const TcpConnectionPtr &upstream);
+
+  [[nodiscard]] bool aboveHighWater() const { return aboveHighWater_; }
+
+  // Pause / resume reading. Thread-safe.
+  void startRead();
+  void stopRead();
+
+  /**
+   * @brief Opt in to edge-triggered readiness.
+   *
+   * Each wakeup then drains reads (writes always do) until EAGAIN, or
+   * until ioBudget bytes were moved; in that case the rest is picked up
+   * from the loop's pending queue so other connections get their turn.
+   * Must be called before connectEstablished().
+   */
+  void setEdgeTriggered(bool on, size_t ioBudget = kDefaultIoBudget);
+  [[nodiscard]] bool edgeTriggered() const { return edgeTriggered_; }
+
+  /**
+   * @brief Send large shared payloads with MSG_ZEROCOPY (Linux TCP).
+   *
+   * send(std::shared_ptr<const std::string>) of at least `threshold`
+   * bytes then skips the copy into socket buffers: the kernel reads the
+   * payload in place and the connection holds the reference until the
+   * completion arrives on the socket error queue (reaped on the error
+   * event; still pending at connectDestroyed(), the loop takes them over,
+   * see EventLoop::parkZeroCopy()). Returns false, leaving plain writes in
+   * place, where the socket doesn't support it. Must be called before
+   * connectEstablished().
+   *
+   * Completions arrive as error events, which a completion poller
+   * (Poller::completionIo()) doesn't deliver for receives it performs:
+   * once enabled, the connection stays on readiness-based reads and
+   * writes even there.
+   */
+  bool setZeroCopy(bool on, size_t threshold = kDefaultZeroCopyThreshold);
+  [[nodiscard]] bool zeroCopy() const { return zeroCopy_; }
+  // Zero-copy sends still waiting for their completion
+  [[nodiscard]] size_t zeroCopyPending() const {
+    return outputQueue_.pinnedCount();
+  }
+
+  /**
+   * @brief Keep input in a double-mapped ring buffer (Buffer::makeRing()).
+   *
+   * For long-lived streams whose message callback leaves partial frames
+   * behind: the leftovers are never moved to the front again. The message
+   * callback still gets a Buffer. Returns false, keeping the plain buffer,
+   * where rings aren't supported. Must be called before
+   * connectEstablished().
+   */
+  bool setRingInputBuffer(size_t capacity = kDefaultRingInputSize);
+  [[nodiscard]] bool ringInputBuffer() const { return inputBuffer_.isRing(); }
+
+  [[nodiscard]] const IoStats &ioStats() const { return ioStats_; }
+  // Bytes queued for the socket, not yet written
+  [[nodiscard]] size_t outputBytes() const {
+    return outputQueue_.readableBytes();
+  }
+
+  /**
+   * @brief Opt in to per-iteration write coalescing.
+   *
+   * send() then never writes directly: bytes are queued and the loop
+   * flushes each dirty connection once, after the iteration's events were
+   * dispatched, so a header/body/trailer sequence costs one writev().
+   * Adds up to one loop iteration of latency. Must be called before
+   * connectEstablished().
+   */
+  void setCorked(bool on);
+  [[nodiscard]] bool corked() const { return corked_; }
+
+  /**
+   * @brief Force-close the connection after `timeout` without reads or
+   * writes (zero disables).
+   *
+   * I/O only stamps the loop's cached poll time; the wheel timer re-arms
+   * itself for the remainder when it fires, so a busy connection costs no
+   * timer work per event. Connections that do expire are closed together,
+   * once per loop iteration. Must be called before connectEstablished().
+   */
+  void setIdleTimeout(Clock::duration timeout);
+  [[nodiscard]] Clock::duration idleTimeout() const { return idleTimeout_; }
+
+  // Whether the idle timeout (not the peer or the user) closed us
+  [[nodiscard]] bool reapedIdle() const { return reapedIdle_; }
+
   [[nodiscard]] const std::string &name() const { return name_; }
   [[nodiscard]] EventLoop *getLoop() const { return loop_; }
 
@@ -65,32 +272,116 @@ public:
   void connectEstablished();
   void connectDestroyed();
 
+  // Called by EventLoop for connections queued with addDirtyConnection()
+  void flushCorked();
+
 private:
   enum class State { Connecting, Connected, Disconnecting, Disconnected };
 
   void handleRead();
   void handleWrite();
+  void handleCompletion(const Channel::Completion &c);
+  void handleRecvComplete(int res, const char *data);
+  void handleSendComplete(int res);
+  void flushOutput();
+  // Completion I/O: hand the memory at the head of the queue to the
+  // poller. False if there is none (empty, or a file range first).
+  bool submitOutput();
+  void outputDrained(bool wrote); // outputQueue_ just became empty
+  void outputQueued(); // arrange for outputQueue_ to be flushed
+  void queueWriteComplete();
+  void enterHighWater();
+  void leaveHighWater();
+  void startReadInLoop();
+  void stopReadInLoop();
   void handleClose();
   void handleError();
 
   void sendInLoop(std::string_view message);
+  void sendSharedInLoop(std::string_view message,
+                        std::shared_ptr<const void> owner);
+  // False if the socket failed (the bytes are dropped)
+  template <typename Owned> bool sendOwnedInLoop(Owned &message);
+  void sendOwnedInLoop(std::string &message, SendCompleteCallback done);
+  void sendFileInLoop(int fd, off_t offset, size_t length,
+                      FileCompleteCallback done);
+  void queueFileComplete(SendCompleteCallback done, bool sent);
+  void startOutput(); // flush newly queued output, or arrange for it
+  void completeFiles(); // report pending sends consumed so far
+  void failPendingFiles();
+  void pumpRelay(); // move bytes along the relay until blocked
+  void stopRelay();
+  // A high-water throttle holds our reads off; the relay must not undo it
+  [[nodiscard]] bool readThrottled() const;
+  // EOF read and passed on, pipe drained
+  [[nodiscard]] bool relayDone() const;
+  void closeIfRelayDone();
+  // Write straight to the socket when nothing is queued ahead
+  size_t writeDirect(std::string_view message, bool *faultError);
   void shutdownInLoop();
 
+  void touch(); // record I/O activity for the idle timeout
+  void armIdleTimer(Clock::time_point deadline);
+  void cancelIdleTimer();
+  void handleIdleTimer();
+  static void reapIdleBatch();
+
   EventLoop *loop_;
   std::string name_;
-  std::unique_ptr<Socket> socket_;
-  std::unique_ptr<Channel> channel_;
+  // Members rather than separate heap objects: one allocation per
+  // connection (see create())
+  Socket socket_;
+  Channel channel_;
   State state_{State::Connecting};
 
   InetAddress localAddr_;
   InetAddress peerAddr_;
 
   Buffer inputBuffer_;
-  Buffer outputBuffer_;
+  OutputQueue outputQueue_;
+
+  // A sendFile() range, or a send() with a completion callback
+  struct PendingFile {
+    uint64_t end; // outputQueue_ position just past the range
+    SendCompleteCallback done;
+  };
+  // A vector: std::deque allocates even when empty, and this stays short
+  std::vector<PendingFile> pendingFiles_;
+
+  bool edgeTriggered_{false};
+  bool corked_{false};
+  bool flushQueued_{false}; // on the loop's dirty list
+  bool completionIo_{false}; // the poller receives and sends for us
+  bool sendInFlight_{false};
+  bool zeroCopy_{false};
+  size_t zeroCopyThreshold_{kDefaultZeroCopyThreshold};
+  size_t ioBudget_{kDefaultIoBudget};
+  IoStats ioStats_;
+
+  size_t highWaterMark_{kDefaultHighWaterMark};
+  size_t lowWaterMark_{0};
+  bool aboveHighWater_{false};
+  bool throttleReads_{false};
+  std::weak_ptr<TcpConnection> throttledUpstream_;
+
+  // splice() relay (relayTo)
+  bool relaying_{false};
+  bool relayEof_{false};
+  PipePool::Pipe relayPipe_;
+  size_t relayPipeBytes_{0};
+  std::weak_ptr<TcpConnection> relayPeer_;   // where our input goes
+  std::weak_ptr<TcpConnection> relaySource_; // whose input comes to us
+
+  Clock::duration idleTimeout_{Clock::duration::zero()};
+  Clock::time_point lastActive_;
+  TimerId idleTimer_;
+  bool reapedIdle_{false};
 
   ConnectionCallback connectionCallback_;
   MessageCallback messageCallback_;
   ConnectionCallback writeCompleteCallback_;
+  HighWaterMarkCallback highWaterMarkCallback_;
+  ConnectionCallback lowWaterMarkCallback_;
   CloseCallback closeCallback_;
 };
 
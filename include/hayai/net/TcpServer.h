@@ -1,8 +1,11 @@
+#pragma once
+
 #include "hayai/net/EventLoopThreadPool.h"
 #include "hayai/net/TcpConnection.h"
 #include "hayai/utils/NonCopyable.h"
 #include <functional>
 #include <map>
+#include <vector>
 
 namespace hayai {
 class EventLoop;
@@ -18,8 +21,9 @@ class Acceptor;
  * Connection Flow:
  * 1. Client connects → Acceptor accepts new fd
  * 2. Acceptor calls TcpServer::newConnection()
- * 3. TcpServer creates TcpConnection in next I/O thread loop
- * 4. TcpConnection is stored in connections_ map
+ * 3. TcpServer creates TcpConnection in next I/O thread loop (from
+ *    that loop's SlabPool)
+ * 4. TcpConnection is stored in connections_ map (acceptor loop)
  * 5. User's connectionCallback_ is invoked
  * 6. Connection handles I/O in its thread
  * 7. On close → removeConnection() → erase from map
@@ -27,10 +31,14 @@ class Acceptor;
  */
 class TcpServer : NonCopyable {
   public:
+    // Copyable on purpose: each new TcpConnection gets its own copy, stored
+    // inline in the connection's SmallFunction callbacks.
     using ConnectionCallback = std::function<void(const TcpConnectionPtr &)>;
     using MessageCallback =
         std::function<void(const TcpConnectionPtr &, Buffer *)>;
     using WriteCompleteCallback = std::function<void(const TcpConnectionPtr &)>;
+    using HighWaterMarkCallback =
+        std::function<void(const TcpConnectionPtr &, size_t)>;
 
     TcpServer(EventLoop *loop, const InetAddress &addr, std::string name);
     ~TcpServer();
@@ -59,6 +67,52 @@ class TcpServer : NonCopyable {
         writeCompleteCallback_ = std::move(cb);
     }
 
+    // Register new connections edge-triggered (see
+    // TcpConnection::setEdgeTriggered). Must be called before start().
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+    // Coalesce each connection's sends per loop iteration (see
+    // TcpConnection::setCorked). Must be called before start().
+    void setCorked(bool on) { corked_ = on; }
+
+    // Close connections idle for longer than `timeout` (see
+    // TcpConnection::setIdleTimeout). Must be called before start().
+    void setIdleTimeout(TcpConnection::Clock::duration timeout) {
+        idleTimeout_ = timeout;
+    }
+
+    // Output backpressure for every connection (see
+    // TcpConnection::setWaterMarks). Must be called before start().
+    void setWaterMarks(size_t highWaterMark, size_t lowWaterMark) {
+        highWaterMark_ = highWaterMark;
+        lowWaterMark_ = lowWaterMark;
+    }
+
+    void setHighWaterMarkCallback(HighWaterMarkCallback cb) {
+        highWaterMarkCallback_ = std::move(cb);
+    }
+
+    // Stop reading from a connection while its output is above the mark
+    void setThrottleReads(bool on) { throttleReads_ = on; }
+
+    // Connections closed by the idle timeout so far
+    [[nodiscard]] uint64_t reapedConnections() const {
+        return reapedConnections_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Send `payload` to every connection of this server.
+     *
+     * Queued by reference (see TcpConnection::send(const SharedSlice&)),
+     * with one cross-thread post per I/O loop rather than per connection;
+     * the bytes are freed once the last connection has written them.
+     * Thread-safe; connections accepted after the call don't get it.
+     */
+    void broadcast(SharedSlice payload);
+    // The same for a chosen set (a topic's subscribers), from any thread
+    static void broadcast(const std::vector<TcpConnectionPtr> &conns,
+                          const SharedSlice &payload);
+
     [[nodiscard]] const std::string &name() const { return name_; }
 
     [[nodiscard]] EventLoop *getLoop() const { return loop_; }
@@ -78,11 +132,19 @@ class TcpServer : NonCopyable {
 
     std::map<std::string, TcpConnectionPtr> connections_;
     int nextConnId_{1};
+    bool edgeTriggered_{false};
+    bool corked_{false};
+    TcpConnection::Clock::duration idleTimeout_{};
+    size_t highWaterMark_{TcpConnection::kDefaultHighWaterMark};
+    size_t lowWaterMark_{0};
+    bool throttleReads_{false};
+    std::atomic<uint64_t> reapedConnections_{0};
 
     std::atomic<bool> started_{false};
 
     ConnectionCallback connectionCallback_;
     MessageCallback messageCallback_;
     WriteCompleteCallback writeCompleteCallback_;
+    HighWaterMarkCallback highWaterMarkCallback_;
 };
 } // namespace hayai
\ No newline at end of file
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "hayai/utils/NonCopyable.h"
+#include "hayai/utils/SmallFunction.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace hayai {
+
+/**
+ * @brief Handle to a timer scheduled on an EventLoop.
+ *
+ * Slot index plus generation: once the timer fired (one-shot) or was
+ * cancelled, the slot is recycled with a new generation and old handles
+ * become harmless no-ops for cancel().
+ */
+struct TimerId {
+    uint32_t index{0};
+    uint32_t generation{0}; // 0: never scheduled
+
+    [[nodiscard]] bool valid() const { return generation != 0; }
+};
+
+/**
+ * @brief Hierarchical timing wheel with 1ms ticks.
+ *
+ * kLevels wheels of 64 slots each; level L slot covers 64^L ticks.
+ * A timer sits in the level of the highest 6-bit tick group where its
+ * expiry differs from the current tick, and moves down a level each time
+ * the wheel reaches its slot, so insert and cancel are O(1) and each
+ * timer is touched at most kLevels times before it fires.
+ *
+ * Timers live in a chunked slab threaded by index-based intrusive lists:
+ * no heap node per timer and no rebalancing, so one timer per connection
+ * stays cheap at a million connections. A 64-bit occupancy mask per level
+ * finds the next non-empty slot in a few instructions, which is what the
+ * EventLoop uses as its poll timeout.
+ *
+ * Not thread-safe: owned and driven by one EventLoop thread. Timers due
+ * on the same tick fire in no particular order. The top level does not
+ * wrap: deadlines past the current 2^36 ms window (about two years) wait
+ * in an overflow list, and are placed once the wheel enters their
+ * window.
+ */
+class TimerQueue : NonCopyable {
+  public:
+    using Clock = std::chrono::steady_clock;
+    using TimerCallback = SmallFunction<void()>;
+
+    explicit TimerQueue(Clock::time_point origin = Clock::now());
+    ~TimerQueue();
+
+    // interval == 0 for a one-shot timer
+    TimerId add(Clock::time_point when, Clock::duration interval,
+                TimerCallback cb);
+
+    // Safe on fired / cancelled / stale ids, and from inside callbacks
+    // (including a repeating timer cancelling itself). Returns whether a
+    // live timer was cancelled.
+    bool cancel(TimerId id);
+
+    // Run every timer due at or before `now`; returns how many fired
+    size_t expire(Clock::time_point now);
+
+    // How long poll() may block: time until the next non-empty slot,
+    // rounded up to whole ms and capped at `cap`
+    [[nodiscard]] std::chrono::milliseconds
+    nextTimeout(Clock::time_point now, std::chrono::milliseconds cap) const;
+
+    [[nodiscard]] size_t size() const { return size_; }
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+
+  private:
+    static constexpr int kLevelBits = 6;
+    static constexpr uint32_t kSlots = 1u << kLevelBits;
+    static constexpr int kLevels = 6;
+    static constexpr uint64_t kMaxDelayTicks =
+        (uint64_t{1} << (kLevelBits * kLevels)) - 1;
+
+    static constexpr uint32_t kNil = UINT32_MAX;
+    static constexpr uint32_t kExpiredList = kLevels * kSlots;
+    static constexpr uint32_t kOverflowList = kExpiredList + 1;
+    static constexpr uint32_t kNotLinked = kOverflowList + 1;
+    static constexpr uint64_t kNever = UINT64_MAX;
+
+    static constexpr int kChunkBits = 12;
+    static constexpr uint32_t kChunkSize = 1u << kChunkBits;
+
+    struct Timer {
+        TimerCallback callback;
+        uint64_t expiry{0};   // tick
+        uint64_t interval{0}; // ticks, 0 for one-shot
+        uint32_t prev{kNil};
+        uint32_t next{kNil}; // also the free-list link
+        uint32_t generation{1};
+        uint32_t list{kNotLinked}; // bucket, kExpiredList, kOverflowList
+                                   // or kNotLinked
+    };
+
+    Timer& at(uint32_t index) {
+        return chunks_[index >> kChunkBits][index & (kChunkSize - 1)];
+    }
+
+    uint32_t allocate();
+    void release(uint32_t index);
+
+    void link(uint32_t index, uint32_t list);
+    void unlink(uint32_t index);
+    void place(uint32_t index); // into the wheel, relative to current_
+    void cascade(int level);
+    void placeOverflow(); // on entering a new top-level window
+    size_t runExpired(uint64_t now);
+
+    // First tick after current_ whose slot holds timers, or kNever
+    [[nodiscard]] uint64_t nextPendingTick() const;
+
+    uint64_t ticksSince(Clock::time_point t) const; // floor, >= 0
+
+    const Clock::time_point origin_;
+    uint64_t current_{0}; // every tick <= current_ has been processed
+    size_t size_{0};
+
+    std::vector<std::unique_ptr<Timer[]>> chunks_; // stable addresses
+    uint32_t capacity_{0};
+    uint32_t freeHead_{kNil};
+
+    std::array<uint32_t, kOverflowList + 1> heads_;
+    std::array<uint32_t, kOverflowList + 1> tails_;
+    std::array<uint64_t, kLevels> occupied_{}; // bit per non-empty slot
+
+    // The timer whose callback is running, unlinked but not yet released
+    uint32_t running_{kNil};
+    bool runningCancelled_{false};
+};
+
+} // namespace hayai
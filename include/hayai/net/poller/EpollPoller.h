@@ -0,0 +1,55 @@
+#pragma once
+
+#include "hayai/net/Poller.h"
+#include <cstdint>
+#include <sys/epoll.h>
+#include <vector>
+
+namespace hayai {
+
+/**
+ * @brief epoll(7) backend (Linux), level-triggered unless a channel asks
+ * for edge-triggered.
+ *
+ * updateChannel() does not call epoll_ctl(). It only queues the fd on a
+ * changelist; poll() applies the net change per fd right before waiting,
+ * so enable/disable pairs within one loop iteration cost nothing and
+ * repeated changes collapse into at most one ADD, MOD or DEL.
+ *
+ * Channel::index() is the channel's slot state, so no per-fd side table
+ * is needed: kNew (-1) when unknown, otherwise a bitmask of what epoll
+ * currently has registered (kSlotRead/kSlotWrite/kSlotEdge) plus
+ * kSlotQueued while the channel sits on the changelist.
+ */
+class EpollPoller : public Poller {
+  public:
+    explicit EpollPoller(EventLoop* loop);
+    ~EpollPoller() override;
+
+    void poll(std::chrono::milliseconds timeout,
+              ChannelList* activeChannels) override;
+
+    void updateChannel(Channel* channel) override;
+    void removeChannel(Channel* channel) override;
+
+    [[nodiscard]] const char* backendName() const override { return "epoll"; }
+
+  private:
+    static constexpr int kNew = -1;
+    static constexpr int kSlotRead = 1 << 0;
+    static constexpr int kSlotWrite = 1 << 1;
+    static constexpr int kSlotEdge = 1 << 2;
+    static constexpr int kSlotQueued = 1 << 3;
+    static constexpr int kSlotKernelMask = kSlotRead | kSlotWrite | kSlotEdge;
+
+    static uint32_t toEpollEvents(int slotBits);
+
+    void flushChanges();
+    void fillActiveChannels(int numEvents, ChannelList* activeChannels);
+    void control(int operation, int fd, Channel* channel, uint32_t events);
+
+    int epollFd_;
+    std::vector<struct epoll_event> events_; // For epoll_wait() results
+    std::vector<int> changelist_;            // fds with kSlotQueued set
+};
+} // namespace hayai
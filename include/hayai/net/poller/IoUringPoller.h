@@ -0,0 +1,158 @@
+#pragma once
+
+#include "hayai/net/Poller.h"
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <memory>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <vector>
+
+namespace hayai {
+
+/**
+ * @brief io_uring(7) backend (Linux 5.11+), opt-in via HAYAI_USE_IO_URING.
+ *
+ * Channels are served in two ways:
+ *
+ * - Completion (Channel::ReadOp, Channel::send()): read interest keeps an
+ *   IORING_OP_RECV or IORING_OP_ACCEPT armed, and send() submits an
+ *   IORING_OP_SENDMSG. The kernel performs the operation once the socket
+ *   is ready and posts its result, so the owner issues no read, write or
+ *   accept syscall and waits for no readiness event first. Receives pick
+ *   a buffer from a pool the ring owns (IOSQE_BUFFER_SELECT): an idle
+ *   connection pins no memory. The bytes are handed over from there, and
+ *   the buffer goes back to the kernel with the next submission.
+ *
+ * - Readiness: one-shot IORING_OP_POLL_ADD, for everything else (write
+ *   interest, channels with ReadOp::Readiness). Polls are re-armed after
+ *   dispatch; because the kernel checks readiness when a poll is armed,
+ *   this keeps level-triggered semantics (unread data is reported again),
+ *   same as EpollPoller. Edge-triggered channels are served the same way,
+ *   which is a superset of what they need.
+ *
+ * Either way nothing reaches the kernel outside poll(): arms, re-arms,
+ * sends, cancellations and returned buffers are queued in the submission
+ * ring and handed over together with the wait, so each loop iteration
+ * costs a single io_uring_enter() no matter how many operations it
+ * started or finished. The exception is work queued while no poll() is
+ * coming (outside loop(), or as it returns): submitPending() hands it
+ * over on its own.
+ *
+ * A send or accept still in flight when its channel is removed is
+ * cancelled; its state, and the send's keep-alive reference to the
+ * channel's owner (whose bytes the kernel reads), are only dropped once
+ * the kernel has posted its completion.
+ */
+class IoUringPoller : public Poller {
+  public:
+    explicit IoUringPoller(EventLoop* loop, unsigned entries = 1024);
+    ~IoUringPoller() override;
+
+    void poll(std::chrono::milliseconds timeout,
+              ChannelList* activeChannels) override;
+
+    void updateChannel(Channel* channel) override;
+    void removeChannel(Channel* channel) override;
+
+    [[nodiscard]] const char* backendName() const override {
+        return "io_uring";
+    }
+
+    [[nodiscard]] bool completionIo() const override { return true; }
+    void submitSend(Channel* channel, const struct iovec* iov,
+                    int iovcnt) override;
+    void submitPending() override;
+
+    // Probe whether the running kernel provides what this backend needs
+    static bool isSupported();
+
+    // Receive buffer pool: a receive completes into one of these
+    static constexpr unsigned kRecvBuffers = 256;
+    static constexpr size_t kRecvBufferSize = 16 * 1024;
+
+  private:
+    static constexpr int kNew = -1;
+    static constexpr int kAdded = 1;
+
+    // A send or accept; the kernel reads (or fills) the fields below
+    // until the completion is posted, so they live on the heap
+    struct Op {
+        Channel* channel{nullptr}; // nullptr: orphaned by removeChannel()
+        bool inFlight{false};
+        std::shared_ptr<void> keep; // send: the owner of the bytes
+        struct msghdr msg {};
+        std::vector<struct iovec> iov;
+        struct sockaddr_storage addr {};
+        socklen_t addrLen{0};
+    };
+
+    // Per-fd ring state, in a flat table parallel to channels_
+    struct Registration {
+        uint64_t pollData{0}; // armed POLL_ADD (0: none)
+        uint32_t armedMask{0};
+        uint64_t recvData{0}; // armed RECV (0: none)
+        bool readCancelled{false}; // cancel of the RECV/ACCEPT submitted
+        bool dirty{false};
+        std::unique_ptr<Op> accept;
+        std::unique_ptr<Op> send;
+    };
+
+    Registration& registrationAt(int fd);
+    void markDirty(int fd, Registration& reg);
+    void flushChanges();
+    void flushReadOp(int fd, Channel* channel, Registration& reg);
+    void fillActiveChannels(ChannelList* activeChannels);
+    void completeOp(Op* op, uint64_t tag, const io_uring_cqe& cqe,
+                    ChannelList* activeChannels);
+    // Retire an op on removal; one still in flight is cancelled first
+    void releaseOp(std::unique_ptr<Op> op, uint64_t tag);
+    void returnBuffers();
+    uint64_t nextUserData(int fd, uint64_t tag);
+
+    io_uring_sqe* getSqe();
+    void pushSqe();
+    void submitPollAdd(int fd, uint32_t mask, uint64_t userData);
+    void submitPollRemove(uint64_t userData);
+    void submitRecv(int fd, uint64_t userData);
+    void submitAccept(int fd, Op& op);
+    void submitCancel(uint64_t userData);
+    void provideBuffers(unsigned bid, unsigned count);
+    int enter(unsigned minComplete, const struct timespec* ts);
+
+    int ringFd_;
+    unsigned toSubmit_{0};
+    uint32_t nextGen_{1};
+
+    // Submission queue
+    void* sqRing_{nullptr};
+    size_t sqRingSize_{0};
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqMask_;
+    unsigned* sqEntries_;
+    unsigned* sqArray_;
+    io_uring_sqe* sqes_{nullptr};
+    size_t sqesSize_{0};
+
+    // Completion queue (shares sqRing_ with IORING_FEAT_SINGLE_MMAP)
+    void* cqRing_{nullptr};
+    size_t cqRingSize_{0};
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned* cqMask_;
+    io_uring_cqe* cqes_;
+
+    std::vector<Registration> registrations_;
+    std::vector<int> dirtyFds_;
+
+    std::unique_ptr<char[]> recvBuffers_;
+    // Handed to the last batch's owners; returned with the next poll()
+    std::vector<unsigned> usedBuffers_;
+    // Orphans waiting for their completion
+    std::vector<Op*> orphans_;
+    // Dropped at the next poll(), once this batch has been dispatched
+    std::vector<std::unique_ptr<Op>> retiredOps_;
+    std::vector<std::shared_ptr<void>> releasedKeeps_;
+};
+} // namespace hayai
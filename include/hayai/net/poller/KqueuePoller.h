@@ -0,0 +1,47 @@
+#pragma once
+
+#include "hayai/net/Poller.h"
+#include <sys/event.h>
+#include <vector>
+
+namespace hayai {
+
+/**
+ * @brief kqueue(2) backend (macOS / BSD).
+ *
+ * updateChannel() appends only the filters that actually changed to a
+ * changelist, which is handed to the kernel by the kevent() call in the
+ * next poll(), so interest changes cost no extra syscalls.
+ *
+ * Channel::index() is the channel's slot state: kNew (-1) when unknown,
+ * otherwise the Channel::kReadEvent/kWriteEvent filters it wants, some of
+ * which may still sit in the changelist. What the kernel has already been
+ * given is tracked per fd in applied_, so removeChannel() deletes only
+ * filters that exist there.
+ */
+class KqueuePoller : public Poller {
+  public:
+    explicit KqueuePoller(EventLoop* loop);
+    ~KqueuePoller() override;
+
+    void poll(std::chrono::milliseconds timeout,
+              ChannelList* activeChannels) override;
+
+    void updateChannel(Channel* channel) override;
+    void removeChannel(Channel* channel) override;
+
+    [[nodiscard]] const char* backendName() const override { return "kqueue"; }
+
+  private:
+    static constexpr int kNew = -1;
+
+    void fillActiveChannels(int numEvents, ChannelList* activeChannels);
+    // Record the changelist in applied_ as it goes to the kernel
+    void applyChanges();
+
+    int kqueueFd_;
+    std::vector<struct kevent> events_;  // For kevent() results
+    std::vector<struct kevent> changes_; // Submitted with the next kevent()
+    std::vector<int> applied_; // fd -> filters submitted to the kernel
+};
+} // namespace hayai
@@ -1,13 +1,25 @@
 #pragma once
 
+#include "hayai/utils/ByteScan.h"
+#include "hayai/utils/SlabPool.h"
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <string_view>
-#include <vector>
+#include <type_traits>
 
 namespace hayai {
 
+// Frees either kind of Buffer storage: a SlabPool block, or a ring's
+// double mapping of mirrorSize bytes
+struct BufferStorageDeleter {
+  size_t mirrorSize{0};
+  void operator()(char *p) const noexcept;
+};
+
 /**
  * @brief A dynamic buffer for network I/O inspired by Muduo/Trantor.
  *
@@ -17,18 +29,65 @@ namespace hayai {
  * |                   |     (CONTENT)    |                  |
  * +-------------------+------------------+------------------+
  * |                   |                  |                  |
- * 0      <=      readerIndex   <=   writerIndex    <=     size
-
+ * 0      <=      readerIndex   <=   writerIndex    <=   capacity
+ *
+ * Storage is a raw allocation that is never value-initialized: every byte
+ * is written before it is read, so growing a buffer for a large read or
+ * append costs the allocation and the move of the readable bytes, not a
+ * memset. Growth is geometric (at least doubling). Blocks come from the
+ * current EventLoop's SlabPool, rounded up to its size class.
+ *
+ * Ring mode (makeRing()): the storage is a memfd mapped twice back to
+ * back, so [readerIndex, writerIndex) may run past capacity into the
+ * mirror and the readable and writable bytes are always contiguous.
+ * Consuming from the front never costs a memmove; the indices just wrap.
+ * For long-lived streams consumed in pieces, where compaction would
+ * otherwise keep moving the leftovers.
  */
 
 class Buffer {
 public:
   static constexpr size_t kInitialSize = 1024;
   static constexpr size_t kCheapPrepend = 8;
+  // Overflow area readFd() reads into past the buffer's own free space
+  static constexpr size_t kDefaultReadOverflow = 64 * 1024;
+  // readFd() pre-grows the buffer to recent read sizes up to this
+  static constexpr size_t kMaxReadHint = 256 * 1024;
 
   explicit Buffer(size_t initialSize = kInitialSize)
-      : buffer_(kCheapPrepend + initialSize), readerIndex_(kCheapPrepend),
-        writerIndex_(kCheapPrepend) {}
+      : capacity_(kCheapPrepend + initialSize), readerIndex_(kCheapPrepend),
+        writerIndex_(kCheapPrepend) {
+    buffer_.reset(static_cast<char *>(SlabPool::allocate(capacity_)));
+  }
+
+  // Copies the readable bytes only (into a plain buffer, also from a ring)
+  Buffer(const Buffer &other) : Buffer(other.readableBytes()) {
+    append(other.peek(), other.readableBytes());
+    readHint_ = other.readHint_;
+  }
+
+  Buffer &operator=(const Buffer &other) {
+    if (this != &other) {
+      Buffer(other).swap(*this);
+    }
+    return *this;
+  }
+
+  // The moved-from buffer is left empty (no storage) but usable: the next
+  // append allocates again
+  Buffer(Buffer &&other) noexcept
+      : buffer_(std::move(other.buffer_)), capacity_(other.capacity_),
+        readerIndex_(other.readerIndex_), writerIndex_(other.writerIndex_),
+        readHint_(other.readHint_) {
+    other.capacity_ = 0;
+    other.readerIndex_ = 0;
+    other.writerIndex_ = 0;
+  }
+
+  Buffer &operator=(Buffer &&other) noexcept {
+    Buffer(std::move(other)).swap(*this);
+    return *this;
+  }
 
   // Sizes
   [[nodiscard]] size_t readableBytes() const {
@@ -36,46 +95,145 @@ public:
   }
 
   [[nodiscard]] size_t writableBytes() const {
-    return buffer_.size() - readerIndex_;
+    // A ring's free space continues in the mirror up to readerIndex_
+    return capacity_ - writerIndex_ + (isRing() ? readerIndex_ : 0);
+  }
+
+  [[nodiscard]] size_t prependableBytes() const {
+    // In a ring the bytes before readerIndex_ are the end of the free space
+    return isRing() ? std::min(readerIndex_, writableBytes()) : readerIndex_;
   }
 
-  [[nodiscard]] size_t prependableBytes() const { return readerIndex_; }
+  /**
+   * @brief Switch to a double-mapped ring of at least `capacity` bytes
+   * (rounded up to whole pages), keeping the content.
+   *
+   * Growth still works and stays a ring. Returns false, leaving the buffer
+   * as it is, where memfd_create() and fixed mappings aren't available or
+   * the mapping fails (e.g. out of map count).
+   */
+  bool makeRing(size_t capacity);
+  [[nodiscard]] bool isRing() const {
+    return buffer_.get_deleter().mirrorSize != 0;
+  }
+  [[nodiscard]] size_t capacity() const { return capacity_; }
 
   // Read access
   [[nodiscard]] const char *peek() const { return begin() + readerIndex_; }
 
-  // Find operations
-  [[nodiscard]] const char *findCRLF() const {
-    static constexpr char kCRLF[] = "\r\n";
-    const char *crlf = std::search(peek(), peek() + readableBytes(),
-                                   std::begin(kCRLF), std::end(kCRLF) - 1);
-    return crlf == (peek() + readableBytes()) ? nullptr : crlf;
+  /**
+   * Find operations (SIMD, see ByteScan.h). Each returns the first match
+   * in the readable bytes, or nullptr.
+   *
+   * `from` resumes a search: matches ending before offset `from` (from
+   * peek()) are skipped. After a miss, pass the readableBytes() seen then
+   * and only the bytes appended since are scanned (plus one, for a CRLF
+   * split across reads). Subtract whatever is retrieved in between.
+   */
+  [[nodiscard]] const char *findCRLF(size_t from = 0) const {
+    from = std::min(from, readableBytes());
+    return hayai::findCRLF(peek() + (from > 0 ? from - 1 : 0), beginWrite());
+  }
+
+  // First '\n'
+  [[nodiscard]] const char *findEOL(size_t from = 0) const {
+    return findByte('\n', from);
+  }
+
+  [[nodiscard]] const char *findByte(char c, size_t from = 0) const {
+    from = std::min(from, readableBytes());
+    return hayai::findByte(peek() + from, beginWrite(), c);
   }
 
+  [[nodiscard]] const char *findAnyOf(std::string_view set,
+                                      size_t from = 0) const {
+    from = std::min(from, readableBytes());
+    return hayai::findAnyOf(peek() + from, beginWrite(), set);
+  }
+
+  // Integers in network byte order (big-endian) at peek(); the readable
+  // bytes must cover them
+  [[nodiscard]] int64_t peekInt64() const { return peekInt<int64_t>(); }
+  [[nodiscard]] int32_t peekInt32() const { return peekInt<int32_t>(); }
+  [[nodiscard]] int16_t peekInt16() const { return peekInt<int16_t>(); }
+  [[nodiscard]] int8_t peekInt8() const { return peekInt<int8_t>(); }
+
+  // peekInt*() and retrieve() in one
+  int64_t readInt64() { return readInt<int64_t>(); }
+  int32_t readInt32() { return readInt<int32_t>(); }
+  int16_t readInt16() { return readInt<int16_t>(); }
+  int8_t readInt8() { return readInt<int8_t>(); }
+
   // Write access
   void append(const char *data, size_t len) {
     ensureWritableBytes(len);
-    std::copy(data, data + len, beginWrite());
+    if (len > 0) {
+      std::memcpy(beginWrite(), data, len);
+    }
     writerIndex_ += len;
   }
 
   void append(std::string_view str) { append(str.data(), str.size()); }
 
-  // Read from socket
-  ssize_t readFd(int fd, int *savedErrno);
+  // Network byte order (big-endian)
+  void appendInt64(int64_t x) { appendInt(x); }
+  void appendInt32(int32_t x) { appendInt(x); }
+  void appendInt16(int16_t x) { appendInt(x); }
+  void appendInt8(int8_t x) { appendInt(x); }
+
+  /**
+   * @brief Put `len` bytes right before the readable ones, in place.
+   *
+   * For headers that depend on the payload (a length prefix): append the
+   * payload, then prepend the header without moving it. A fresh buffer
+   * has kCheapPrepend bytes of room; prependableBytes() says how many.
+   */
+  void prepend(const void *data, size_t len) {
+    assert(len <= prependableBytes());
+    readerIndex_ -= len;
+    std::memcpy(begin() + readerIndex_, data, len);
+  }
+
+  void prependInt64(int64_t x) { prependInt(x); }
+  void prependInt32(int32_t x) { prependInt(x); }
+  void prependInt16(int16_t x) { prependInt(x); }
+  void prependInt8(int8_t x) { prependInt(x); }
+
+  /**
+   * @brief Read from a socket with one readv().
+   *
+   * Whatever doesn't fit the free space lands in a per-thread overflow
+   * area and is then copied in (reported through `overflowBytes`). The
+   * buffer adapts: before each read it makes room for what recent reads
+   * brought in (up to kMaxReadHint), so a steady stream of large reads
+   * lands directly in place after the first few.
+   */
+  ssize_t readFd(int fd, int *savedErrno, size_t *overflowBytes = nullptr);
+
+  // Size of the calling thread's overflow area (0: none, reads are capped
+  // by the free space, which a full buffer grows first). Takes effect on
+  // that thread's next readFd().
+  static void setReadOverflowSize(size_t bytes);
+  [[nodiscard]] static size_t readOverflowSize();
 
   void retrieve(size_t len) {
     assert(len <= readableBytes());
     if (len < readableBytes()) {
       readerIndex_ += len;
+      if (readerIndex_ >= capacity_) {
+        // Only a ring's reader gets here: continue in the first copy
+        readerIndex_ -= capacity_;
+        writerIndex_ -= capacity_;
+      }
     } else {
       retrieveAll();
     }
   }
 
   void retrieveAll() {
-    readerIndex_ = kCheapPrepend;
-    writerIndex_ = kCheapPrepend;
+    // min(): a moved-from buffer has no storage to rewind into
+    readerIndex_ = std::min(kCheapPrepend, capacity_);
+    writerIndex_ = readerIndex_;
   }
 
   [[nodiscard]] std::string retrieveAllAsString() {
@@ -98,6 +256,7 @@ public:
     }
   }
 
+  // The result is a plain buffer, also from a ring
   void shrink(size_t reserve) {
     Buffer other;
     other.ensureWritableBytes(readableBytes() + reserve);
@@ -107,14 +266,56 @@ public:
 
   void swap(Buffer &ths) noexcept {
     buffer_.swap(ths.buffer_);
+    std::swap(capacity_, ths.capacity_);
     std::swap(readerIndex_, ths.readerIndex_);
     std::swap(writerIndex_, ths.writerIndex_);
+    std::swap(readHint_, ths.readHint_);
   }
 
 private:
-  char *begin() { return buffer_.data(); }
+  using Storage = std::unique_ptr<char[], BufferStorageDeleter>;
+
+  // A ring of at least `capacity` holding the readable bytes, or nullptr
+  Storage mapRing(size_t &capacity) const;
+
+  template <typename Int> [[nodiscard]] Int peekInt() const {
+    assert(readableBytes() >= sizeof(Int));
+    std::make_unsigned_t<Int> u = 0;
+    for (size_t i = 0; i < sizeof(Int); ++i) {
+      u = static_cast<decltype(u)>((u << 8) | static_cast<uint8_t>(peek()[i]));
+    }
+    return static_cast<Int>(u);
+  }
 
-  const char *begin() const { return buffer_.data(); }
+  template <typename Int> Int readInt() {
+    const Int x = peekInt<Int>();
+    retrieve(sizeof(Int));
+    return x;
+  }
+
+  template <typename Int> static void storeBigEndian(char *out, Int x) {
+    auto u = static_cast<std::make_unsigned_t<Int>>(x);
+    for (size_t i = sizeof(Int); i-- > 0;) {
+      out[i] = static_cast<char>(u & 0xff);
+      u = static_cast<decltype(u)>(u >> 8);
+    }
+  }
+
+  template <typename Int> void appendInt(Int x) {
+    char bytes[sizeof(Int)];
+    storeBigEndian(bytes, x);
+    append(bytes, sizeof(bytes));
+  }
+
+  template <typename Int> void prependInt(Int x) {
+    char bytes[sizeof(Int)];
+    storeBigEndian(bytes, x);
+    prepend(bytes, sizeof(bytes));
+  }
+
+  char *begin() { return buffer_.get(); }
+
+  const char *begin() const { return buffer_.get(); }
 
   char *beginWrite() { return begin() + writerIndex_; }
 
@@ -123,19 +324,37 @@ private:
   // Instead of always growing the buffer, check if we can reclaim space
   // from the front by moving data forward
   void makeSpace(size_t len) {
-    if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
-      buffer_.resize(writerIndex_ + len);
-    } else {
-      size_t readable = readableBytes();
-      std::copy(begin() + readerIndex_, begin() + writerIndex_,
-                begin() + kCheapPrepend);
-      readerIndex_ = kCheapPrepend;
-      writerIndex_ = readerIndex_ + readable;
+    const size_t readable = readableBytes();
+    if (isRing() ||
+        writableBytes() + prependableBytes() < len + kCheapPrepend) {
+      // Geometric growth; the readable bytes move to the front of the new
+      // block, which also reclaims the consumed prefix. A ring never
+      // compacts (its free space is whole already); it grows into a ring.
+      const size_t needed = kCheapPrepend + readable + len;
+      size_t capacity = std::max(needed, capacity_ * 2);
+      Storage grown;
+      if (isRing()) {
+        grown = mapRing(capacity);
+      }
+      if (!grown) {
+        grown.reset(static_cast<char *>(SlabPool::allocate(capacity)));
+        if (readable > 0) {
+          std::memcpy(grown.get() + kCheapPrepend, peek(), readable);
+        }
+      }
+      buffer_ = std::move(grown);
+      capacity_ = capacity;
+    } else if (readable > 0) {
+      std::memmove(begin() + kCheapPrepend, peek(), readable);
     }
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = readerIndex_ + readable;
   }
 
-  std::vector<char> buffer_;
+  Storage buffer_;
+  size_t capacity_; // a ring's physical size; its indices run up to twice it
   size_t readerIndex_;
   size_t writerIndex_;
+  size_t readHint_{0}; // smoothed recent readFd() size
 };
 } // namespace hayai
\ No newline at end of file
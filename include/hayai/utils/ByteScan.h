@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string_view>
+
+namespace hayai {
+
+/**
+ * @brief Vectorized delimiter search over [begin, end).
+ *
+ * x86-64 uses AVX2 when the CPU has it (checked once at startup) and SSE2
+ * otherwise; other targets fall back to memchr() and a scalar table scan.
+ * Each returns the first match, or nullptr.
+ */
+
+// First '\r' immediately followed by '\n'
+const char* findCRLF(const char* begin, const char* end);
+
+const char* findByte(const char* begin, const char* end, char c);
+
+// First byte that is any of `set`. Sets up to kMaxVectorSet bytes are
+// matched in SIMD registers; larger sets use a 256-entry table.
+inline constexpr size_t kMaxVectorSet = 8;
+const char* findAnyOf(const char* begin, const char* end, std::string_view set);
+
+} // namespace hayai
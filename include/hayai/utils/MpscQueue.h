@@ -0,0 +1,85 @@
+#pragma once
+
+#include "hayai/utils/NonCopyable.h"
+#include <atomic>
+
+namespace hayai {
+
+/**
+ * @brief Hook embedded in every element of an MpscQueue.
+ */
+struct MpscNode {
+    std::atomic<MpscNode*> mpscNext{nullptr};
+};
+
+/**
+ * @brief Intrusive lock-free multi-producer / single-consumer queue
+ * (Dmitry Vyukov's design).
+ *
+ * - push(): any thread, wait-free (one exchange + one store)
+ * - pop():  owner thread only; returns nullptr when empty, or while a
+ *           producer is between its two steps (the element shows up on a
+ *           later pop, so callers must be woken again by the producer)
+ *
+ * The queue never allocates and never owns its elements: T must derive
+ * from MpscNode, and whoever pops a node is responsible for it.
+ */
+template <typename T>
+class MpscQueue : NonCopyable {
+  public:
+    MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+    void push(T* node) { push(static_cast<MpscNode*>(node)); }
+
+    T* pop() {
+        MpscNode* tail = tail_;
+        MpscNode* next = tail->mpscNext.load(std::memory_order_acquire);
+
+        if (tail == &stub_) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->mpscNext.load(std::memory_order_acquire);
+        }
+
+        if (next != nullptr) {
+            tail_ = next;
+            return static_cast<T*>(tail);
+        }
+
+        if (tail != head_.load(std::memory_order_acquire)) {
+            // A producer swapped head_ but hasn't linked its node yet
+            return nullptr;
+        }
+
+        // tail is the last element: put the stub behind it to detach it
+        push(&stub_);
+        next = tail->mpscNext.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail_ = next;
+            return static_cast<T*>(tail);
+        }
+        return nullptr;
+    }
+
+    // Owner thread only; racy snapshot otherwise
+    [[nodiscard]] bool empty() const {
+        return tail_ == &stub_ &&
+               stub_.mpscNext.load(std::memory_order_acquire) == nullptr;
+    }
+
+  private:
+    void push(MpscNode* node) {
+        node->mpscNext.store(nullptr, std::memory_order_relaxed);
+        MpscNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->mpscNext.store(node, std::memory_order_release);
+    }
+
+    MpscNode stub_;
+    alignas(64) std::atomic<MpscNode*> head_; // producers
+    alignas(64) MpscNode* tail_;              // consumer
+};
+
+} // namespace hayai
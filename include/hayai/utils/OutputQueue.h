@@ -0,0 +1,151 @@
+#pragma once
+
+#include "hayai/utils/Buffer.h"
+#include "hayai/utils/NonCopyable.h"
+#include "hayai/utils/SlabPool.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <variant>
+#include <vector>
+
+struct iovec;
+
+namespace hayai {
+
+/**
+ * @brief Chain of pending output segments, flushed with writev().
+ *
+ * Five kinds of segment:
+ * - copied:   small writes are packed into fixed-size owned blocks, so a
+ *             burst of small messages still goes out as one iovec
+ * - borrowed: the caller's bytes, referenced as-is; the caller keeps them
+ *             alive until written (static responses, long-lived tables)
+ * - shared:   the caller's bytes plus a refcounted owner that is released
+ *             once the last byte leaves, so large bodies are never copied
+ * - owned:    a std::string or Buffer moved in by the caller and freed
+ *             once written; no copy and no refcount
+ * - file:     a byte range of an open file, sent with sendfile() so the
+ *             bytes never enter user space; the caller keeps the fd open
+ *
+ * Shared segments may be marked zero-copy: a run of them goes out with
+ * sendmsg(MSG_ZEROCOPY), and their owners stay pinned after the bytes
+ * are consumed, until reapZeroCopy() reads the kernel's completion from
+ * the socket error queue (the kernel keeps reading the pages until then).
+ * retrieveAll() leaves them pinned; destroying the queue drops them, so a
+ * queue with pins outstanding hands them over with adoptPinned() first.
+ *
+ * writeFd() gathers up to IOV_MAX memory segments per syscall, stopping
+ * where the kind of write changes (a file or zero-copy run gets its own
+ * calls once it reaches the head), so ordering is preserved. Consumed blocks
+ * and segment slots are recycled, so a steady stream of writes does not
+ * allocate.
+ */
+class OutputQueue : NonCopyable {
+  public:
+    // Owned block size for copied segments
+    static constexpr size_t kBlockSize = 4096;
+    // Shared segments smaller than this are cheaper to copy than to chain
+    static constexpr size_t kMinShareBytes = 1024;
+
+    OutputQueue() = default;
+
+    // Pending bytes, file ranges included
+    [[nodiscard]] size_t readableBytes() const { return bytes_; }
+    // Pending bytes held in memory (what backpressure should look at)
+    [[nodiscard]] size_t bufferedBytes() const { return bytes_ - fileBytes_; }
+    [[nodiscard]] bool empty() const { return bytes_ == 0; }
+    // Bytes consumed since construction; a position in the stream
+    [[nodiscard]] uint64_t consumedBytes() const { return consumed_; }
+    [[nodiscard]] size_t segmentCount() const {
+        return segments_.size() - head_;
+    }
+
+    void append(const char* data, size_t len);
+    void append(std::string_view data) { append(data.data(), data.size()); }
+
+    void appendBorrowed(std::string_view data);
+    // zeroCopy: only on a socket with SO_ZEROCOPY enabled, or the owner
+    // stays pinned forever waiting for a completion that never comes
+    void appendShared(std::string_view data, std::shared_ptr<const void> owner,
+                      bool zeroCopy = false);
+
+    // Take ownership; bytes before `offset` were already sent. Small
+    // payloads are copied into a block instead (cheaper than a segment).
+    void appendOwned(std::string&& data, size_t offset = 0);
+    void appendOwned(Buffer&& data, size_t offset = 0);
+
+    // `length` bytes of `fileFd` starting at `offset`; fileFd must stay
+    // open until they are consumed
+    void appendFile(int fileFd, off_t offset, size_t length);
+
+    // One writev() of the queued segments (or one sendfile() when a file
+    // segment is at the head); consumes what was written. Returns the
+    // syscall result, with errno saved on failure. A file that ends before
+    // its range does fails with EIO.
+    ssize_t writeFd(int fd, int* savedErrno);
+
+    // For writers that don't go through writeFd() (io_uring sends): up
+    // to `maxCount` of the plain memory segments at the head, as writeFd()
+    // would gather them. 0 when the head is a file or zero-copy segment.
+    // The bytes stay put until retrieve()d, whatever is appended meanwhile.
+    int peekMemory(struct iovec* vec, int maxCount) const;
+
+    void retrieve(size_t len);
+    void retrieveAll();
+
+    // Read zero-copy completions queued on `fd`'s error queue and unpin
+    // the owners they cover. Returns the sends completed; `copiedSends`
+    // counts those where the kernel fell back to copying (loopback, some
+    // NICs), for which MSG_ZEROCOPY only added overhead.
+    size_t reapZeroCopy(int fd, size_t* copiedSends);
+    // Zero-copy sends whose completion hasn't arrived yet
+    [[nodiscard]] size_t pinnedCount() const { return pinned_.size(); }
+    // Take over `other`'s pinned owners, to reap them past its lifetime
+    void adoptPinned(OutputQueue& other);
+
+  private:
+    struct Segment {
+        const char* data{nullptr}; // first unsent byte
+        size_t len{0};             // unsent bytes
+        SlabBlock block; // storage of a copied segment
+        size_t capacity{0};
+        std::shared_ptr<const void> owner; // keeps a shared segment alive
+        // Storage of an owned segment. Both keep their bytes on the heap
+        // (small strings are copied, never stored), so `data` survives
+        // moves of the segment.
+        std::variant<std::monostate, std::string, Buffer> storage;
+        int fileFd{-1}; // file segment: source fd, `data` unused
+        off_t fileOffset{0};
+        bool zeroCopy{false};
+    };
+
+    struct Pinned {
+        uint32_t seq; // kernel's zero-copy send counter
+        std::shared_ptr<const void> owner;
+    };
+
+    Segment& pushSegment();
+    void popSegment();
+    ssize_t writeFile(int fd, int* savedErrno);
+    ssize_t writeZeroCopy(int fd, int* savedErrno);
+    int gather(struct iovec* vec, bool zeroCopy, int maxCount) const;
+
+    std::vector<Segment> segments_; // [head_, size) are pending
+    size_t head_{0};
+    size_t bytes_{0};
+    size_t fileBytes_{0};
+    uint64_t consumed_{0};
+
+    std::vector<Pinned> pinned_; // ordered by seq
+    uint32_t zeroCopySeq_{0};   // seq of the next zero-copy send
+
+    // Last fully sent block, reused by the next copy
+    SlabBlock spare_;
+    size_t spareCapacity_{0};
+};
+
+} // namespace hayai
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace hayai {
+
+/**
+ * @brief Immutable, refcounted bytes for fan-out sends.
+ *
+ * Copying a slice only bumps a refcount; every copy views the same bytes.
+ * TcpConnection::send(const SharedSlice&) queues the bytes by reference
+ * and drops its copy once they are written, so a payload broadcast to
+ * many connections exists once and is freed when the last of them has
+ * flushed it (see TcpServer::broadcast).
+ *
+ * copyOf() puts the refcount and the bytes in one block from the calling
+ * thread's SlabPool; it goes back there from whichever thread releases
+ * the last copy. The bytes are never written after construction, so
+ * copies may be read from any thread.
+ */
+class SharedSlice {
+  public:
+    SharedSlice() = default;
+
+    // One allocation: refcount and a copy of `bytes`
+    static SharedSlice copyOf(std::string_view bytes);
+    // Takes the string without copying its bytes
+    static SharedSlice adopt(std::string&& bytes);
+
+    [[nodiscard]] const char* data() const { return data_; }
+    [[nodiscard]] size_t size() const { return size_; }
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+    [[nodiscard]] std::string_view view() const { return {data_, size_}; }
+    operator std::string_view() const { return view(); }
+
+    // `len` bytes from `offset`, sharing this slice's storage
+    [[nodiscard]] SharedSlice slice(size_t offset,
+                                    size_t len = std::string_view::npos) const {
+        assert(offset <= size_);
+        SharedSlice sub(*this);
+        sub.data_ += offset;
+        sub.size_ = std::min(len, size_ - offset);
+        return sub;
+    }
+
+    // Keeps the bytes alive; what the output queue holds on to
+    [[nodiscard]] const std::shared_ptr<const void>& owner() const {
+        return owner_;
+    }
+    // Copies alive, slices of the same storage included
+    [[nodiscard]] long useCount() const { return owner_.use_count(); }
+
+  private:
+    SharedSlice(std::shared_ptr<const void> owner, const char* data,
+                size_t size)
+        : owner_(std::move(owner)), data_(data), size_(size) {}
+
+    std::shared_ptr<const void> owner_;
+    const char* data_{nullptr};
+    size_t size_{0};
+};
+
+} // namespace hayai
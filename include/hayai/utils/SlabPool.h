@@ -0,0 +1,87 @@
+#pragma once
+
+#include "hayai/utils/NonCopyable.h"
+#include <cstddef>
+#include <memory>
+
+namespace hayai {
+
+/**
+ * @brief Per-thread slab allocator for connection objects and buffer blocks.
+ *
+ * Power-of-two size classes from kMinBlock to kMaxBlock, carved from
+ * chunks and recycled through a free list per class. The pool belongs to
+ * the thread that created it (each EventLoop owns one): allocation takes
+ * from that thread's pool without locks, and a block freed by another
+ * thread is pushed onto a lock-free return stack that the owner drains on
+ * its next allocation of that class, so blocks always come home.
+ *
+ * Every block carries a small header naming its pool, so release() works
+ * from any thread and needs no size. Larger blocks, and blocks requested
+ * on a thread without a pool, go to the global heap with the same header.
+ *
+ * Memory stays with the pool at its high-water mark until the pool is
+ * destroyed; blocks still in use at that point keep the slabs alive, and
+ * the last of them frees them.
+ */
+class SlabPool : NonCopyable {
+  public:
+    static constexpr size_t kMinBlock = 64;
+    static constexpr size_t kMaxBlock = 64 * 1024;
+
+    SlabPool();
+    ~SlabPool();
+
+    // The calling thread's pool (its EventLoop's), or nullptr
+    static SlabPool* current();
+
+    // At least `size` bytes, aligned for any type; `size` is raised to the
+    // usable size of the block. Never returns nullptr (throws bad_alloc).
+    static void* allocate(size_t& size);
+    static void* allocate(size_t&& size) { return allocate(size); }
+    // Any thread; p may be nullptr
+    static void release(void* p) noexcept;
+
+    // Bytes carved into slabs so far
+    [[nodiscard]] size_t slabBytes() const;
+    // Blocks released by other threads and taken back since creation
+    [[nodiscard]] size_t remoteReleases() const;
+
+  private:
+    struct Core;
+    Core* core_;
+};
+
+// unique_ptr deleter for blocks from SlabPool::allocate()
+struct SlabDeleter {
+    void operator()(void* p) const noexcept { SlabPool::release(p); }
+};
+
+using SlabBlock = std::unique_ptr<char[], SlabDeleter>;
+
+/**
+ * @brief Stateless std allocator over SlabPool, for std::allocate_shared.
+ *
+ * Objects come from the allocating thread's pool and go back to it from
+ * whichever thread drops the last reference.
+ */
+template <typename T>
+struct SlabAllocator {
+    using value_type = T;
+
+    SlabAllocator() noexcept = default;
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(SlabPool::allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t) noexcept { SlabPool::release(p); }
+
+    template <typename U>
+    bool operator==(const SlabAllocator<U>&) const noexcept {
+        return true;
+    }
+};
+
+} // namespace hayai
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace hayai {
+
+// Inline bytes of the callback types used by Channel, EventLoop and
+// TcpConnection: enough for a `this` pointer plus a std::string, a
+// shared_ptr guard or a wrapped std::function.
+inline constexpr size_t kSmallFunctionCapacity = 48;
+
+template <typename Signature, size_t Capacity = kSmallFunctionCapacity>
+class SmallFunction;
+
+/**
+ * @brief Move-only replacement for std::function with inline storage.
+ *
+ * Callables up to Capacity bytes (with nothrow move) are constructed in
+ * place, so setting or queueing such a callback never touches the heap.
+ * Larger callables still work but are boxed on the heap; keep hot-path
+ * captures small or raise Capacity.
+ *
+ * Constructing from an empty std::function or a null function pointer
+ * yields an empty SmallFunction, so `if (cb)` keeps its meaning.
+ */
+template <typename R, typename... Args, size_t Capacity>
+class SmallFunction<R(Args...), Capacity> {
+  public:
+    SmallFunction() noexcept = default;
+    SmallFunction(std::nullptr_t) noexcept {}
+
+    template <typename F, typename D = std::decay_t<F>,
+              typename = std::enable_if_t<
+                  !std::is_same_v<D, SmallFunction> &&
+                  std::is_invocable_r_v<R, D&, Args...>>>
+    SmallFunction(F&& f) {
+        if constexpr (isNullable<D>()) {
+            if (!f) {
+                return;
+            }
+        }
+        if constexpr (fitsInline<D>()) {
+            ::new (static_cast<void*>(storage_)) D(std::forward<F>(f));
+            ops_ = &kInlineOps<D>;
+        } else {
+            *reinterpret_cast<D**>(storage_) = new D(std::forward<F>(f));
+            ops_ = &kHeapOps<D>;
+        }
+    }
+
+    SmallFunction(SmallFunction&& other) noexcept { moveFrom(other); }
+
+    SmallFunction& operator=(SmallFunction&& other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    SmallFunction& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    template <typename F,
+              typename = std::enable_if_t<
+                  !std::is_same_v<std::decay_t<F>, SmallFunction>>>
+    SmallFunction& operator=(F&& f) {
+        return *this = SmallFunction(std::forward<F>(f));
+    }
+
+    SmallFunction(const SmallFunction&) = delete;
+    SmallFunction& operator=(const SmallFunction&) = delete;
+
+    ~SmallFunction() { reset(); }
+
+    R operator()(Args... args) const {
+        return ops_->invoke(storage_, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    // Whether the target lives in the inline buffer (false when empty)
+    [[nodiscard]] bool isInline() const noexcept {
+        return ops_ != nullptr && ops_->inlined;
+    }
+
+  private:
+    struct Ops {
+        R (*invoke)(void* storage, Args&&... args);
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void* storage) noexcept;
+        bool inlined;
+    };
+
+    template <typename D>
+    static constexpr bool fitsInline() {
+        return sizeof(D) <= Capacity &&
+               alignof(D) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible_v<D>;
+    }
+
+    template <typename D>
+    static constexpr bool isNullable() {
+        return std::is_pointer_v<D> || std::is_member_pointer_v<D> ||
+               isStdFunction<D>::value;
+    }
+
+    template <typename D>
+    struct isStdFunction : std::false_type {};
+    template <typename Sig>
+    struct isStdFunction<std::function<Sig>> : std::true_type {};
+
+    template <typename D>
+    static constexpr Ops kInlineOps{
+        [](void* s, Args&&... args) -> R {
+            return std::invoke(*static_cast<D*>(s),
+                               std::forward<Args>(args)...);
+        },
+        [](void* dst, void* src) noexcept {
+            ::new (dst) D(std::move(*static_cast<D*>(src)));
+            static_cast<D*>(src)->~D();
+        },
+        [](void* s) noexcept { static_cast<D*>(s)->~D(); },
+        true,
+    };
+
+    template <typename D>
+    static constexpr Ops kHeapOps{
+        [](void* s, Args&&... args) -> R {
+            return std::invoke(**static_cast<D**>(s),
+                               std::forward<Args>(args)...);
+        },
+        [](void* dst, void* src) noexcept {
+            *static_cast<D**>(dst) = *static_cast<D**>(src);
+        },
+        [](void* s) noexcept { delete *static_cast<D**>(s); },
+        false,
+    };
+
+    void moveFrom(SmallFunction& other) noexcept {
+        if (other.ops_ != nullptr) {
+            other.ops_->move(storage_, other.storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    void reset() noexcept {
+        if (ops_ != nullptr) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    static_assert(Capacity >= sizeof(void*),
+                  "SmallFunction needs room for at least a pointer");
+
+    const Ops* ops_{nullptr};
+    alignas(std::max_align_t) mutable unsigned char storage_[Capacity];
+};
+
+} // namespace hayai
@@ -1,5 +1,6 @@
 #include "hayai/coro/AsyncConnection.h"
 #include "hayai/net/EventLoop.h"
+#include <cassert>
 
 #include <iostream>
 
@@ -18,15 +19,19 @@ void AsyncConnection::bindCallbacks() {
     }
     conn_->setMessageCallback([this](const TcpConnectionPtr& conn,
                                      Buffer* buf) { onMessage(conn, buf); });
-    conn_->setWriteCompleteCallback(
-        [this](const TcpConnectionPtr& conn) { onWriteComplete(conn); });
+    conn_->setConnectionCallback([this](const TcpConnectionPtr& conn) {
+        if (!conn->connected()) {
+            onClose();
+        }
+    });
 }
 
 AsyncConnection::AsyncConnection(AsyncConnection&& other) noexcept
     : conn_(std::move(other.conn_)), loop_(other.loop_),
       recvCoroutine_(std::move(other.recvCoroutine_)),
       receivedData_(std::move(other.receivedData_)),
-      sendCoroutine_(std::move(other.sendCoroutine_)) {
+      frameCodec_(other.frameCodec_), frameBytes_(other.frameBytes_),
+      closed_(other.closed_) {
     other.loop_ = nullptr;
     // Re-bind callbacks to *this* (move-from object)
     bindCallbacks();
@@ -38,7 +43,9 @@ AsyncConnection& AsyncConnection::operator=(AsyncConnection&& other) noexcept {
         loop_ = other.loop_;
         recvCoroutine_ = std::move(other.recvCoroutine_);
         receivedData_ = std::move(other.receivedData_);
-        sendCoroutine_ = std::move(other.sendCoroutine_);
+        frameCodec_ = other.frameCodec_;
+        frameBytes_ = other.frameBytes_;
+        closed_ = other.closed_;
         other.loop_ = nullptr;
         bindCallbacks();
     }
@@ -52,23 +59,31 @@ void AsyncConnection::onMessage(const TcpConnectionPtr& conn, Buffer* buf) {
     receivedData_.append(buf->peek(), buf->readableBytes());
     buf->retrieveAll();
 
-    // resume waiting coroutine if any
-    if (recvCoroutine_) {
-        auto h = *recvCoroutine_;
-        recvCoroutine_.reset();
-
-        // Resume in EventLoop thread
-        loop_->queueInLoop([h]() mutable { h.resume(); });
+    // A readFrame() keeps waiting until its frame is complete
+    std::string_view frame;
+    if (frameCodec_ != nullptr &&
+        frameCodec_->peekFrame(receivedData_, &frame) ==
+            LengthFieldCodec::Status::Incomplete) {
+        return;
     }
+
+    wakeReader();
 }
 
-void AsyncConnection::onWriteComplete(const TcpConnectionPtr& conn) {
-    std::lock_guard<std::mutex> lock(sendMutex_);
+void AsyncConnection::onClose() {
+    std::lock_guard<std::mutex> lock(recvMutex_);
+    closed_ = true;
+    // A readFrame() cut off mid-frame gets nullopt, a recv() what is left
+    wakeReader();
+}
 
-    if (sendCoroutine_) {
-        auto h = *sendCoroutine_;
-        sendCoroutine_.reset();
+void AsyncConnection::wakeReader() {
+    if (recvCoroutine_) {
+        auto h = *recvCoroutine_;
+        recvCoroutine_.reset();
+        frameCodec_ = nullptr;
 
+        // Resume in EventLoop thread
         loop_->queueInLoop([h]() mutable { h.resume(); });
     }
 }
@@ -76,10 +91,16 @@ void AsyncConnection::onWriteComplete(const TcpConnectionPtr& conn) {
 AsyncConnection::RecvAwaiter::RecvAwaiter(AsyncConnection& self)
     : self_(self) {}
 
+void AsyncConnection::consumeFrame() {
+    receivedData_.retrieve(frameBytes_);
+    frameBytes_ = 0;
+}
+
 bool AsyncConnection::RecvAwaiter::await_ready() const noexcept {
 
     std::lock_guard<std::mutex> lock(self_.recvMutex_);
-    return self_.receivedData_.readableBytes() > 0;
+    self_.consumeFrame();
+    return self_.receivedData_.readableBytes() > 0 || self_.closed_;
 }
 
 void AsyncConnection::RecvAwaiter::await_suspend(std::coroutine_handle<> h) {
@@ -88,7 +109,7 @@ void AsyncConnection::RecvAwaiter::await_suspend(std::coroutine_handle<> h) {
     waitingCoroutine_ = h;
 
     // check again after acquiring lock (data might have arrived)
-    if (self_.receivedData_.readableBytes() > 0) {
+    if (self_.receivedData_.readableBytes() > 0 || self_.closed_) {
         // data available, resume immediately
         self_.loop_->queueInLoop([h]() mutable { h.resume(); });
         return;
@@ -106,25 +127,87 @@ Buffer AsyncConnection::RecvAwaiter::await_resume() {
     return result;
 }
 
-AsyncConnection::SendAwaiter::SendAwaiter(AsyncConnection& self,
-                                          std::string data)
-    : self_(self), data_(std::move(data)) {}
+AsyncConnection::FrameAwaiter::FrameAwaiter(AsyncConnection& self,
+                                            const LengthFieldCodec& codec)
+    : self_(self), codec_(codec) {}
 
-bool AsyncConnection::SendAwaiter::await_ready() const noexcept {
-    // Always suspend for send (need to wait for write complete)
-    return false;
+bool AsyncConnection::FrameAwaiter::await_ready() {
+    std::lock_guard<std::mutex> lock(self_.recvMutex_);
+    self_.consumeFrame();
+    std::string_view frame;
+    return self_.closed_ || codec_.peekFrame(self_.receivedData_, &frame) !=
+                                LengthFieldCodec::Status::Incomplete;
 }
 
-void AsyncConnection::SendAwaiter::await_suspend(std::coroutine_handle<> h) {
-    std::lock_guard<std::mutex> lock(self_.sendMutex_);
+void AsyncConnection::FrameAwaiter::await_suspend(std::coroutine_handle<> h) {
+    std::lock_guard<std::mutex> lock(self_.recvMutex_);
 
-    waiting_coroutine_ = h;
-    self_.sendCoroutine_ = h;
+    // check again after acquiring lock (data might have arrived)
+    std::string_view frame;
+    if (self_.closed_ || codec_.peekFrame(self_.receivedData_, &frame) !=
+                             LengthFieldCodec::Status::Incomplete) {
+        self_.loop_->queueInLoop([h]() mutable { h.resume(); });
+        return;
+    }
 
-    // Send data (thread-safe - will dispatch to EventLoop)
-    self_.conn_->send(data_);
+    self_.frameCodec_ = &codec_;
+    self_.recvCoroutine_ = h;
 }
 
-void AsyncConnection::SendAwaiter::await_resume() {}
+std::optional<std::string_view>
+AsyncConnection::FrameAwaiter::await_resume() {
+    // The view points into receivedData_, which onMessage() appends to
+    // on the loop thread: only safe while the coroutine runs there too
+    self_.loop_->assertInLoopThread();
+    std::unique_lock<std::mutex> lock(self_.recvMutex_);
+
+    std::string_view frame;
+    const auto status = codec_.peekFrame(self_.receivedData_, &frame);
+    if (status == LengthFieldCodec::Status::TooLarge) {
+        self_.receivedData_.retrieveAll();
+        lock.unlock(); // the close reports back through onClose()
+        self_.conn_->forceClose();
+        return std::nullopt;
+    }
+    if (status == LengthFieldCodec::Status::Incomplete) {
+        assert(self_.closed_);
+        self_.receivedData_.retrieveAll(); // never completed
+        return std::nullopt;
+    }
+    // Consumed when the next read starts, so the view stays valid
+    self_.frameBytes_ = codec_.frameBytes(frame);
+    return frame;
+}
+
+AsyncConnection::SendAwaiter::SendAwaiter(AsyncConnection& self,
+                                          std::string data)
+    : self_(self), data_(std::move(data)) {}
+
+void AsyncConnection::SendAwaiter::await_suspend(std::coroutine_handle<> h) {
+    // Resumed at this message's position in the output stream, or with
+    // false on close. The completion is always queued on the loop, never
+    // run inside send(), so resuming from it is safe.
+    self_.conn_->send(std::move(data_),
+                      [this, h](const TcpConnectionPtr&, bool sent) {
+                          sent_ = sent;
+                          h.resume();
+                      });
+}
+
+AsyncConnection::SendFileAwaiter::SendFileAwaiter(AsyncConnection& self,
+                                                  int fd, off_t offset,
+                                                  size_t length)
+    : self_(self), fd_(fd), offset_(offset), length_(length) {}
+
+void AsyncConnection::SendFileAwaiter::await_suspend(
+    std::coroutine_handle<> h) {
+    // The completion is always queued on the loop, never run inside
+    // sendFile(), so resuming from it is safe
+    self_.conn_->sendFile(fd_, offset_, length_,
+                          [this, h](const TcpConnectionPtr&, bool sent) {
+                              sent_ = sent;
+                              h.resume();
+                          });
+}
 
 } // namespace hayai::coro
\ No newline at end of file
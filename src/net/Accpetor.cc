@@ -13,6 +13,8 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr,
   acceptSocket_.bind(listenAddr_);
 
   acceptChannel_.setReadCallback([this] { handleRead(); });
+  acceptChannel_.setCompletionCallback(
+      [this](const Channel::Completion &c) { handleAccepted(c); });
 }
 
 Acceptor::~Acceptor() {
@@ -24,6 +26,10 @@ void Acceptor::listen() {
   loop_->assertInLoopThread();
   listening_ = true;
   acceptSocket_.listen();
+  if (acceptChannel_.completionIo()) {
+    // The poller accepts for us: no readiness round trip, no accept4()
+    acceptChannel_.setReadOp(Channel::ReadOp::Accept);
+  }
   acceptChannel_.enableReading();
 }
 
@@ -33,14 +39,26 @@ void Acceptor::handleRead() {
   int connfd = acceptSocket_.accept(&peerAddr);
 
   if (connfd >= 0) {
-    if (newConnectionCallback_) {
-      newConnectionCallback_(connfd, peerAddr);
-    } else {
-      ::close(connfd);
-    }
+    newConnection(connfd, peerAddr);
   } else {
     // Error handling: if too many open files, it might return EMFILE
     // keep simple
   }
 }
+
+void Acceptor::handleAccepted(const Channel::Completion &c) {
+  loop_->assertInLoopThread();
+  if (c.res >= 0) {
+    newConnection(c.res,
+                  InetAddress(*reinterpret_cast<const sockaddr_in *>(c.peer)));
+  }
+}
+
+void Acceptor::newConnection(int connfd, const InetAddress &peerAddr) {
+  if (newConnectionCallback_) {
+    newConnectionCallback_(connfd, peerAddr);
+  } else {
+    ::close(connfd);
+  }
+}
 } // namespace hayai
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "hayai/net/Channel.h"
 #include "hayai/net/EventLoop.h"
+#include "hayai/net/Poller.h"
 
 namespace hayai {
 Channel::Channel(EventLoop *loop, int fd) : loop_(loop), fd_(fd) {}
@@ -15,32 +16,67 @@ void Channel::update() { loop_->updateChannel(this); }
 
 void Channel::remove() { loop_->removeChannel(this); }
 
+bool Channel::completionIo() const { return loop_->poller()->completionIo(); }
+
+void Channel::setReadOp(ReadOp op) {
+  readOp_ = op;
+  if (index_ >= 0 && isReading()) {
+    update();
+  }
+}
+
+void Channel::send(const struct iovec *iov, int iovcnt) {
+  loop_->submitSend(this, iov, iovcnt);
+}
+
+void Channel::setCompletion(const Completion &c) {
+  if (c.op == Completion::Op::Send) {
+    sendDone_ = c;
+    revents_ |= kSendDoneEvent;
+  } else {
+    readDone_ = c;
+    revents_ |= kReadDoneEvent;
+  }
+}
+
 void Channel::handleEvent() {
+  // Consumed up front: pollers that report several completions per
+  // channel accumulate into revents_ and rely on it starting at zero
+  const int revents = revents_;
+  revents_ = 0;
   if (tied_) {
     if (auto guard = tie_.lock()) {
-      handleEventWithGuard();
+      handleEventWithGuard(revents);
     }
   } else {
-    handleEventWithGuard();
+    handleEventWithGuard(revents);
   }
 }
 
-void Channel::handleEventWithGuard() {
-  if (revents_ & kErrorEvent) {
+void Channel::handleEventWithGuard(int revents) {
+  if (revents & kErrorEvent) {
     if (errorCallback_)
       errorCallback_();
   }
-  if (revents_ & kCloseEvent) {
+  if (revents & kCloseEvent) {
     if (closeCallback_)
       closeCallback_();
   }
-  if (revents_ & kReadEvent) {
+  if (revents & kReadEvent) {
     if (readCallback_)
       readCallback_();
   }
-  if (revents_ & kWriteEvent) {
+  if (revents & kWriteEvent) {
     if (writeCallback_)
       writeCallback_();
   }
+  if (revents & kReadDoneEvent) {
+    if (completionCallback_)
+      completionCallback_(readDone_);
+  }
+  if (revents & kSendDoneEvent) {
+    if (completionCallback_)
+      completionCallback_(sendDone_);
+  }
 }
 } // namespace hayai
\ No newline at end of file
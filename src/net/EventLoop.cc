@@ -1,16 +1,32 @@
 #include "hayai/net/EventLoop.h"
 #include "hayai/net/Channel.h"
+#include "hayai/net/PipePool.h"
 #include "hayai/net/Poller.h"
+#include "hayai/net/TcpConnection.h"
+#include "hayai/utils/OutputQueue.h"
+#include "hayai/utils/SlabPool.h"
 #include <cassert>
 #include <fcntl.h>
+#include <new>
+#include <sys/socket.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
 namespace hayai {
 thread_local EventLoop *t_loopInThisThread = nullptr;
 
+// Upper bound on a poll() with no timer due
+constexpr std::chrono::milliseconds kPollTimeout(10000);
+// How often parked zero-copy sockets are checked for completions
+constexpr std::chrono::milliseconds kZeroCopyReapInterval(10);
+
 EventLoop::EventLoop()
     : threadId_(std::this_thread::get_id()),
-      poller_(std::make_unique<Poller>(this)) {
+      slabPool_(std::make_unique<SlabPool>()), poller_(Poller::newDefaultPoller(this)),
+      timerQueue_(std::make_unique<TimerQueue>()) {
   if (t_loopInThisThread) {
     // One EventLoop per thread
     abort();
@@ -18,25 +34,49 @@ EventLoop::EventLoop()
     t_loopInThisThread = this;
   }
 
+#if defined(__linux__)
+  // A single eventfd: 8-byte counter, no pipe buffer to fill up
+  wakeupReadFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeupReadFd_ < 0) {
+    abort();
+  }
+  wakeupWriteFd_ = wakeupReadFd_;
+#else
   // Create wakeup pipe
-  if (::pipe(wakeupFd_) < 0) {
+  int pipeFds[2];
+  if (::pipe(pipeFds) < 0) {
     abort();
   }
+  wakeupReadFd_ = pipeFds[0];
+  wakeupWriteFd_ = pipeFds[1];
 
   // Set non-blocking
-  int flags = ::fcntl(wakeupFd_[0], F_GETFL, 0);
-  ::fcntl(wakeupFd_[0], F_SETFL, flags | O_NONBLOCK);
+  int flags = ::fcntl(wakeupReadFd_, F_GETFL, 0);
+  ::fcntl(wakeupReadFd_, F_SETFL, flags | O_NONBLOCK);
+#endif
 
-  wakeupChannel_ = std::make_unique<Channel>(this, wakeupFd_[0]);
+  wakeupChannel_ = std::make_unique<Channel>(this, wakeupReadFd_);
   wakeupChannel_->setReadCallback([this] { handleWakeup(); });
   wakeupChannel_->enableReading();
 }
 
 EventLoop::~EventLoop() {
+  // Tasks that never got to run are dropped
+  while (PendingFunctor *task = pendingFunctors_.pop()) {
+    releaseFunctor(task);
+  }
+
+  // Nothing left to watch the kernel with: the owners go now
+  for (auto &parked : parkedZeroCopy_) {
+    ::close(parked.fd);
+  }
+
   wakeupChannel_->disableAll();
   wakeupChannel_->remove();
-  ::close(wakeupFd_[0]);
-  ::close(wakeupFd_[1]);
+  ::close(wakeupReadFd_);
+  if (wakeupWriteFd_ != wakeupReadFd_) {
+    ::close(wakeupWriteFd_);
+  }
   t_loopInThisThread = nullptr;
 }
 
@@ -48,7 +88,17 @@ void EventLoop::loop() {
 
   while (!quit_) {
     activeChannels_.clear();
-    poller_->poll(std::chrono::milliseconds(10000), &activeChannels_);
+    // Sleep until the nearest timer slot at most; not at all when corked
+    // output was queued outside loop()
+    auto timeout = kPollTimeout;
+    if (!dirtyConnections_.empty()) {
+      timeout = std::chrono::milliseconds(0);
+    } else if (!timerQueue_->empty()) {
+      timeout = timerQueue_->nextTimeout(Clock::now(), kPollTimeout);
+    }
+    poller_->poll(timeout, &activeChannels_);
+    pollReturnTime_ = Clock::now();
+    ++iteration_;
 
     eventHandling_ = true;
     for (Channel *channel : activeChannels_) {
@@ -56,12 +106,42 @@ void EventLoop::loop() {
     }
     eventHandling_ = false;
 
+    if (!timerQueue_->empty()) {
+      timerQueue_->expire(pollReturnTime_);
+    }
+
+    flushDirtyConnections();
     doPendingFunctors();
+    // Sends made by the functors (e.g. from other threads)
+    flushDirtyConnections();
   }
 
+  if (poller_->completionIo()) {
+    finishCompletions();
+  }
   looping_ = false;
 }
 
+void EventLoop::finishCompletions() {
+  // This iteration's sends are still in the submission ring: one more
+  // non-blocking round hands them over and dispatches what completed.
+  // Readiness is left for the next loop(); its polls are re-armed.
+  activeChannels_.clear();
+  poller_->poll(std::chrono::milliseconds(0), &activeChannels_);
+  pollReturnTime_ = Clock::now();
+
+  eventHandling_ = true;
+  for (Channel *channel : activeChannels_) {
+    channel->setRevents(channel->revents() &
+                        (Channel::kReadDoneEvent | Channel::kSendDoneEvent));
+    channel->handleEvent();
+  }
+  eventHandling_ = false;
+
+  flushDirtyConnections();
+  poller_->submitPending();
+}
+
 void EventLoop::quit() {
   quit_ = true;
   if (!isInLoopThread()) {
@@ -78,16 +158,51 @@ void EventLoop::runInLoop(Functor cb) {
 }
 
 void EventLoop::queueInLoop(Functor cb) {
-  {
-    std::scoped_lock lock(mutex_);
-    pendingFunctors_.push_back(std::move(cb));
-  }
+  // Heap-backed on threads without a loop (SlabPool::allocate)
+  void *node = SlabPool::allocate(sizeof(PendingFunctor));
+  pendingFunctors_.push(new (node) PendingFunctor(std::move(cb)));
 
   if (!isInLoopThread() || callingPendingFunctors_) {
     wakeup();
   }
 }
 
+TimerId EventLoop::runAt(Clock::time_point when, Functor cb) {
+  assertInLoopThread();
+  return timerQueue_->add(when, Clock::duration::zero(), std::move(cb));
+}
+
+TimerId EventLoop::runAfter(Clock::duration delay, Functor cb) {
+  return runAt(Clock::now() + delay, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(Clock::duration interval, Functor cb) {
+  assertInLoopThread();
+  return timerQueue_->add(Clock::now() + interval, interval, std::move(cb));
+}
+
+void EventLoop::cancel(TimerId timerId) {
+  assertInLoopThread();
+  timerQueue_->cancel(timerId);
+}
+
+void EventLoop::addDirtyConnection(std::shared_ptr<TcpConnection> conn) {
+  assertInLoopThread();
+  dirtyConnections_.push_back(std::move(conn));
+}
+
+void EventLoop::flushDirtyConnections() {
+  if (dirtyConnections_.empty()) {
+    return;
+  }
+  // Swap so a flush may mark connections dirty again
+  flushingConnections_.swap(dirtyConnections_);
+  for (const auto &conn : flushingConnections_) {
+    conn->flushCorked();
+  }
+  flushingConnections_.clear();
+}
+
 void EventLoop::updateChannel(Channel *channel) {
   assert(channel->ownerLoop() == this);
   poller_->updateChannel(channel);
@@ -98,36 +213,120 @@ void EventLoop::removeChannel(Channel *channel) {
   poller_->removeChannel(channel);
 }
 
+void EventLoop::submitSend(Channel *channel, const struct iovec *iov,
+                           int iovcnt) {
+  assert(channel->ownerLoop() == this);
+  poller_->submitSend(channel, iov, iovcnt);
+  if (!looping_) {
+    // No poll() is coming to submit it
+    poller_->submitPending();
+  }
+}
+
 void EventLoop::wakeup() {
+  // Someone already woke the loop and it hasn't drained yet
+  if (wakeupPending_.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
   uint64_t one = 1;
-  ::write(wakeupFd_[1], &one, sizeof(one));
+  wakeupWrites_.fetch_add(1, std::memory_order_relaxed);
+  ::write(wakeupWriteFd_, &one, sizeof(one));
 }
 
 void EventLoop::handleWakeup() {
   uint64_t one;
-  ::read(wakeupFd_[0], &one, sizeof(one));
+  ::read(wakeupReadFd_, &one, sizeof(one));
 }
 
 void EventLoop::doPendingFunctors() {
-  std::vector<Functor> functors;
   callingPendingFunctors_ = true;
 
-  {
-    // prevents deadlock, if a functor calls queueInLoop, it will deadlock
-    std::scoped_lock lock(mutex_);
-    functors.swap(pendingFunctors_);
+  // Re-arm wakeups before taking the batch: anything queued after the
+  // drain below will see the flag clear and write again
+  wakeupPending_.store(false, std::memory_order_seq_cst);
+
+  // Take the batch first, then run it: functors queued by these functors
+  // run next iteration, after I/O gets a turn (same as swapping a vector)
+  while (functorBatch_.size() < kMaxFunctorBatch) {
+    PendingFunctor *task = pendingFunctors_.pop();
+    if (task == nullptr) {
+      break;
+    }
+    functorBatch_.push_back(task);
+  }
+  if (functorBatch_.size() == kMaxFunctorBatch) {
+    // More may be waiting; don't block in poll() before draining them
+    wakeup();
   }
 
-  for (const auto &functor : functors) {
-    functor();
+  for (PendingFunctor *task : functorBatch_) {
+    task->fn();
+    releaseFunctor(task);
   }
+  functorBatch_.clear();
   callingPendingFunctors_ = false;
 }
 
+void EventLoop::releaseFunctor(PendingFunctor *task) {
+  // Back to the pool of the thread that posted it, from this one
+  task->~PendingFunctor();
+  SlabPool::release(task);
+}
+
 EventLoop *EventLoop::getEventLoopOfCurrentThread() {
   return t_loopInThisThread;
 }
 
+PipePool &EventLoop::pipePool() {
+  assertInLoopThread();
+  if (!pipePool_) {
+    pipePool_ = std::make_unique<PipePool>();
+  }
+  return *pipePool_;
+}
+
+void EventLoop::parkZeroCopy(int sockfd, std::unique_ptr<OutputQueue> pins) {
+  assertInLoopThread();
+  if (pins->pinnedCount() == 0) {
+    return;
+  }
+
+  // Our descriptor keeps the error queue readable after the owner closes
+  // its own. Ours would also hold the connection open, so the FIN goes
+  // out now (after the queued bytes, as close() would send it).
+  const int fd = ::dup(sockfd);
+  if (fd < 0) {
+    // No way to learn when the kernel is done: leak rather than free
+    // pages it may still read
+    (void)pins.release();
+    return;
+  }
+  ::shutdown(fd, SHUT_WR);
+
+  parkedZeroCopy_.push_back(ParkedZeroCopy{fd, std::move(pins)});
+  if (!zeroCopyReaper_.valid()) {
+    zeroCopyReaper_ =
+        runEvery(kZeroCopyReapInterval, [this] { reapParkedZeroCopy(); });
+  }
+}
+
+void EventLoop::reapParkedZeroCopy() {
+  size_t copied = 0;
+  std::erase_if(parkedZeroCopy_, [&copied](ParkedZeroCopy &parked) {
+    parked.pins->reapZeroCopy(parked.fd, &copied);
+    if (parked.pins->pinnedCount() > 0) {
+      return false;
+    }
+    ::close(parked.fd);
+    return true;
+  });
+
+  if (parkedZeroCopy_.empty()) {
+    cancel(zeroCopyReaper_);
+    zeroCopyReaper_ = TimerId{};
+  }
+}
+
 void EventLoop::spawn(std::coroutine_handle<> handle) {
   runInLoop([this, handle]() {
     spawnedTasks_.insert(handle);
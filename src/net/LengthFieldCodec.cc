@@ -0,0 +1,148 @@
+#include "hayai/net/LengthFieldCodec.h"
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace hayai {
+
+LengthFieldCodec::LengthFieldCodec(size_t headerBytes, size_t maxFrameSize)
+    : headerBytes_(headerBytes) {
+    assert(headerBytes == 1 || headerBytes == 2 || headerBytes == 4 ||
+           headerBytes == 8);
+    setMaxFrameSize(maxFrameSize);
+}
+
+void LengthFieldCodec::setMaxFrameSize(size_t maxFrameSize) {
+    // Lengths are unsigned on the wire; the largest the header holds
+    const uint64_t limit =
+        headerBytes_ == 8 ? std::numeric_limits<uint64_t>::max()
+                          : (uint64_t{1} << (8 * headerBytes_)) - 1;
+    maxFrameSize_ =
+        static_cast<size_t>(std::min<uint64_t>(maxFrameSize, limit));
+}
+
+LengthFieldCodec::Status LengthFieldCodec::peekFrame(const Buffer& buf,
+                                                     std::string_view* frame,
+                                                     uint64_t* length) const {
+    if (buf.readableBytes() < headerBytes_) {
+        return Status::Incomplete;
+    }
+
+    uint64_t len = 0;
+    switch (headerBytes_) {
+    case 1:
+        len = static_cast<uint8_t>(buf.peekInt8());
+        break;
+    case 2:
+        len = static_cast<uint16_t>(buf.peekInt16());
+        break;
+    case 4:
+        len = static_cast<uint32_t>(buf.peekInt32());
+        break;
+    default:
+        len = static_cast<uint64_t>(buf.peekInt64());
+        break;
+    }
+
+    if (len > maxFrameSize_) {
+        if (length != nullptr) {
+            *length = len;
+        }
+        return Status::TooLarge;
+    }
+    if (buf.readableBytes() - headerBytes_ < len) {
+        return Status::Incomplete;
+    }
+    *frame = std::string_view(buf.peek() + headerBytes_, len);
+    return Status::Frame;
+}
+
+void LengthFieldCodec::prependHeader(Buffer* buf, uint64_t length) const {
+    switch (headerBytes_) {
+    case 1:
+        buf->prependInt8(static_cast<int8_t>(length));
+        break;
+    case 2:
+        buf->prependInt16(static_cast<int16_t>(length));
+        break;
+    case 4:
+        buf->prependInt32(static_cast<int32_t>(length));
+        break;
+    default:
+        buf->prependInt64(static_cast<int64_t>(length));
+        break;
+    }
+}
+
+void LengthFieldCodec::encode(Buffer* buf) const {
+    const size_t length = buf->readableBytes();
+    assert(length <= maxFrameSize_);
+    if (buf->prependableBytes() < headerBytes_) {
+        // Rare: a consumed ring whose free space ends at the payload
+        Buffer framed(length);
+        framed.append(buf->peek(), length);
+        buf->swap(framed);
+    }
+    prependHeader(buf, length);
+}
+
+void LengthFieldCodec::encode(std::string_view payload, Buffer* out) const {
+    assert(payload.size() <= maxFrameSize_);
+    out->ensureWritableBytes(headerBytes_ + payload.size());
+    switch (headerBytes_) {
+    case 1:
+        out->appendInt8(static_cast<int8_t>(payload.size()));
+        break;
+    case 2:
+        out->appendInt16(static_cast<int16_t>(payload.size()));
+        break;
+    case 4:
+        out->appendInt32(static_cast<int32_t>(payload.size()));
+        break;
+    default:
+        out->appendInt64(static_cast<int64_t>(payload.size()));
+        break;
+    }
+    out->append(payload);
+}
+
+void LengthFieldCodec::send(const TcpConnectionPtr& conn,
+                            std::string_view payload) const {
+    Buffer framed(payload.size());
+    framed.append(payload);
+    encode(&framed);
+    conn->send(std::move(framed));
+}
+
+void LengthFieldCodec::send(const TcpConnectionPtr& conn,
+                            Buffer&& payload) const {
+    encode(&payload);
+    conn->send(std::move(payload));
+}
+
+void LengthFieldCodec::onMessage(const TcpConnectionPtr& conn,
+                                 Buffer* buf) const {
+    std::string_view frame;
+    uint64_t length = 0;
+    for (;;) {
+        const Status status = peekFrame(*buf, &frame, &length);
+        if (status == Status::Incomplete) {
+            return;
+        }
+        if (status == Status::TooLarge) {
+            buf->retrieveAll(); // the stream can't be resynchronized
+            if (errorCallback_) {
+                errorCallback_(conn, length);
+            } else {
+                conn->forceClose();
+            }
+            return;
+        }
+        if (frameCallback_) {
+            frameCallback_(conn, frame);
+        }
+        buf->retrieve(frameBytes(frame));
+    }
+}
+
+} // namespace hayai
@@ -0,0 +1,65 @@
+#include "hayai/net/PipePool.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace hayai {
+
+PipePool::~PipePool() {
+    for (Pipe& pipe : idle_) {
+        close(pipe);
+    }
+}
+
+PipePool::Pipe PipePool::acquire() {
+    if (!idle_.empty()) {
+        Pipe pipe = idle_.back();
+        idle_.pop_back();
+        return pipe;
+    }
+
+    int fds[2];
+#if defined(__linux__)
+    if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+        return Pipe{};
+    }
+#else
+    if (::pipe(fds) < 0) {
+        return Pipe{};
+    }
+    for (int fd : fds) {
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
+
+    Pipe pipe{fds[0], fds[1], 64 * 1024};
+#if defined(__linux__)
+    // A larger pipe moves more per splice() pair; keep the default if the
+    // limit doesn't allow it
+    int size = ::fcntl(pipe.writeFd, F_SETPIPE_SZ, static_cast<int>(kPipeSize));
+    if (size > 0) {
+        pipe.capacity = static_cast<size_t>(size);
+    }
+#endif
+    ++created_;
+    return pipe;
+}
+
+void PipePool::release(Pipe pipe, bool empty) {
+    if (!pipe.valid()) {
+        return;
+    }
+    if (empty && idle_.size() < kMaxIdle) {
+        idle_.push_back(pipe);
+    } else {
+        close(pipe);
+    }
+}
+
+void PipePool::close(Pipe& pipe) {
+    ::close(pipe.readFd);
+    ::close(pipe.writeFd);
+    pipe = Pipe{};
+}
+
+} // namespace hayai
@@ -75,6 +75,17 @@ void Socket::setKeepAlive(bool on) {
   }
 }
 
+bool Socket::setZeroCopy(bool on) {
+#if defined(__linux__) && defined(SO_ZEROCOPY)
+  int optval = on ? 1 : 0;
+  return ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval,
+                      sizeof(optval)) == 0;
+#else
+  (void)on;
+  return false;
+#endif
+}
+
 void Socket::bind(const InetAddress &addr) {
   if (::bind(sockfd_, addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
     throw std::system_error(errno, std::system_category(), "bind");
@@ -92,6 +103,14 @@ int Socket::accept(InetAddress *peerAddr) {
   socklen_t addrlen = sizeof(addr);
   std::memset(&addr, 0, sizeof(addr));
 
+#if defined(__linux__)
+  int connfd = ::accept4(sockfd_, reinterpret_cast<sockaddr *>(&addr),
+                         &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+  if (connfd >= 0) {
+    peerAddr->setSockAddr(addr);
+  }
+#else
   int connfd = ::accept(sockfd_, reinterpret_cast<sockaddr *>(&addr), &addrlen);
 
   if (connfd >= 0) {
@@ -100,6 +119,7 @@ int Socket::accept(InetAddress *peerAddr) {
     int flags = ::fcntl(connfd, F_GETFL, 0);
     ::fcntl(connfd, F_SETFL, flags | O_NONBLOCK);
   }
+#endif
 
   return connfd;
 }
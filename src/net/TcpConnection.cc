@@ -5,25 +5,47 @@
 #include "hayai/net/Socket.h"
 #include <cassert>
 #include <cerrno>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <type_traits>
 #include <unistd.h>
+#include <vector>
 
 namespace hayai {
+namespace {
+// Connections found idle during this loop iteration's timer pass
+thread_local std::vector<TcpConnectionPtr> t_idleBatch;
+
+// Segments per completion-mode send
+constexpr int kMaxSendIov = 64;
+} // namespace
+
 TcpConnection::TcpConnection(EventLoop* loop, std::string name, int sockfd,
                              const InetAddress& localAddr,
                              const InetAddress& peerAddr)
     : loop_(loop), name_(std::move(name)),
-      socket_(std::make_unique<Socket>(sockfd)),
-      channel_(std::make_unique<Channel>(loop, sockfd)), localAddr_(localAddr),
+      socket_(sockfd), channel_(loop, sockfd), localAddr_(localAddr),
       peerAddr_(peerAddr) {
 
-    channel_->setReadCallback([this] { handleRead(); });
-    channel_->setWriteCallback([this] { handleWrite(); });
-    channel_->setCloseCallback([this] { handleClose(); });
-    channel_->setErrorCallback([this] { handleError(); });
+    channel_.setReadCallback([this] { handleRead(); });
+    channel_.setWriteCallback([this] { handleWrite(); });
+    channel_.setCloseCallback([this] { handleClose(); });
+    channel_.setErrorCallback([this] { handleError(); });
+    channel_.setCompletionCallback(
+        [this](const Channel::Completion& c) { handleCompletion(c); });
 }
 
 TcpConnection::~TcpConnection() { assert(state_ == State::Disconnected); }
 
+TcpConnectionPtr TcpConnection::create(EventLoop* loop, std::string name,
+                                       int sockfd,
+                                       const InetAddress& localAddr,
+                                       const InetAddress& peerAddr) {
+    return std::allocate_shared<TcpConnection>(
+        SlabAllocator<TcpConnection>(), loop, std::move(name), sockfd,
+        localAddr, peerAddr);
+}
+
 void TcpConnection::send(std::string_view message) {
     if (state_ == State::Connected) {
         if (loop_->isInLoopThread()) {
@@ -35,77 +57,748 @@ void TcpConnection::send(std::string_view message) {
     }
 }
 
+void TcpConnection::send(std::string&& message) {
+    if (state_ == State::Connected) {
+        if (loop_->isInLoopThread()) {
+            sendOwnedInLoop(message);
+        } else {
+            // Moved into the task, then into the queue: never copied
+            loop_->runInLoop([this, msg = std::move(message)]() mutable {
+                sendOwnedInLoop(msg);
+            });
+        }
+    }
+}
+
+void TcpConnection::send(std::string&& message, SendCompleteCallback done) {
+    if (state_ != State::Connected) {
+        queueFileComplete(std::move(done), false);
+        return;
+    }
+    if (loop_->isInLoopThread()) {
+        sendOwnedInLoop(message, std::move(done));
+    } else {
+        loop_->runInLoop([this, msg = std::move(message),
+                          done = std::move(done)]() mutable {
+            sendOwnedInLoop(msg, std::move(done));
+        });
+    }
+}
+
+void TcpConnection::send(Buffer&& message) {
+    if (state_ == State::Connected) {
+        if (loop_->isInLoopThread()) {
+            sendOwnedInLoop(message);
+        } else {
+            loop_->runInLoop([this, msg = std::move(message)]() mutable {
+                sendOwnedInLoop(msg);
+            });
+        }
+    }
+}
+
+void TcpConnection::send(std::shared_ptr<const std::string> message) {
+    if (state_ == State::Connected) {
+        std::string_view view(*message);
+        if (loop_->isInLoopThread()) {
+            sendSharedInLoop(view, std::move(message));
+        } else {
+            loop_->runInLoop([this, view, msg = std::move(message)]() mutable {
+                sendSharedInLoop(view, std::move(msg));
+            });
+        }
+    }
+}
+
+void TcpConnection::send(const SharedSlice& message) {
+    if (state_ == State::Connected) {
+        if (loop_->isInLoopThread()) {
+            sendSharedInLoop(message.view(), message.owner());
+        } else {
+            loop_->runInLoop([this, msg = message] {
+                sendSharedInLoop(msg.view(), msg.owner());
+            });
+        }
+    }
+}
+
+void TcpConnection::sendBorrowed(std::string_view message) {
+    if (state_ == State::Connected) {
+        loop_->runInLoop([this, message] { sendSharedInLoop(message, nullptr); });
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length,
+                             FileCompleteCallback done) {
+    if (state_ != State::Connected) {
+        if (done) {
+            queueFileComplete(std::move(done), false);
+        }
+        return;
+    }
+    if (loop_->isInLoopThread()) {
+        sendFileInLoop(fd, offset, length, std::move(done));
+    } else {
+        loop_->runInLoop(
+            [this, fd, offset, length, done = std::move(done)]() mutable {
+                sendFileInLoop(fd, offset, length, std::move(done));
+            });
+    }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length,
+                                   FileCompleteCallback done) {
+    if (state_ != State::Connected && state_ != State::Disconnecting) {
+        if (done) {
+            queueFileComplete(std::move(done), false);
+        }
+        return;
+    }
+
+    outputQueue_.appendFile(fd, offset, length);
+    if (done) {
+        pendingFiles_.push_back(PendingFile{
+            outputQueue_.consumedBytes() + outputQueue_.readableBytes(),
+            std::move(done)});
+    }
+
+    startOutput();
+}
+
+void TcpConnection::startOutput() {
+    if (!corked_ && !channel_.isWriting()) {
+        // Nothing queued ahead: start writing right away
+        flushOutput();
+    }
+    if (!outputQueue_.empty() && state_ != State::Disconnected) {
+        outputQueued();
+    }
+}
+
+void TcpConnection::queueFileComplete(SendCompleteCallback done, bool sent) {
+    loop_->queueInLoop(
+        [guard = shared_from_this(), done = std::move(done), sent] {
+            done(guard, sent);
+        });
+}
+
+void TcpConnection::completeFiles() {
+    const uint64_t consumed = outputQueue_.consumedBytes();
+    while (!pendingFiles_.empty() && pendingFiles_.front().end <= consumed) {
+        queueFileComplete(std::move(pendingFiles_.front().done), true);
+        pendingFiles_.erase(pendingFiles_.begin());
+    }
+}
+
+void TcpConnection::failPendingFiles() {
+    for (PendingFile& file : pendingFiles_) {
+        queueFileComplete(std::move(file.done), false);
+    }
+    pendingFiles_.clear();
+}
+
 void TcpConnection::sendInLoop(std::string_view message) {
-    loop_->assertInLoopThread();
-    ssize_t nwrote = 0;
-    size_t remaining = message.size();
     bool faultError = false;
+    size_t nwrote = writeDirect(message, &faultError);
 
-    // If output buffer is empty and not writing,
-    // try to write directly to avoid Poller overhead
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
-        nwrote = ::write(channel_->fd(), message.data(), message.size());
-        if (nwrote >= 0) {
-            remaining = message.size() - nwrote;
+    // if we couldn't write all data, buffer the rest
+    if (!faultError && nwrote < message.size()) {
+        outputQueue_.append(message.substr(nwrote));
+        outputQueued();
+    } else if (!faultError && outputQueue_.empty()) {
+        queueWriteComplete();
+    }
+}
+
+void TcpConnection::sendSharedInLoop(std::string_view message,
+                                     std::shared_ptr<const void> owner) {
+    if (zeroCopy_ && owner && message.size() >= zeroCopyThreshold_) {
+        // Through the queue, which pins `owner` until the kernel is done
+        outputQueue_.appendShared(message, std::move(owner), true);
+        startOutput();
+        return;
+    }
+
+    bool faultError = false;
+    size_t nwrote = writeDirect(message, &faultError);
+
+    // Queue the rest by reference: no copy of the payload
+    if (!faultError && nwrote < message.size()) {
+        if (owner) {
+            outputQueue_.appendShared(message.substr(nwrote), std::move(owner));
         } else {
-            nwrote = 0;
-            if (errno != EWOULDBLOCK) {
-                if (errno == EPIPE || errno == ECONNRESET) {
-                    faultError = true;
-                }
-            }
+            outputQueue_.appendBorrowed(message.substr(nwrote));
         }
+        outputQueued();
+    } else if (!faultError && outputQueue_.empty()) {
+        queueWriteComplete();
     }
+}
 
-    // if we couldn't write all data, buffer the rest
-    if (!faultError && remaining > 0) {
-        outputBuffer_.append(message.data() + nwrote, remaining);
-        if (!channel_->isWriting()) {
-            // Start monitoring for writable events
-            channel_->enableWriting();
+template <typename Owned>
+bool TcpConnection::sendOwnedInLoop(Owned& message) {
+    std::string_view bytes;
+    if constexpr (std::is_same_v<Owned, Buffer>) {
+        bytes = std::string_view(message.peek(), message.readableBytes());
+    } else {
+        bytes = message;
+    }
+
+    bool faultError = false;
+    size_t nwrote = writeDirect(bytes, &faultError);
+
+    // Hand the storage itself to the queue, skipping what was written
+    if (!faultError && nwrote < bytes.size()) {
+        outputQueue_.appendOwned(std::move(message), nwrote);
+        outputQueued();
+    } else if (!faultError && outputQueue_.empty()) {
+        queueWriteComplete();
+    }
+    return !faultError;
+}
+
+void TcpConnection::sendOwnedInLoop(std::string& message,
+                                    SendCompleteCallback done) {
+    if (state_ != State::Connected && state_ != State::Disconnecting) {
+        queueFileComplete(std::move(done), false);
+        return;
+    }
+    if (!sendOwnedInLoop(message)) {
+        queueFileComplete(std::move(done), false);
+        return;
+    }
+
+    // Written directly, only the queue's position moves on: what is left
+    // of the message ends where the queue does now
+    pendingFiles_.push_back(PendingFile{
+        outputQueue_.consumedBytes() + outputQueue_.readableBytes(),
+        std::move(done)});
+    completeFiles();
+}
+
+size_t TcpConnection::writeDirect(std::string_view message, bool* faultError) {
+    loop_->assertInLoopThread();
+
+    // If output queue is empty and not writing,
+    // try to write directly to avoid Poller overhead.
+    // Corked: always queue, the loop flushes once after dispatch.
+    // Completion I/O: likewise, the flush submits one send.
+    if (corked_ || completionIo_ || channel_.isWriting() ||
+        !outputQueue_.empty()) {
+        return 0;
+    }
+
+    ssize_t nwrote = ::write(channel_.fd(), message.data(), message.size());
+    ++ioStats_.writeCalls;
+    if (nwrote >= 0) {
+        ioStats_.bytesWritten += nwrote;
+        touch();
+        return static_cast<size_t>(nwrote);
+    }
+
+    if (errno != EWOULDBLOCK) {
+        if (errno == EPIPE || errno == ECONNRESET) {
+            *faultError = true;
         }
     }
+    return 0;
 }
 
 void TcpConnection::handleRead() {
     loop_->assertInLoopThread();
+    if (relaying_) {
+        pumpRelay();
+        return;
+    }
     int savedErrno = errno;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    ssize_t n = 0;
+    size_t total = 0;
+
+    // Level-triggered: one read, the poller reports leftovers again.
+    // Edge-triggered: no further event until EAGAIN, so keep reading.
+    do {
+        size_t overflow = 0;
+        n = inputBuffer_.readFd(channel_.fd(), &savedErrno, &overflow);
+        ++ioStats_.readCalls;
+        if (overflow > 0) {
+            ++ioStats_.readOverflowCopies;
+            ioStats_.readOverflowBytes += overflow;
+        }
+        if (n > 0) {
+            ioStats_.bytesRead += n;
+            total += n;
+        }
+    } while (edgeTriggered_ && n > 0 && total < ioBudget_);
 
-    if (n > 0) {
+    if (total > 0) {
+        touch();
         // Got data - call user's message callback
         // Use shared_from_this() to extend lifetime during callback
         messageCallback_(shared_from_this(), &inputBuffer_);
-    } else if (n == 0) {
-        // EOF
+    }
+
+    if (n == 0) {
+        // EOF (the message callback may already have closed us)
+        if (state_ != State::Disconnected) {
+            handleClose();
+        }
+    } else if (n < 0) {
+        if (savedErrno != EAGAIN && savedErrno != EWOULDBLOCK) {
+            handleError();
+        }
+    } else if (edgeTriggered_ && total >= ioBudget_) {
+        // Budget spent with data left: resume after other channels ran
+        loop_->queueInLoop([guard = shared_from_this()] {
+            if (guard->channel_.isReading()) {
+                guard->handleRead();
+            }
+        });
+    }
+}
+
+void TcpConnection::handleCompletion(const Channel::Completion& c) {
+    if (c.op == Channel::Completion::Op::Send) {
+        handleSendComplete(c.res);
+    } else {
+        handleRecvComplete(c.res, c.data);
+    }
+}
+
+void TcpConnection::handleRecvComplete(int res, const char* data) {
+    loop_->assertInLoopThread();
+    ++ioStats_.readCalls;
+    if (state_ == State::Disconnected) {
+        return;
+    }
+
+    if (res > 0) {
+        ioStats_.bytesRead += res;
+        touch();
+        if (relaying_) {
+            // Received before the relay took over: goes ahead of what
+            // it splices
+            if (auto peer = relayPeer_.lock()) {
+                peer->send(std::string_view(data, res));
+            }
+            return;
+        }
+        inputBuffer_.append(data, res);
+        messageCallback_(shared_from_this(), &inputBuffer_);
+    } else {
+        // EOF, or an error the next receive would only repeat
         handleClose();
+    }
+}
+
+void TcpConnection::handleSendComplete(int res) {
+    loop_->assertInLoopThread();
+    sendInFlight_ = false;
+    ++ioStats_.writeCalls;
+    if (state_ == State::Disconnected) {
+        return;
+    }
+
+    if (res < 0) {
+        if (res == -EAGAIN || res == -EINTR) {
+            flushOutput(); // nothing went out: try again
+        } else {
+            handleClose();
+        }
+        return;
+    }
+
+    ioStats_.bytesWritten += res;
+    outputQueue_.retrieve(static_cast<size_t>(res));
+    touch();
+    completeFiles();
+
+    if (aboveHighWater_ && outputQueue_.bufferedBytes() <= lowWaterMark_) {
+        leaveHighWater();
+    }
+    if (outputQueue_.empty()) {
+        outputDrained(res > 0);
+    } else {
+        flushOutput(); // the rest, or a file range that follows
+    }
+}
+
+void TcpConnection::outputQueued() {
+    if (!aboveHighWater_ && outputQueue_.bufferedBytes() >= highWaterMark_) {
+        enterHighWater();
+    }
+
+    if (channel_.isWriting() || sendInFlight_) {
+        return; // the next writable event (or completion) flushes it
+    }
+    if (completionIo_ && !loop_->looping()) {
+        // No iteration to flush after: send now
+        flushOutput();
+    } else if (corked_ || completionIo_) {
+        // One flush per iteration, however many sends come before it
+        if (!flushQueued_) {
+            flushQueued_ = true;
+            loop_->addDirtyConnection(shared_from_this());
+        }
     } else {
-        handleError();
+        // Start monitoring for writable events
+        channel_.enableWriting();
+    }
+}
+
+void TcpConnection::enterHighWater() {
+    aboveHighWater_ = true;
+
+    if (throttleReads_) {
+        stopReadInLoop();
+    }
+    if (auto upstream = throttledUpstream_.lock()) {
+        upstream->stopRead();
+    }
+    if (highWaterMarkCallback_) {
+        // Queued: send() must not re-enter user code
+        loop_->queueInLoop([guard = shared_from_this()] {
+            if (guard->highWaterMarkCallback_) {
+                guard->highWaterMarkCallback_(
+                    guard, guard->outputQueue_.bufferedBytes());
+            }
+        });
+    }
+}
+
+void TcpConnection::leaveHighWater() {
+    aboveHighWater_ = false;
+
+    if (throttleReads_) {
+        startReadInLoop();
+    }
+    if (auto upstream = throttledUpstream_.lock()) {
+        upstream->startRead();
+    }
+    if (lowWaterMarkCallback_ && state_ != State::Disconnected) {
+        lowWaterMarkCallback_(shared_from_this());
+    }
+}
+
+void TcpConnection::startRead() {
+    loop_->runInLoop([guard = shared_from_this()] { guard->startReadInLoop(); });
+}
+
+void TcpConnection::stopRead() {
+    loop_->runInLoop([guard = shared_from_this()] { guard->stopReadInLoop(); });
+}
+
+void TcpConnection::startReadInLoop() {
+    loop_->assertInLoopThread();
+    if (state_ == State::Connected || state_ == State::Disconnecting) {
+        if (!channel_.isReading()) {
+            channel_.enableReading();
+        }
+    }
+}
+
+void TcpConnection::stopReadInLoop() {
+    loop_->assertInLoopThread();
+    if (channel_.isReading()) {
+        channel_.disableReading();
+    }
+}
+
+void TcpConnection::setWaterMarks(size_t highWaterMark, size_t lowWaterMark) {
+    assert(lowWaterMark < highWaterMark);
+    highWaterMark_ = highWaterMark;
+    lowWaterMark_ = lowWaterMark;
+}
+
+void TcpConnection::setThrottleUpstream(const TcpConnectionPtr& upstream) {
+    throttledUpstream_ = upstream;
+}
+
+void TcpConnection::flushCorked() {
+    loop_->assertInLoopThread();
+    flushQueued_ = false;
+
+    if (!channel_.isWriting() && !outputQueue_.empty() &&
+        (state_ == State::Connected || state_ == State::Disconnecting)) {
+        flushOutput();
     }
 }
 
 void TcpConnection::handleWrite() {
     loop_->assertInLoopThread();
 
-    if (channel_->isWriting()) {
-        const char* data = outputBuffer_.peek();
-        size_t len = outputBuffer_.readableBytes();
-        ssize_t n = ::write(channel_->fd(), data, len);
+    if (channel_.isWriting()) {
+        flushOutput();
+    }
+}
 
-        if (n > 0) {
-            outputBuffer_.retrieve(n);
+bool TcpConnection::submitOutput() {
+    if (!sendInFlight_) {
+        struct iovec vec[kMaxSendIov];
+        const int count = outputQueue_.peekMemory(vec, kMaxSendIov);
+        if (count == 0) {
+            return false;
+        }
+        sendInFlight_ = true;
+        channel_.send(vec, count);
+    }
+    if (channel_.isWriting()) {
+        // The completion carries on, not writable events
+        channel_.disableWriting();
+    }
+    return true;
+}
+
+void TcpConnection::flushOutput() {
+    if (completionIo_ && submitOutput()) {
+        return;
+    }
+
+    ssize_t n = 0;
+    size_t total = 0;
+    int savedErrno = 0;
+
+    // Each writev() gathers up to IOV_MAX segments; keep going until the
+    // socket is full or the budget is spent, saving a poll round-trip per
+    // socket buffer's worth of a large response
+    while (!outputQueue_.empty()) {
+        n = outputQueue_.writeFd(channel_.fd(), &savedErrno);
+        ++ioStats_.writeCalls;
+        if (n <= 0) {
+            break;
+        }
+        ioStats_.bytesWritten += n;
+        total += n;
+        if (total >= ioBudget_) {
+            break;
+        }
+    }
 
-            if (outputBuffer_.readableBytes() == 0) {
-                // Add data sent
-                channel_->disableWriting();
+    if (total > 0) {
+        touch();
+        completeFiles();
+    }
 
-                if (state_ == State::Disconnecting) {
-                    shutdownInLoop();
+    if (n < 0 && savedErrno != EAGAIN && savedErrno != EWOULDBLOCK &&
+        state_ != State::Disconnected) {
+        // Broken socket or unreadable file: the stream can't continue
+        handleClose();
+        return;
+    }
+
+    if (aboveHighWater_ && outputQueue_.bufferedBytes() <= lowWaterMark_) {
+        leaveHighWater();
+    }
+
+    if (outputQueue_.empty()) {
+        outputDrained(total > 0);
+    } else {
+        if (!channel_.isWriting()) {
+            // Corked flush the socket didn't fully take
+            channel_.enableWriting();
+        }
+        if (edgeTriggered_ && n > 0) {
+            // Budget spent while the socket still accepts data
+            loop_->queueInLoop([guard = shared_from_this()] {
+                if (guard->channel_.isWriting()) {
+                    guard->handleWrite();
                 }
+            });
+        }
+    }
+}
+
+void TcpConnection::outputDrained(bool wrote) {
+    // Add data sent
+    if (channel_.isWriting()) {
+        channel_.disableWriting();
+    }
+    if (wrote) {
+        queueWriteComplete();
+    }
+    if (auto source = relaySource_.lock()) {
+        // Our own output is out of the way: bytes a relay holds for
+        // us can follow
+        if (source->relayPipeBytes_ > 0) {
+            source->pumpRelay();
+        }
+    }
+
+    if (state_ == State::Disconnecting) {
+        shutdownInLoop();
+    }
+}
+
+bool TcpConnection::relayTo(const TcpConnectionPtr& peer) {
+    loop_->assertInLoopThread();
+    assert(peer && peer.get() != this && peer->loop_ == loop_);
+#if defined(__linux__)
+    if (relaying_ || state_ != State::Connected) {
+        return false;
+    }
+    relayPipe_ = loop_->pipePool().acquire();
+    if (!relayPipe_.valid()) {
+        return false;
+    }
+    relaying_ = true;
+    relayPeer_ = peer;
+    peer->relaySource_ = shared_from_this();
+
+    // Whatever was read before the switch goes first
+    if (inputBuffer_.readableBytes() > 0) {
+        peer->send(
+            std::string_view(inputBuffer_.peek(), inputBuffer_.readableBytes()));
+        inputBuffer_.retrieveAll();
+    }
+    if (channel_.readOp() != Channel::ReadOp::Readiness) {
+        // splice() needs readiness. A receive still in flight completes
+        // first (passed on by handleRecvComplete); the poll that starts
+        // the pump is only armed after it.
+        channel_.setReadOp(Channel::ReadOp::Readiness);
+    } else {
+        pumpRelay();
+    }
+    return true;
+#else
+    (void)peer;
+    return false;
+#endif
+}
+
+void TcpConnection::pumpRelay() {
+#if defined(__linux__)
+    auto peer = relayPeer_.lock();
+    if (!relaying_ || !peer || peer->state_ == State::Disconnected) {
+        return;
+    }
+
+    size_t moved = 0;
+    for (;;) {
+        // Pipe -> peer, behind anything the peer queued itself
+        while (relayPipeBytes_ > 0) {
+            ssize_t n = -1;
+            if (peer->outputQueue_.empty()) {
+                n = ::splice(relayPipe_.readFd, nullptr, peer->channel_.fd(),
+                             nullptr, relayPipeBytes_,
+                             SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                ++peer->ioStats_.writeCalls;
+            } else {
+                errno = EAGAIN;
             }
+
+            if (n > 0) {
+                relayPipeBytes_ -= n;
+                peer->ioStats_.bytesWritten += n;
+                peer->touch();
+                moved += n;
+            } else if (errno == EAGAIN) {
+                // Peer is full: stop reading until its writable event
+                // (flushOutput) calls us again
+                stopReadInLoop();
+                if (!peer->channel_.isWriting()) {
+                    peer->channel_.enableWriting();
+                }
+                return;
+            } else {
+                peer->handleClose();
+                return;
+            }
+        }
+
+        if (relayEof_) {
+            peer->shutdown(); // pass the half-close on
+            closeIfRelayDone();
+            return;
+        }
+        if (readThrottled()) {
+            return; // leaveHighWater() turns reading back on
+        }
+        if (!channel_.isReading()) {
+            startReadInLoop();
+        }
+        if (moved >= ioBudget_) {
+            if (edgeTriggered_) {
+                loop_->queueInLoop(
+                    [guard = shared_from_this()] { guard->pumpRelay(); });
+            }
+            return;
+        }
+
+        // Socket -> pipe; the pipe is empty here
+        ssize_t n = ::splice(channel_.fd(), nullptr, relayPipe_.writeFd,
+                             nullptr, relayPipe_.capacity,
+                             SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        ++ioStats_.readCalls;
+        if (n > 0) {
+            relayPipeBytes_ += n;
+            ioStats_.bytesRead += n;
+            touch();
+        } else if (n == 0) {
+            relayEof_ = true;
+            stopReadInLoop();
+        } else if (errno == EAGAIN) {
+            return;
         } else {
+            handleClose();
+            return;
         }
     }
+#endif
+}
+
+bool TcpConnection::readThrottled() const {
+    if (throttleReads_ && aboveHighWater_) {
+        return true;
+    }
+    // The peer may hold us back as its upstream (setThrottledUpstream)
+    auto peer = relayPeer_.lock();
+    return peer && peer->aboveHighWater_ &&
+           peer->throttledUpstream_.lock().get() == this;
+}
+
+bool TcpConnection::relayDone() const {
+    return relaying_ && relayEof_ && relayPipeBytes_ == 0;
+}
+
+void TcpConnection::closeIfRelayDone() {
+    // Our input ended and was passed on, and our output is shut down:
+    // nothing is left to move either way
+    if (relayDone() && state_ == State::Disconnecting &&
+        !channel_.isWriting() && outputQueue_.empty()) {
+        handleClose();
+    }
+}
+
+void TcpConnection::stopRelay() {
+    if (relaying_) {
+        const bool done = relayDone();
+        relaying_ = false;
+        loop_->pipePool().release(relayPipe_, relayPipeBytes_ == 0);
+        relayPipe_ = PipePool::Pipe{};
+        relayPipeBytes_ = 0;
+        auto peer = relayPeer_.lock();
+        if (peer && !done) {
+            // Bytes in flight to it are gone: don't leave it half-fed
+            peer->forceClose();
+        }
+    }
+    relayPeer_.reset();
+
+    auto source = relaySource_.lock();
+    if (source && !source->relayDone()) {
+        source->forceClose();
+    }
+    relaySource_.reset();
+}
+
+void TcpConnection::queueWriteComplete() {
+    if (writeCompleteCallback_) {
+        // Queued: never re-enters user code from inside send()
+        loop_->queueInLoop([guard = shared_from_this()] {
+            if (guard->writeCompleteCallback_) {
+                guard->writeCompleteCallback_(guard);
+            }
+        });
+    }
 }
 
 void TcpConnection::handleClose() {
@@ -115,9 +808,16 @@ void TcpConnection::handleClose() {
     // (e.g., client disconnects during connecting)
     // Just transition to Disconnected state
     state_ = State::Disconnected;
-    channel_->disableAll();
+    channel_.disableAll();
+    cancelIdleTimer();
+    if (aboveHighWater_) {
+        // Don't leave a linked upstream paused on our behalf
+        leaveHighWater();
+    }
+    failPendingFiles();
 
     TcpConnectionPtr guardThis(shared_from_this());
+    stopRelay();
 
     if (connectionCallback_) {
         connectionCallback_(guardThis);
@@ -126,7 +826,100 @@ void TcpConnection::handleClose() {
     closeCallback_(guardThis);
 }
 
-void TcpConnection::handleError() {}
+void TcpConnection::handleError() {
+    loop_->assertInLoopThread();
+
+    // Zero-copy completions are reported like socket errors
+    if (outputQueue_.pinnedCount() > 0) {
+        size_t copied = 0;
+        ioStats_.zeroCopyCompleted +=
+            outputQueue_.reapZeroCopy(channel_.fd(), &copied);
+        ioStats_.zeroCopyCopied += copied;
+    }
+}
+
+void TcpConnection::setEdgeTriggered(bool on, size_t ioBudget) {
+    assert(state_ == State::Connecting);
+    edgeTriggered_ = on;
+    ioBudget_ = ioBudget;
+    channel_.setEdgeTriggered(on);
+}
+
+bool TcpConnection::setZeroCopy(bool on, size_t threshold) {
+    assert(state_ == State::Connecting);
+    zeroCopy_ = on && socket_.setZeroCopy(true);
+    zeroCopyThreshold_ = threshold;
+    return zeroCopy_;
+}
+
+bool TcpConnection::setRingInputBuffer(size_t capacity) {
+    assert(state_ == State::Connecting);
+    return inputBuffer_.makeRing(capacity);
+}
+
+void TcpConnection::setCorked(bool on) {
+    assert(state_ == State::Connecting);
+    corked_ = on;
+}
+
+void TcpConnection::setIdleTimeout(Clock::duration timeout) {
+    assert(state_ == State::Connecting);
+    idleTimeout_ = timeout;
+}
+
+void TcpConnection::touch() {
+    // Hot path: a plain store, no clock read and no timer update
+    lastActive_ = loop_->pollReturnTime();
+}
+
+void TcpConnection::armIdleTimer(Clock::time_point deadline) {
+    idleTimer_ = loop_->runAt(deadline, [weak = weak_from_this()] {
+        if (auto conn = weak.lock()) {
+            conn->handleIdleTimer();
+        }
+    });
+}
+
+void TcpConnection::cancelIdleTimer() {
+    if (idleTimer_.valid()) {
+        loop_->cancel(idleTimer_);
+        idleTimer_ = TimerId();
+    }
+}
+
+void TcpConnection::handleIdleTimer() {
+    idleTimer_ = TimerId();
+    if (state_ != State::Connected && state_ != State::Disconnecting) {
+        return;
+    }
+
+    // Active since the timer was armed: sleep for the remainder
+    Clock::time_point deadline = lastActive_ + idleTimeout_;
+    if (deadline > loop_->pollReturnTime()) {
+        armIdleTimer(deadline);
+        return;
+    }
+
+    // The functor runs after this timer pass, closing every connection
+    // that expired in it at once
+    if (t_idleBatch.empty()) {
+        loop_->queueInLoop(&TcpConnection::reapIdleBatch);
+    }
+    t_idleBatch.push_back(shared_from_this());
+}
+
+void TcpConnection::reapIdleBatch() {
+    // Indexing: close callbacks may run arbitrary user code
+    for (size_t i = 0; i < t_idleBatch.size(); ++i) {
+        TcpConnection* conn = t_idleBatch[i].get();
+        if (conn->state_ == State::Connected ||
+            conn->state_ == State::Disconnecting) {
+            conn->reapedIdle_ = true;
+            conn->handleClose();
+        }
+    }
+    t_idleBatch.clear(); // keeps capacity for the next batch
+}
 
 void TcpConnection::connectEstablished() {
     loop_->assertInLoopThread();
@@ -135,9 +928,19 @@ void TcpConnection::connectEstablished() {
     state_ = State::Connected;
 
     // Tie the channel to this connection
-    channel_->tie(shared_from_this());
+    channel_.tie(shared_from_this());
+    if (channel_.completionIo() && !zeroCopy_) {
+        // Zero-copy completions need the socket's error events
+        completionIo_ = true;
+        channel_.setReadOp(Channel::ReadOp::Recv);
+    }
 
-    channel_->enableReading();
+    channel_.enableReading();
+
+    if (idleTimeout_ > Clock::duration::zero()) {
+        lastActive_ = Clock::now();
+        armIdleTimer(lastActive_ + idleTimeout_);
+    }
 
     if (connectionCallback_) {
         connectionCallback_(shared_from_this());
@@ -148,7 +951,9 @@ void TcpConnection::connectDestroyed() {
     loop_->assertInLoopThread();
 
     if (state_ == State::Connected) {
-        channel_->disableAll();
+        // Reported as a disconnect: connected() is false in the callback
+        state_ = State::Disconnected;
+        channel_.disableAll();
 
         if (connectionCallback_) {
             connectionCallback_(shared_from_this());
@@ -156,9 +961,21 @@ void TcpConnection::connectDestroyed() {
     }
 
     state_ = State::Disconnected;
+    cancelIdleTimer();
+    failPendingFiles();
+    stopRelay();
+
+    if (channel_.index() >= 0) {
+        channel_.remove();
+    }
 
-    if (channel_->index() >= 0) {
-        channel_->remove();
+    // The kernel may still be reading pinned pages after the socket
+    // closes: the loop holds their owners until it reports completion
+    handleError();
+    if (outputQueue_.pinnedCount() > 0) {
+        auto pins = std::make_unique<OutputQueue>();
+        pins->adoptPinned(outputQueue_);
+        loop_->parkZeroCopy(channel_.fd(), std::move(pins));
     }
 }
 
@@ -172,8 +989,10 @@ void TcpConnection::shutdown() {
 void TcpConnection::shutdownInLoop() {
     loop_->assertInLoopThread();
 
-    if (!channel_->isWriting()) {
-        socket_->shutdownWrite();
+    // Corked output may be queued without write interest yet
+    if (!channel_.isWriting() && outputQueue_.empty()) {
+        socket_.shutdownWrite();
+        closeIfRelayDone();
     }
 }
 
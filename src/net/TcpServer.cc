@@ -2,7 +2,9 @@
 #include "hayai/net/Acceptor.h"
 #include "hayai/net/EventLoop.h"
 #include "hayai/net/Socket.h"
+#include <algorithm>
 #include <cassert>
+#include <string>
 
 namespace hayai {
 TcpServer::TcpServer(EventLoop* loop, const InetAddress& addr, std::string name)
@@ -67,26 +69,86 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr) {
     EventLoop* ioLoop = threadPool_->getNextLoop();
 
     // Create unique connection name
-    std::string connName = std::format("{}#{}", name_, nextConnId_++);
+    std::string connName = name_ + "#" + std::to_string(nextConnId_++);
 
     InetAddress localAddr(Socket::getLocalAddr(sockfd));
 
-    // Create TcpConnection (shared_ptr for lifetime management)
-    auto conn = std::make_shared<TcpConnection>(ioLoop, connName, sockfd,
-                                                localAddr, peerAddr);
-
-    // Store in map
-    connections_[connName] = conn;
+    // Build the connection in its I/O thread, so the object and its
+    // buffers come from that loop's SlabPool and are freed back to it
+    // locally. Settings are copied here, where they belong.
+    ioLoop->runInLoop(
+        [this, ioLoop, sockfd, connName = std::move(connName), localAddr,
+         peerAddr, edgeTriggered = edgeTriggered_, corked = corked_,
+         idleTimeout = idleTimeout_, connectionCb = connectionCallback_,
+         messageCb = messageCallback_,
+         writeCompleteCb = writeCompleteCallback_,
+         highWaterMark = highWaterMark_, lowWaterMark = lowWaterMark_,
+         highWaterMarkCb = highWaterMarkCallback_,
+         throttleReads = throttleReads_]() mutable {
+            auto conn = TcpConnection::create(ioLoop, std::move(connName),
+                                              sockfd, localAddr, peerAddr);
+
+            conn->setEdgeTriggered(edgeTriggered);
+            conn->setCorked(corked);
+            conn->setIdleTimeout(idleTimeout);
+            conn->setConnectionCallback(std::move(connectionCb));
+            conn->setMessageCallback(std::move(messageCb));
+            conn->setWriteCompleteCallback(std::move(writeCompleteCb));
+            conn->setWaterMarks(highWaterMark, lowWaterMark);
+            conn->setHighWaterMarkCallback(std::move(highWaterMarkCb));
+            conn->setThrottleReads(throttleReads);
+
+            conn->setCloseCallback(
+                [this](const TcpConnectionPtr& c) { removeConnection(c); });
+
+            // Store in map. Queued before anything connectEstablished()
+            // can trigger, so a removal never overtakes it.
+            loop_->runInLoop([this, conn] {
+                connections_[conn->name()] = conn;
+                if (!started_) {
+                    conn->shutdown(); // missed by stop()
+                }
+            });
+
+            conn->connectEstablished();
+        });
+}
 
-    conn->setConnectionCallback(connectionCallback_);
-    conn->setMessageCallback(messageCallback_);
-    conn->setWriteCompleteCallback(writeCompleteCallback_);
+void TcpServer::broadcast(SharedSlice payload) {
+    // connections_ belongs to the acceptor loop
+    loop_->runInLoop([this, payload = std::move(payload)] {
+        std::vector<TcpConnectionPtr> conns;
+        conns.reserve(connections_.size());
+        for (auto& item : connections_) {
+            conns.push_back(item.second);
+        }
+        broadcast(conns, payload);
+    });
+}
 
-    conn->setCloseCallback(
-        [this](const TcpConnectionPtr& c) { removeConnection(c); });
+void TcpServer::broadcast(const std::vector<TcpConnectionPtr>& conns,
+                          const SharedSlice& payload) {
+    // Batch by I/O loop: one wakeup per loop, not one per connection
+    std::vector<std::pair<EventLoop*, std::vector<TcpConnectionPtr>>> batches;
+    for (const auto& conn : conns) {
+        EventLoop* ioLoop = conn->getLoop();
+        auto it = std::find_if(
+            batches.begin(), batches.end(),
+            [ioLoop](const auto& b) { return b.first == ioLoop; });
+        if (it == batches.end()) {
+            it = batches.emplace(batches.end(), ioLoop,
+                                 std::vector<TcpConnectionPtr>());
+        }
+        it->second.push_back(conn);
+    }
 
-    // Establish connection in its I/O thread
-    ioLoop->runInLoop([conn]() { conn->connectEstablished(); });
+    for (auto& [ioLoop, batch] : batches) {
+        ioLoop->runInLoop([batch = std::move(batch), payload] {
+            for (const auto& conn : batch) {
+                conn->send(payload);
+            }
+        });
+    }
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr& conn) {
@@ -105,6 +167,10 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn) {
         return;
     }
 
+    if (conn->reapedIdle()) {
+        reapedConnections_.fetch_add(1, std::memory_order_relaxed);
+    }
+
     // Destory connection in its I/O thread
     // Use queueInLoop (not runInLoop) because this connection may be
     // in its loop's current active channels, waiting to be processed.
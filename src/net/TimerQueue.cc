@@ -0,0 +1,298 @@
+#include "hayai/net/TimerQueue.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace hayai {
+
+TimerQueue::TimerQueue(Clock::time_point origin) : origin_(origin) {
+    heads_.fill(kNil);
+    tails_.fill(kNil);
+}
+
+TimerQueue::~TimerQueue() = default;
+
+TimerId TimerQueue::add(Clock::time_point when, Clock::duration interval,
+                        TimerCallback cb) {
+    // Round up: a timer never fires before its deadline
+    auto delay = std::chrono::ceil<std::chrono::milliseconds>(when - origin_);
+    uint64_t expiry = delay.count() > 0 ? static_cast<uint64_t>(delay.count())
+                                        : 0;
+    expiry = std::max(expiry, current_ + 1);
+
+    uint64_t every = 0;
+    if (interval > Clock::duration::zero()) {
+        auto ms = std::chrono::ceil<std::chrono::milliseconds>(interval);
+        every = std::max<int64_t>(ms.count(), 1);
+    }
+
+    uint32_t index = allocate();
+    Timer& timer = at(index);
+    timer.callback = std::move(cb);
+    timer.expiry = expiry;
+    timer.interval = every;
+    place(index);
+    ++size_;
+
+    return TimerId{index, timer.generation};
+}
+
+bool TimerQueue::cancel(TimerId id) {
+    if (!id.valid() || id.index >= capacity_) {
+        return false;
+    }
+    Timer& timer = at(id.index);
+    if (timer.generation != id.generation) {
+        return false; // fired or cancelled already
+    }
+
+    if (id.index == running_) {
+        // Released by runExpired() once the callback returns
+        bool wasLive = !runningCancelled_;
+        runningCancelled_ = true;
+        return wasLive;
+    }
+    if (timer.list == kNotLinked) {
+        return false;
+    }
+
+    unlink(id.index);
+    release(id.index);
+    --size_;
+    return true;
+}
+
+size_t TimerQueue::expire(Clock::time_point now) {
+    const uint64_t target = ticksSince(now);
+    size_t fired = 0;
+
+    while (current_ < target) {
+        const uint64_t next = nextPendingTick();
+        if (next > target) {
+            // Nothing due in between: jump, the wheel layout stays valid
+            current_ = target;
+            break;
+        }
+        current_ = next;
+
+        if ((current_ & kMaxDelayTicks) == 0) {
+            placeOverflow();
+        }
+        // Slots whose period starts at this tick move down a level
+        for (int level = kLevels - 1; level >= 1; --level) {
+            uint64_t mask = (uint64_t{1} << (kLevelBits * level)) - 1;
+            if ((current_ & mask) == 0) {
+                cascade(level);
+            }
+        }
+
+        // Whatever is left in this level-0 slot expires exactly now
+        const uint32_t slot = current_ & (kSlots - 1);
+        while (heads_[slot] != kNil) {
+            uint32_t index = heads_[slot];
+            unlink(index);
+            link(index, kExpiredList);
+        }
+        fired += runExpired(target);
+    }
+
+    return fired;
+}
+
+std::chrono::milliseconds
+TimerQueue::nextTimeout(Clock::time_point now,
+                        std::chrono::milliseconds cap) const {
+    const uint64_t next = nextPendingTick();
+    if (next == kNever) {
+        return cap;
+    }
+
+    const auto deadline = origin_ + std::chrono::milliseconds(next);
+    if (deadline <= now) {
+        return std::chrono::milliseconds(0);
+    }
+    auto wait = std::chrono::ceil<std::chrono::milliseconds>(deadline - now);
+    return std::min(wait, cap);
+}
+
+uint32_t TimerQueue::allocate() {
+    if (freeHead_ == kNil) {
+        // Grow by one chunk; existing timers never move
+        chunks_.push_back(std::make_unique<Timer[]>(kChunkSize));
+        uint32_t first = capacity_;
+        capacity_ += kChunkSize;
+        for (uint32_t i = capacity_; i-- > first;) {
+            at(i).next = freeHead_;
+            freeHead_ = i;
+        }
+    }
+
+    uint32_t index = freeHead_;
+    freeHead_ = at(index).next;
+    at(index).next = kNil;
+    return index;
+}
+
+void TimerQueue::release(uint32_t index) {
+    Timer& timer = at(index);
+    timer.callback = nullptr; // drop captured state now
+    if (++timer.generation == 0) {
+        timer.generation = 1;
+    }
+    timer.list = kNotLinked;
+    timer.prev = kNil;
+    timer.next = freeHead_;
+    freeHead_ = index;
+}
+
+void TimerQueue::link(uint32_t index, uint32_t list) {
+    Timer& timer = at(index);
+    timer.list = list;
+    timer.next = kNil;
+    timer.prev = tails_[list];
+
+    if (tails_[list] == kNil) {
+        heads_[list] = index;
+        if (list < kExpiredList) {
+            occupied_[list >> kLevelBits] |= uint64_t{1}
+                                             << (list & (kSlots - 1));
+        }
+    } else {
+        at(tails_[list]).next = index;
+    }
+    tails_[list] = index;
+}
+
+void TimerQueue::unlink(uint32_t index) {
+    Timer& timer = at(index);
+    const uint32_t list = timer.list;
+    assert(list != kNotLinked);
+
+    if (timer.prev == kNil) {
+        heads_[list] = timer.next;
+    } else {
+        at(timer.prev).next = timer.next;
+    }
+    if (timer.next == kNil) {
+        tails_[list] = timer.prev;
+    } else {
+        at(timer.next).prev = timer.prev;
+    }
+
+    if (heads_[list] == kNil && list < kExpiredList) {
+        occupied_[list >> kLevelBits] &= ~(uint64_t{1}
+                                           << (list & (kSlots - 1)));
+    }
+    timer.prev = kNil;
+    timer.next = kNil;
+    timer.list = kNotLinked;
+}
+
+void TimerQueue::place(uint32_t index) {
+    const uint64_t expiry = at(index).expiry;
+    assert(expiry >= current_);
+
+    // Level = highest 6-bit group in which expiry and now differ
+    int level = 0;
+    if (uint64_t diff = expiry ^ current_; diff != 0) {
+        level = (63 - std::countl_zero(diff)) / kLevelBits;
+    }
+    if (level >= kLevels) {
+        // A later top-level window: the slot index would wrap behind
+        // current_, where nothing finds it
+        link(index, kOverflowList);
+        return;
+    }
+
+    const uint32_t slot = (expiry >> (kLevelBits * level)) & (kSlots - 1);
+    link(index, level * kSlots + slot);
+}
+
+void TimerQueue::cascade(int level) {
+    const uint32_t slot = (current_ >> (kLevelBits * level)) & (kSlots - 1);
+    const uint32_t list = level * kSlots + slot;
+
+    while (heads_[list] != kNil) {
+        uint32_t index = heads_[list];
+        unlink(index);
+        place(index);
+    }
+}
+
+void TimerQueue::placeOverflow() {
+    // Detached first: timers still windows ahead go back onto the list
+    uint32_t index = heads_[kOverflowList];
+    heads_[kOverflowList] = kNil;
+    tails_[kOverflowList] = kNil;
+    while (index != kNil) {
+        const uint32_t next = at(index).next;
+        at(index).list = kNotLinked;
+        at(index).prev = kNil;
+        at(index).next = kNil;
+        place(index);
+        index = next;
+    }
+}
+
+size_t TimerQueue::runExpired(uint64_t now) {
+    size_t fired = 0;
+
+    while (heads_[kExpiredList] != kNil) {
+        const uint32_t index = heads_[kExpiredList];
+        unlink(index);
+
+        // Chunks never move, so the callback can run in place even if it
+        // schedules more timers
+        Timer& timer = at(index);
+        running_ = index;
+        runningCancelled_ = false;
+        timer.callback();
+        running_ = kNil;
+        ++fired;
+
+        if (timer.interval > 0 && !runningCancelled_) {
+            // Re-arm from the real time: a stalled loop skips missed
+            // periods instead of replaying them back to back
+            timer.expiry = now + timer.interval;
+            place(index);
+        } else {
+            release(index);
+            --size_;
+        }
+    }
+
+    return fired;
+}
+
+uint64_t TimerQueue::nextPendingTick() const {
+    for (int level = 0; level < kLevels; ++level) {
+        const int shift = kLevelBits * level;
+        const uint32_t pos = (current_ >> shift) & (kSlots - 1);
+
+        // Slots at or behind pos belong to an earlier period and are empty
+        uint64_t ahead = pos == kSlots - 1
+                             ? 0
+                             : occupied_[level] & (~uint64_t{0} << (pos + 1));
+        if (ahead != 0) {
+            const int upper = shift + kLevelBits;
+            const uint64_t base =
+                upper >= 64 ? 0 : (current_ >> upper) << upper;
+            return base | (static_cast<uint64_t>(std::countr_zero(ahead))
+                           << shift);
+        }
+    }
+    if (heads_[kOverflowList] != kNil) {
+        // The wheel is empty up to the window's end: wake where the next
+        // window starts, to place the overflow
+        return (current_ | kMaxDelayTicks) + 1;
+    }
+    return kNever;
+}
+
+uint64_t TimerQueue::ticksSince(Clock::time_point t) const {
+    auto elapsed =
+        std::chrono::floor<std::chrono::milliseconds>(t - origin_).count();
+    return elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0;
+}
+
+} // namespace hayai
@@ -0,0 +1,25 @@
+#include "hayai/net/Poller.h"
+#include <cstdlib>
+
+#if defined(__linux__)
+#include "hayai/net/poller/EpollPoller.h"
+#include "hayai/net/poller/IoUringPoller.h"
+#else
+#include "hayai/net/poller/KqueuePoller.h"
+#endif
+
+namespace hayai {
+
+std::unique_ptr<Poller> Poller::newDefaultPoller(EventLoop* loop) {
+#if defined(__linux__)
+    // Opt-in at construction time; falls back to epoll on older kernels
+    if (::getenv("HAYAI_USE_IO_URING") && IoUringPoller::isSupported()) {
+        return std::make_unique<IoUringPoller>(loop);
+    }
+    return std::make_unique<EpollPoller>(loop);
+#else
+    return std::make_unique<KqueuePoller>(loop);
+#endif
+}
+
+} // namespace hayai
@@ -0,0 +1,162 @@
+#include "hayai/net/poller/EpollPoller.h"
+#include "hayai/net/Channel.h"
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+namespace hayai {
+EpollPoller::EpollPoller(EventLoop* loop)
+    : Poller(loop), epollFd_(::epoll_create1(EPOLL_CLOEXEC)), events_(16) {
+    if (epollFd_ < 0) {
+        // Fatal error
+        abort();
+    }
+}
+
+EpollPoller::~EpollPoller() { ::close(epollFd_); }
+
+void EpollPoller::poll(std::chrono::milliseconds timeout,
+                       ChannelList* activeChannels) {
+    flushChanges();
+
+    int numEvents = ::epoll_wait(epollFd_, events_.data(),
+                                 static_cast<int>(events_.size()),
+                                 static_cast<int>(timeout.count()));
+
+    if (numEvents > 0) {
+        fillActiveChannels(numEvents, activeChannels);
+        if (static_cast<size_t>(numEvents) == events_.size()) {
+            events_.resize(events_.size() * 2);
+        }
+    } else if (numEvents < 0) {
+        if (errno != EINTR) {
+            // Log error
+        }
+    }
+}
+
+void EpollPoller::fillActiveChannels(int numEvents,
+                                     ChannelList* activeChannels) {
+    for (int i = 0; i < numEvents; ++i) {
+        Channel* channel = static_cast<Channel*>(events_[i].data.ptr);
+        uint32_t ev = events_[i].events;
+        int revents = 0;
+
+        if (ev & (EPOLLIN | EPOLLPRI | EPOLLRDHUP)) {
+            revents |= Channel::kReadEvent;
+        }
+        if (ev & EPOLLOUT) {
+            revents |= Channel::kWriteEvent;
+        }
+        // Peer hung up with nothing left to read: report as close.
+        // With EPOLLIN also set, read() returning 0 handles the close.
+        if ((ev & EPOLLHUP) && !(ev & EPOLLIN)) {
+            revents |= Channel::kCloseEvent;
+        }
+        if (ev & EPOLLERR) {
+            revents |= Channel::kErrorEvent;
+        }
+
+        channel->setRevents(revents);
+        activeChannels->push_back(channel);
+    }
+}
+
+void EpollPoller::updateChannel(Channel* channel) {
+    int fd = channel->fd();
+    ++interestUpdates_;
+
+    if (channel->index() == kNew) {
+        assert(channelAt(fd) == nullptr);
+        setChannelAt(fd, channel);
+        channel->setIndex(0);
+    } else {
+        assert(channelAt(fd) == channel);
+    }
+
+    if (!(channel->index() & kSlotQueued)) {
+        channel->setIndex(channel->index() | kSlotQueued);
+        changelist_.push_back(fd);
+    }
+}
+
+void EpollPoller::removeChannel(Channel* channel) {
+    int fd = channel->fd();
+    assert(channelAt(fd) == channel);
+    ++interestUpdates_;
+
+    // Cannot be deferred: the fd is usually closed right after this
+    if (channel->index() & kSlotKernelMask) {
+        control(EPOLL_CTL_DEL, fd, channel, 0);
+    }
+    setChannelAt(fd, nullptr);
+    channel->setIndex(kNew);
+}
+
+uint32_t EpollPoller::toEpollEvents(int slotBits) {
+    uint32_t events = 0;
+    if (slotBits & kSlotRead) {
+        events |= EPOLLIN | EPOLLPRI;
+    }
+    if (slotBits & kSlotWrite) {
+        events |= EPOLLOUT;
+    }
+    if (slotBits & kSlotEdge) {
+        events |= EPOLLET;
+    }
+    return events;
+}
+
+void EpollPoller::flushChanges() {
+    for (int fd : changelist_) {
+        Channel* channel = channelAt(fd);
+        if (channel == nullptr || !(channel->index() & kSlotQueued)) {
+            // Removed (or already flushed) since it was queued
+            continue;
+        }
+
+        const int have = channel->index() & kSlotKernelMask;
+        int want = 0;
+        if (channel->isReading()) {
+            want |= kSlotRead;
+        }
+        if (channel->isWriting()) {
+            want |= kSlotWrite;
+        }
+        if (want != 0 && channel->isEdgeTriggered()) {
+            want |= kSlotEdge;
+        }
+        channel->setIndex(want);
+
+        if (want == have) {
+            continue;
+        }
+
+        if (have == 0) {
+            control(EPOLL_CTL_ADD, fd, channel, toEpollEvents(want));
+        } else if (want == 0) {
+            control(EPOLL_CTL_DEL, fd, channel, 0);
+        } else {
+            control(EPOLL_CTL_MOD, fd, channel, toEpollEvents(want));
+        }
+    }
+    changelist_.clear();
+}
+
+void EpollPoller::control(int operation, int fd, Channel* channel,
+                          uint32_t events) {
+    struct epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.ptr = channel;
+
+    ++changeSyscalls_;
+    if (::epoll_ctl(epollFd_, operation, fd, &event) < 0) {
+        // EPOLL_CTL_DEL on an fd that was already closed is harmless;
+        // anything else means our bookkeeping is out of sync.
+        assert(operation == EPOLL_CTL_DEL);
+    }
+}
+
+} // namespace hayai
@@ -0,0 +1,594 @@
+#include "hayai/net/poller/IoUringPoller.h"
+#include "hayai/net/Channel.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace hayai {
+namespace {
+
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete,
+                 unsigned flags, const void* arg, size_t argSize) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit,
+                                      minComplete, flags, arg, argSize));
+}
+
+constexpr unsigned kRequiredFeatures =
+    IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+
+constexpr uint16_t kBufferGroup = 0;
+
+// user_data: the low bits say what completed. Polls and receives carry
+// fd << 32 | generation << 3; sends and accepts carry their Op's address
+// (heap-allocated, so 8-aligned). Ignored completions are 0.
+constexpr uint64_t kTagIgnore = 0;
+constexpr uint64_t kTagPoll = 1;
+constexpr uint64_t kTagRecv = 2;
+constexpr uint64_t kTagAccept = 3;
+constexpr uint64_t kTagSend = 4;
+constexpr uint64_t kTagMask = 7;
+
+template <typename Op>
+uint64_t opData(Op* op, uint64_t tag) {
+    return reinterpret_cast<uint64_t>(op) | tag;
+}
+
+uint32_t toPollMask(const Channel* channel) {
+    uint32_t mask = 0;
+    if (channel->isReading() &&
+        channel->readOp() == Channel::ReadOp::Readiness) {
+        mask |= POLLIN | POLLPRI;
+    }
+    if (channel->isWriting()) {
+        mask |= POLLOUT;
+    }
+    return mask;
+}
+
+template <typename T>
+T* ringPtr(void* base, unsigned offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+// A channel may finish several operations in one batch: it is listed
+// once, and what happened accumulates in its revents
+void activate(Channel* channel, Poller::ChannelList* activeChannels) {
+    if (channel->revents() == 0) {
+        activeChannels->push_back(channel);
+    }
+}
+
+} // namespace
+
+bool IoUringPoller::isSupported() {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = ioUringSetup(2, &params);
+    if (fd < 0) {
+        return false;
+    }
+    ::close(fd);
+    return (params.features & kRequiredFeatures) == kRequiredFeatures;
+}
+
+IoUringPoller::IoUringPoller(EventLoop* loop, unsigned entries)
+    : Poller(loop) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    ringFd_ = ioUringSetup(entries, &params);
+    if (ringFd_ < 0 ||
+        (params.features & kRequiredFeatures) != kRequiredFeatures) {
+        // Fatal error: callers should check isSupported() first
+        abort();
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        abort();
+    }
+    cqRing_ = sqRing_;
+
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        abort();
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    sqHead_ = ringPtr<unsigned>(sqRing_, params.sq_off.head);
+    sqTail_ = ringPtr<unsigned>(sqRing_, params.sq_off.tail);
+    sqMask_ = ringPtr<unsigned>(sqRing_, params.sq_off.ring_mask);
+    sqEntries_ = ringPtr<unsigned>(sqRing_, params.sq_off.ring_entries);
+    sqArray_ = ringPtr<unsigned>(sqRing_, params.sq_off.array);
+
+    cqHead_ = ringPtr<unsigned>(cqRing_, params.cq_off.head);
+    cqTail_ = ringPtr<unsigned>(cqRing_, params.cq_off.tail);
+    cqMask_ = ringPtr<unsigned>(cqRing_, params.cq_off.ring_mask);
+    cqes_ = ringPtr<io_uring_cqe>(cqRing_, params.cq_off.cqes);
+
+    // Not touched until the kernel receives into it, so not committed
+    // either
+    recvBuffers_.reset(new char[kRecvBuffers * kRecvBufferSize]);
+    provideBuffers(0, kRecvBuffers);
+}
+
+IoUringPoller::~IoUringPoller() {
+    ::munmap(sqes_, sqesSize_);
+    ::munmap(sqRing_, sqRingSize_);
+    // Closing the ring cancels everything still in flight
+    ::close(ringFd_);
+    for (Op* op : orphans_) {
+        delete op;
+    }
+}
+
+void IoUringPoller::poll(std::chrono::milliseconds timeout,
+                         ChannelList* activeChannels) {
+    // The last batch has been dispatched: what it handed out is free
+    retiredOps_.clear();
+    releasedKeeps_.clear();
+    returnBuffers();
+    flushChanges();
+
+    struct timespec ts;
+    ts.tv_sec = timeout.count() / 1000;
+    ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+
+    // Submit all queued changes and wait, in one syscall
+    int ret = enter(timeout.count() > 0 ? 1 : 0, &ts);
+    if (ret < 0 && errno != EINTR && errno != ETIME) {
+        // Log error
+    }
+
+    fillActiveChannels(activeChannels);
+}
+
+void IoUringPoller::fillActiveChannels(ChannelList* activeChannels) {
+    unsigned head = *cqHead_;
+    const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head) {
+        const io_uring_cqe& cqe = cqes_[head & *cqMask_];
+        const uint64_t tag = cqe.user_data & kTagMask;
+        if (tag == kTagAccept || tag == kTagSend) {
+            completeOp(reinterpret_cast<Op*>(cqe.user_data & ~kTagMask), tag,
+                       cqe, activeChannels);
+            continue;
+        }
+        if (tag != kTagPoll && tag != kTagRecv) {
+            continue;
+        }
+
+        const char* data = nullptr;
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            // Stale or not, the buffer goes back to the pool next time
+            const unsigned bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+            usedBuffers_.push_back(bid);
+            data = recvBuffers_.get() + bid * kRecvBufferSize;
+        }
+
+        int fd = static_cast<int>(cqe.user_data >> 32);
+        Channel* channel = channelAt(fd);
+        if (channel == nullptr) {
+            continue;
+        }
+        Registration& reg = registrationAt(fd);
+
+        if (tag == kTagRecv) {
+            if (reg.recvData != cqe.user_data) {
+                continue;
+            }
+            reg.recvData = 0;
+            reg.readCancelled = false;
+            // Re-armed on the next flush, if reads are still wanted
+            markDirty(fd, reg);
+            if (cqe.res == -ECANCELED || cqe.res == -ENOBUFS ||
+                cqe.res == -EAGAIN || cqe.res == -EINTR) {
+                // Nothing received (out of buffers: retried once the
+                // last batch's come back)
+                continue;
+            }
+            // A receive that beat its cancellation still delivers: the
+            // bytes are gone from the socket
+            activate(channel, activeChannels);
+            channel->setCompletion(
+                {Channel::Completion::Op::Recv, cqe.res, data, nullptr});
+            continue;
+        }
+
+        if (reg.pollData != cqe.user_data) {
+            // Completion of a poll we already cancelled or replaced
+            continue;
+        }
+        reg.pollData = 0;
+        reg.armedMask = 0;
+
+        int revents = 0;
+        if (cqe.res < 0) {
+            // e.g. -EBADF: do not re-arm, the owner has to react
+            revents |= Channel::kErrorEvent;
+        } else {
+            auto ev = static_cast<uint32_t>(cqe.res);
+            if (ev & (POLLIN | POLLPRI | POLLRDHUP)) {
+                revents |= Channel::kReadEvent;
+            }
+            if (ev & POLLOUT) {
+                revents |= Channel::kWriteEvent;
+            }
+            if ((ev & POLLHUP) && !(ev & POLLIN)) {
+                revents |= Channel::kCloseEvent;
+            }
+            if (ev & POLLERR) {
+                revents |= Channel::kErrorEvent;
+            }
+            // One-shot poll fired: re-arm on the next flush
+            markDirty(fd, reg);
+        }
+
+        activate(channel, activeChannels);
+        channel->setRevents(channel->revents() | revents);
+    }
+
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+void IoUringPoller::completeOp(Op* op, uint64_t tag, const io_uring_cqe& cqe,
+                               ChannelList* activeChannels) {
+    op->inFlight = false;
+    Channel* channel = op->channel;
+    if (channel == nullptr) {
+        // Orphaned by removeChannel(): nobody is waiting for this
+        if (tag == kTagAccept && cqe.res >= 0) {
+            ::close(cqe.res);
+        }
+        auto it = std::find(orphans_.begin(), orphans_.end(), op);
+        assert(it != orphans_.end());
+        *it = orphans_.back();
+        orphans_.pop_back();
+        retiredOps_.emplace_back(op);
+        return;
+    }
+
+    if (tag == kTagSend) {
+        // Dropped after dispatch: this may be the owner's last reference
+        releasedKeeps_.push_back(std::move(op->keep));
+        activate(channel, activeChannels);
+        channel->setCompletion(
+            {Channel::Completion::Op::Send, cqe.res, nullptr, nullptr});
+        return;
+    }
+
+    Registration& reg = registrationAt(channel->fd());
+    reg.readCancelled = false;
+    markDirty(channel->fd(), reg);
+    if (cqe.res == -ECANCELED || cqe.res == -EAGAIN || cqe.res == -EINTR) {
+        return;
+    }
+    // The address stays put until the next accept is armed, after dispatch
+    activate(channel, activeChannels);
+    channel->setCompletion({Channel::Completion::Op::Accept, cqe.res, nullptr,
+                            reinterpret_cast<const sockaddr*>(&op->addr)});
+}
+
+void IoUringPoller::submitPending() {
+    flushChanges();
+    if (toSubmit_ > 0) {
+        ++changeSyscalls_;
+        enter(0, nullptr);
+    }
+}
+
+void IoUringPoller::submitSend(Channel* channel, const struct iovec* iov,
+                               int iovcnt) {
+    const int fd = channel->fd();
+    assert(channelAt(fd) == channel);
+    Registration& reg = registrationAt(fd);
+    if (!reg.send) {
+        reg.send = std::make_unique<Op>();
+    }
+
+    Op& op = *reg.send;
+    assert(!op.inFlight);
+    op.channel = channel;
+    op.inFlight = true;
+    op.keep = channel->tiedOwner();
+    op.iov.assign(iov, iov + iovcnt);
+    std::memset(&op.msg, 0, sizeof(op.msg));
+    op.msg.msg_iov = op.iov.data();
+    op.msg.msg_iovlen = op.iov.size();
+
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&op.msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = opData(&op, kTagSend);
+    pushSqe();
+}
+
+void IoUringPoller::updateChannel(Channel* channel) {
+    int fd = channel->fd();
+    ++interestUpdates_;
+
+    if (channel->index() == kNew) {
+        assert(channelAt(fd) == nullptr);
+        setChannelAt(fd, channel);
+        channel->setIndex(kAdded);
+    }
+    Registration& reg = registrationAt(fd);
+
+    // Nothing is sent to the kernel here; flushChanges() batches it
+    markDirty(fd, reg);
+}
+
+void IoUringPoller::removeChannel(Channel* channel) {
+    int fd = channel->fd();
+    assert(channelAt(fd) == channel);
+    ++interestUpdates_;
+
+    Registration& reg = registrationAt(fd);
+    if (reg.pollData != 0) {
+        submitPollRemove(reg.pollData);
+    }
+    if (reg.recvData != 0 && !reg.readCancelled) {
+        submitCancel(reg.recvData);
+    }
+    releaseOp(std::move(reg.accept), kTagAccept);
+    releaseOp(std::move(reg.send), kTagSend);
+    reg = Registration{};
+    setChannelAt(fd, nullptr);
+    channel->setIndex(kNew);
+}
+
+IoUringPoller::Registration& IoUringPoller::registrationAt(int fd) {
+    const auto slot = static_cast<size_t>(fd);
+    if (slot >= registrations_.size()) {
+        registrations_.resize(std::max(slot + 1, registrations_.size() * 2));
+    }
+    return registrations_[slot];
+}
+
+void IoUringPoller::markDirty(int fd, Registration& reg) {
+    if (!reg.dirty) {
+        reg.dirty = true;
+        dirtyFds_.push_back(fd);
+    }
+}
+
+void IoUringPoller::flushChanges() {
+    for (int fd : dirtyFds_) {
+        Channel* channel = channelAt(fd);
+        if (channel == nullptr || !registrationAt(fd).dirty) {
+            // Removed (or already flushed) since it was queued
+            continue;
+        }
+
+        Registration& reg = registrationAt(fd);
+        reg.dirty = false;
+        flushReadOp(fd, channel, reg);
+
+        uint32_t want = toPollMask(channel);
+        if (reg.recvData != 0) {
+            // Readiness reads wait for the receive in flight, so bytes
+            // are still seen in order
+            want &= ~static_cast<uint32_t>(POLLIN | POLLPRI);
+        }
+
+        if (reg.pollData != 0 && reg.armedMask != want) {
+            submitPollRemove(reg.pollData);
+            reg.pollData = 0;
+            reg.armedMask = 0;
+        }
+
+        if (reg.pollData == 0 && want != 0) {
+            reg.pollData = nextUserData(fd, kTagPoll);
+            reg.armedMask = want;
+            submitPollAdd(fd, want, reg.pollData);
+        }
+    }
+    dirtyFds_.clear();
+}
+
+void IoUringPoller::flushReadOp(int fd, Channel* channel, Registration& reg) {
+    const bool reading = channel->isReading();
+    const bool recv = reading && channel->readOp() == Channel::ReadOp::Recv;
+    const bool accept =
+        reading && channel->readOp() == Channel::ReadOp::Accept;
+
+    if (reg.recvData != 0) {
+        if (!recv && !reg.readCancelled) {
+            submitCancel(reg.recvData);
+            reg.readCancelled = true;
+        }
+    } else if (recv) {
+        reg.recvData = nextUserData(fd, kTagRecv);
+        submitRecv(fd, reg.recvData);
+    }
+
+    Op* op = reg.accept.get();
+    if (op != nullptr && op->inFlight) {
+        if (!accept && !reg.readCancelled) {
+            submitCancel(opData(op, kTagAccept));
+            reg.readCancelled = true;
+        }
+    } else if (accept) {
+        if (op == nullptr) {
+            reg.accept = std::make_unique<Op>();
+            op = reg.accept.get();
+        }
+        op->channel = channel;
+        submitAccept(fd, *op);
+    }
+}
+
+void IoUringPoller::releaseOp(std::unique_ptr<Op> op, uint64_t tag) {
+    if (!op) {
+        return;
+    }
+    if (op->inFlight) {
+        // The kernel still uses it: kept until the completion is posted
+        submitCancel(opData(op.get(), tag));
+        op->channel = nullptr;
+        orphans_.push_back(op.release());
+    } else {
+        retiredOps_.push_back(std::move(op));
+    }
+}
+
+uint64_t IoUringPoller::nextUserData(int fd, uint64_t tag) {
+    const uint64_t gen = nextGen_++ & (UINT32_MAX >> 3);
+    return (static_cast<uint64_t>(fd) << 32) | (gen << 3) | tag;
+}
+
+void IoUringPoller::returnBuffers() {
+    if (usedBuffers_.empty()) {
+        return;
+    }
+    // Consecutive ids go back in one request
+    std::sort(usedBuffers_.begin(), usedBuffers_.end());
+    size_t first = 0;
+    for (size_t i = 1; i <= usedBuffers_.size(); ++i) {
+        if (i == usedBuffers_.size() ||
+            usedBuffers_[i] != usedBuffers_[i - 1] + 1) {
+            provideBuffers(usedBuffers_[first],
+                           static_cast<unsigned>(i - first));
+            first = i;
+        }
+    }
+    usedBuffers_.clear();
+}
+
+io_uring_sqe* IoUringPoller::getSqe() {
+    unsigned tail = *sqTail_;
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+
+    if (tail - head >= *sqEntries_) {
+        // Ring full: hand what we have to the kernel without waiting
+        ++changeSyscalls_;
+        enter(0, nullptr);
+        head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        assert(tail - head < *sqEntries_);
+    }
+
+    unsigned index = tail & *sqMask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[index] = index;
+    return sqe;
+}
+
+void IoUringPoller::submitPollAdd(int fd, uint32_t mask, uint64_t userData) {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = mask;
+    sqe->user_data = userData;
+    pushSqe();
+}
+
+void IoUringPoller::submitPollRemove(uint64_t userData) {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = userData;
+    sqe->user_data = kTagIgnore;
+    pushSqe();
+}
+
+void IoUringPoller::submitRecv(int fd, uint64_t userData) {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->len = kRecvBufferSize;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    sqe->user_data = userData;
+    pushSqe();
+}
+
+void IoUringPoller::submitAccept(int fd, Op& op) {
+    op.inFlight = true;
+    op.addrLen = sizeof(op.addr);
+
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&op.addr);
+    sqe->addr2 = reinterpret_cast<uint64_t>(&op.addrLen);
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = opData(&op, kTagAccept);
+    pushSqe();
+}
+
+void IoUringPoller::submitCancel(uint64_t userData) {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = userData;
+    sqe->user_data = kTagIgnore;
+    pushSqe();
+}
+
+void IoUringPoller::provideBuffers(unsigned bid, unsigned count) {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = static_cast<int>(count);
+    sqe->addr =
+        reinterpret_cast<uint64_t>(recvBuffers_.get() + bid * kRecvBufferSize);
+    sqe->len = kRecvBufferSize;
+    sqe->off = bid;
+    sqe->buf_group = kBufferGroup;
+    sqe->user_data = kTagIgnore;
+    pushSqe();
+}
+
+void IoUringPoller::pushSqe() {
+    __atomic_store_n(sqTail_, *sqTail_ + 1, __ATOMIC_RELEASE);
+    ++toSubmit_;
+}
+
+int IoUringPoller::enter(unsigned minComplete, const struct timespec* ts) {
+    if (toSubmit_ == 0 && minComplete == 0) {
+        return 0;
+    }
+
+    unsigned flags = 0;
+    io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+
+    if (minComplete > 0) {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = reinterpret_cast<uint64_t>(ts);
+    }
+
+    int ret = ioUringEnter(ringFd_, toSubmit_, minComplete, flags,
+                           minComplete > 0 ? &arg : nullptr,
+                           minComplete > 0 ? sizeof(arg) : 0);
+    if (ret >= 0) {
+        toSubmit_ -= std::min(toSubmit_, static_cast<unsigned>(ret));
+    }
+    return ret;
+}
+
+} // namespace hayai
@@ -0,0 +1,164 @@
+#include "hayai/net/poller/KqueuePoller.h"
+#include "hayai/net/Channel.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <unistd.h>
+
+namespace hayai {
+KqueuePoller::KqueuePoller(EventLoop* loop)
+    : Poller(loop), kqueueFd_(::kqueue()), events_(16) {
+    if (kqueueFd_ < 0) {
+        // Fatal error
+        abort();
+    }
+}
+
+KqueuePoller::~KqueuePoller() { ::close(kqueueFd_); }
+
+void KqueuePoller::poll(std::chrono::milliseconds timeout,
+                        ChannelList* activeChannels) {
+    struct timespec ts;
+    ts.tv_sec = timeout.count() / 1000;
+    ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+
+    // Pending interest changes ride along with the wait
+    applyChanges();
+    int numEvents = ::kevent(kqueueFd_, changes_.data(),
+                             static_cast<int>(changes_.size()), events_.data(),
+                             static_cast<int>(events_.size()), &ts);
+    changes_.clear();
+
+    if (numEvents > 0) {
+        fillActiveChannels(numEvents, activeChannels);
+        if (static_cast<size_t>(numEvents) == events_.size()) {
+            events_.resize(events_.size() * 2);
+        }
+    } else if (numEvents < 0) {
+        if (errno != EINTR) {
+            // Log error
+        }
+    }
+}
+
+void KqueuePoller::applyChanges() {
+    for (const struct kevent& change : changes_) {
+        const auto fd = static_cast<size_t>(change.ident);
+        if (fd >= applied_.size()) {
+            applied_.resize(std::max(fd + 1, applied_.size() * 2));
+        }
+        const int filter = change.filter == EVFILT_READ ? Channel::kReadEvent
+                                                        : Channel::kWriteEvent;
+        if (change.flags & EV_DELETE) {
+            applied_[fd] &= ~filter;
+        } else {
+            applied_[fd] |= filter;
+        }
+    }
+}
+
+void KqueuePoller::fillActiveChannels(int numEvents,
+                                      ChannelList* activeChannels) {
+    for (int i = 0; i < numEvents; ++i) {
+        Channel* channel = static_cast<Channel*>(events_[i].udata);
+        if (channel == nullptr) {
+            // Error receipt for a queued EV_DELETE; nothing to dispatch
+            continue;
+        }
+        int revents = 0;
+
+        if (events_[i].filter == EVFILT_READ) {
+            revents |= Channel::kReadEvent;
+        }
+        if (events_[i].filter == EVFILT_WRITE) {
+            revents |= Channel::kWriteEvent;
+        }
+        if (events_[i].flags & EV_EOF) {
+            revents |= Channel::kCloseEvent;
+        }
+        if (events_[i].flags & EV_ERROR) {
+            revents |= Channel::kErrorEvent;
+        }
+
+        channel->setRevents(revents);
+        activeChannels->push_back(channel);
+    }
+}
+
+void KqueuePoller::updateChannel(Channel* channel) {
+    int fd = channel->fd();
+    ++interestUpdates_;
+
+    if (channel->index() == kNew) {
+        assert(channelAt(fd) == nullptr);
+        setChannelAt(fd, channel);
+        channel->setIndex(0);
+    }
+
+    const int registered = channel->index();
+    const int want = channel->events() & (Channel::kReadEvent |
+                                          Channel::kWriteEvent);
+    const unsigned short addFlags =
+        EV_ADD | EV_ENABLE | (channel->isEdgeTriggered() ? EV_CLEAR : 0);
+
+    // Queue only the filters whose state changed
+    if ((want ^ registered) & Channel::kReadEvent) {
+        struct kevent change;
+        if (want & Channel::kReadEvent) {
+            EV_SET(&change, fd, EVFILT_READ, addFlags, 0, 0, channel);
+        } else {
+            EV_SET(&change, fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+        }
+        changes_.push_back(change);
+    }
+
+    if ((want ^ registered) & Channel::kWriteEvent) {
+        struct kevent change;
+        if (want & Channel::kWriteEvent) {
+            EV_SET(&change, fd, EVFILT_WRITE, addFlags, 0, 0, channel);
+        } else {
+            EV_SET(&change, fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+        }
+        changes_.push_back(change);
+    }
+
+    channel->setIndex(want);
+}
+
+void KqueuePoller::removeChannel(Channel* channel) {
+    int fd = channel->fd();
+    assert(channelAt(fd) == channel);
+    setChannelAt(fd, nullptr);
+    channel->setIndex(kNew);
+    ++interestUpdates_;
+
+    // Drop queued changes for this fd: it is usually closed right after.
+    // An add dropped here never reached the kernel, so it needs no delete.
+    changes_.erase(std::remove_if(changes_.begin(), changes_.end(),
+                                  [fd](const struct kevent& change) {
+                                      return static_cast<int>(change.ident) ==
+                                             fd;
+                                  }),
+                   changes_.end());
+
+    // Filters the kernel already has must go now, for the same reason
+    int registered = 0;
+    if (static_cast<size_t>(fd) < applied_.size()) {
+        registered = applied_[fd];
+        applied_[fd] = 0;
+    }
+    struct kevent changes[2];
+    int n = 0;
+    if (registered & Channel::kReadEvent) {
+        EV_SET(&changes[n++], fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+    }
+    if (registered & Channel::kWriteEvent) {
+        EV_SET(&changes[n++], fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+    }
+    if (n > 0) {
+        ++changeSyscalls_;
+        ::kevent(kqueueFd_, changes, n, nullptr, 0, nullptr);
+    }
+}
+
+} // namespace hayai
@@ -1,41 +1,161 @@
 #include "hayai/utils/Buffer.h"
+#include <algorithm>
 #include <errno.h>
+#include <memory>
+#include <sys/mman.h>
 #include <sys/uio.h> // For readv
 #include <unistd.h>
 
 namespace hayai {
-ssize_t Buffer::readFd(int fd, int *savedErrno) {
+namespace {
+// Shared by every Buffer read on this thread: one loop reads one socket at
+// a time. On the heap, not the stack, so coroutine and small-stack threads
+// can read too.
+struct ReadOverflow {
+  std::unique_ptr<char[]> data;
+  size_t capacity{0};
+  size_t size{Buffer::kDefaultReadOverflow};
 
-  // Problem: We don't know how much data the kernel has for us.
-  // - If we allocate too much: waste memory
-  // - If we allocate too little: need multiple read() calls
-  //
-  // Solution: Use readv() with TWO buffers:
-  // 1. Our main buffer's writable space
-  // 2. A 64KB stack-allocated buffer as overflow
+  char *get() {
+    if (capacity < size) {
+      data.reset(new char[size]); // not zero-filled
+      capacity = size;
+    }
+    return data.get();
+  }
+};
+
+thread_local ReadOverflow t_overflow;
+} // namespace
+
+void Buffer::setReadOverflowSize(size_t bytes) {
+  t_overflow.size = bytes;
+  if (bytes < t_overflow.capacity) {
+    t_overflow.data.reset();
+    t_overflow.capacity = 0;
+  }
+}
+
+size_t Buffer::readOverflowSize() { return t_overflow.size; }
+
+void BufferStorageDeleter::operator()(char *p) const noexcept {
+  if (mirrorSize != 0) {
+    ::munmap(p, 2 * mirrorSize);
+  } else {
+    SlabPool::release(p);
+  }
+}
+
+Buffer::Storage Buffer::mapRing(size_t &capacity) const {
+#if defined(__linux__)
+  const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  const size_t readable = readableBytes();
+  capacity = std::max(capacity, kCheapPrepend + readable);
+  capacity = (capacity + page - 1) / page * page;
+
+  int fd = ::memfd_create("hayai-ring", MFD_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  void *base = MAP_FAILED;
+  if (::ftruncate(fd, static_cast<off_t>(capacity)) == 0) {
+    // Reserve twice the size, then put the same pages in both halves
+    base = ::mmap(nullptr, 2 * capacity, PROT_NONE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  }
+  if (base != MAP_FAILED) {
+    char *lo = static_cast<char *>(base);
+    for (char *half : {lo, lo + capacity}) {
+      if (::mmap(half, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                 fd, 0) == MAP_FAILED) {
+        ::munmap(base, 2 * capacity);
+        base = MAP_FAILED;
+        break;
+      }
+    }
+  }
+  ::close(fd); // the mappings keep the memory
+  if (base == MAP_FAILED) {
+    return nullptr;
+  }
+
+  Storage ring(static_cast<char *>(base), BufferStorageDeleter{capacity});
+  if (readable > 0) {
+    std::memcpy(ring.get() + kCheapPrepend, peek(), readable);
+  }
+  return ring;
+#else
+  (void)capacity;
+  return nullptr;
+#endif
+}
+
+bool Buffer::makeRing(size_t capacity) {
+  const size_t readable = readableBytes();
+  Storage ring = mapRing(capacity);
+  if (!ring) {
+    return false;
+  }
+  buffer_ = std::move(ring);
+  capacity_ = capacity;
+  readerIndex_ = kCheapPrepend;
+  writerIndex_ = readerIndex_ + readable;
+  return true;
+}
+
+ssize_t Buffer::readFd(int fd, int *savedErrno, size_t *overflowBytes) {
+  // We don't know how much the kernel has for us. Make room for what
+  // recent reads brought (usually free: the caller retrieved everything,
+  // so this only moves the indices), and catch the rest in the overflow
+  // area with the same readv().
+  // A ring keeps the size it was given: its free space is contiguous
+  // anyway, and an occasional spill just grows it
+  if (!isRing() && writableBytes() < readHint_) {
+    ensureWritableBytes(readHint_);
+  }
+  // A full buffer with no overflow area would offer the kernel nothing,
+  // and the 0 that readv() returns would read as EOF
+  const size_t overflowSize = t_overflow.size;
+  if (writableBytes() == 0 && overflowSize == 0) {
+    ensureWritableBytes(std::max(readHint_, kInitialSize));
+  }
 
-  char extrabuf[65536];
   struct iovec vec[2];
   const size_t writable = writableBytes();
-
   vec[0].iov_base = beginWrite();
   vec[0].iov_len = writable;
-  vec[1].iov_base = extrabuf;
-  vec[1].iov_len = sizeof(extrabuf);
 
-  const int iovcnt = (writable < sizeof(extrabuf)) ? 2 : 1;
+  int iovcnt = 1;
+  if (overflowSize > 0 && writable < overflowSize) {
+    vec[1].iov_base = t_overflow.get();
+    vec[1].iov_len = overflowSize;
+    iovcnt = 2;
+  }
   const ssize_t n = ::readv(fd, vec, iovcnt);
 
   if (n < 0) {
     *savedErrno = errno;
-  } else if (static_cast<size_t>(n) <= writable) {
+    return n;
+  }
+
+  if (static_cast<size_t>(n) <= writable) {
     writerIndex_ += n;
   } else {
-    // Used overflow buffer, need to append extra data
-    writerIndex_ = buffer_.size();
-    append(extrabuf, n - writable);
+    // Second copy: the next read is sized to avoid it
+    writerIndex_ += writable; // full (a ring's free space ends in the mirror)
+    append(t_overflow.data.get(), n - writable);
+    if (overflowBytes) {
+      *overflowBytes = n - writable;
+    }
   }
 
+  // Jump up to a larger read at once, drift down slowly
+  const size_t size = static_cast<size_t>(n);
+  if (size > readHint_) {
+    readHint_ = std::min(size, kMaxReadHint);
+  } else {
+    readHint_ -= (readHint_ - size) / 8;
+  }
   return n;
 }
-} // namespace hayai
\ No newline at end of file
+} // namespace hayai
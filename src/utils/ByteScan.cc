@@ -0,0 +1,198 @@
+#include "hayai/utils/ByteScan.h"
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAYAI_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace hayai {
+namespace {
+
+const char* scalarCRLF(const char* p, const char* end) {
+    // Each '\n' is a candidate; memchr() is vectorized by libc
+    while (end - p >= 2) {
+        const auto* lf =
+            static_cast<const char*>(std::memchr(p + 1, '\n', end - p - 1));
+        if (lf == nullptr) {
+            return nullptr;
+        }
+        if (lf[-1] == '\r') {
+            return lf - 1;
+        }
+        p = lf;
+    }
+    return nullptr;
+}
+
+const char* scalarAnyOf(const char* p, const char* end, std::string_view set) {
+    if (set.empty()) {
+        return nullptr;
+    }
+    std::array<bool, 256> member{};
+    for (char c : set) {
+        member[static_cast<unsigned char>(c)] = true;
+    }
+    for (; p < end; ++p) {
+        if (member[static_cast<unsigned char>(*p)]) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+#ifdef HAYAI_SCAN_X86
+
+// The SSE2 and AVX2 loops differ only in the vector width; each handles
+// whole vectors and leaves the tail to the scalar code.
+
+const char* sse2CRLF(const char*& p, const char* end) {
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    // The '\n' of a match starting at p + 15 is in the next load at p + 1
+    for (; end - p >= 17; p += 16) {
+        auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, cr)) &
+                        _mm_movemask_epi8(_mm_cmpeq_epi8(b, lf));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return nullptr;
+}
+
+const char* sse2Byte(const char*& p, const char* end, char c) {
+    const __m128i needle = _mm_set1_epi8(c);
+    for (; end - p >= 16; p += 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return nullptr;
+}
+
+const char* sse2AnyOf(const char*& p, const char* end, std::string_view set) {
+    __m128i needles[kMaxVectorSet];
+    for (size_t i = 0; i < set.size(); ++i) {
+        needles[i] = _mm_set1_epi8(set[i]);
+    }
+    for (; end - p >= 16; p += 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hit = _mm_setzero_si128();
+        for (size_t i = 0; i < set.size(); ++i) {
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, needles[i]));
+        }
+        if (unsigned mask = _mm_movemask_epi8(hit); mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return nullptr;
+}
+
+__attribute__((target("avx2"))) const char* avx2CRLF(const char*& p,
+                                                     const char* end) {
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    for (; end - p >= 33; p += 32) {
+        auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        uint32_t mask =
+            static_cast<uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, cr))) &
+            static_cast<uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(b, lf)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return nullptr;
+}
+
+__attribute__((target("avx2"))) const char*
+avx2Byte(const char*& p, const char* end, char c) {
+    const __m256i needle = _mm256_set1_epi8(c);
+    for (; end - p >= 32; p += 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t mask = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return nullptr;
+}
+
+__attribute__((target("avx2"))) const char*
+avx2AnyOf(const char*& p, const char* end, std::string_view set) {
+    __m256i needles[kMaxVectorSet];
+    for (size_t i = 0; i < set.size(); ++i) {
+        needles[i] = _mm256_set1_epi8(set[i]);
+    }
+    for (; end - p >= 32; p += 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hit = _mm256_setzero_si256();
+        for (size_t i = 0; i < set.size(); ++i) {
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, needles[i]));
+        }
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return nullptr;
+}
+
+const bool kHasAvx2 = __builtin_cpu_supports("avx2");
+
+#endif // HAYAI_SCAN_X86
+
+} // namespace
+
+const char* findCRLF(const char* begin, const char* end) {
+#ifdef HAYAI_SCAN_X86
+    const char* p = begin;
+    if (const char* hit = kHasAvx2 ? avx2CRLF(p, end) : sse2CRLF(p, end)) {
+        return hit;
+    }
+    return scalarCRLF(p, end);
+#else
+    return scalarCRLF(begin, end);
+#endif
+}
+
+const char* findByte(const char* begin, const char* end, char c) {
+#ifdef HAYAI_SCAN_X86
+    const char* p = begin;
+    if (const char* hit = kHasAvx2 ? avx2Byte(p, end, c) : sse2Byte(p, end, c)) {
+        return hit;
+    }
+    begin = p;
+#endif
+    return begin < end ? static_cast<const char*>(
+                             std::memchr(begin, c, end - begin))
+                       : nullptr;
+}
+
+const char* findAnyOf(const char* begin, const char* end, std::string_view set) {
+    if (set.size() == 1) {
+        return findByte(begin, end, set[0]);
+    }
+#ifdef HAYAI_SCAN_X86
+    if (!set.empty() && set.size() <= kMaxVectorSet) {
+        const char* p = begin;
+        if (const char* hit = kHasAvx2 ? avx2AnyOf(p, end, set)
+                                       : sse2AnyOf(p, end, set)) {
+            return hit;
+        }
+        begin = p;
+    }
+#endif
+    return scalarAnyOf(begin, end, set);
+}
+
+} // namespace hayai
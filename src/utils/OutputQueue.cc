@@ -0,0 +1,355 @@
+#include "hayai/utils/OutputQueue.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iterator>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#elif defined(__APPLE__)
+#include <sys/socket.h>
+#endif
+
+namespace hayai {
+namespace {
+#ifdef IOV_MAX
+constexpr int kMaxIov = IOV_MAX < 1024 ? IOV_MAX : 1024;
+#else
+constexpr int kMaxIov = 16; // POSIX minimum
+#endif
+
+// Larger one-off blocks are freed rather than kept as the spare
+constexpr size_t kMaxSpareBytes = 16 * OutputQueue::kBlockSize;
+} // namespace
+
+void OutputQueue::append(const char* data, size_t len) {
+    if (len == 0) {
+        return;
+    }
+
+    // Pack into the tail block while it has room (file segments have none)
+    if (head_ < segments_.size()) {
+        Segment& tail = segments_.back();
+        if (tail.block) {
+            size_t used = (tail.data - tail.block.get()) + tail.len;
+            if (tail.capacity - used >= len) {
+                std::memcpy(tail.block.get() + used, data, len);
+                tail.len += len;
+                bytes_ += len;
+                return;
+            }
+        }
+    }
+
+    Segment& seg = pushSegment();
+    size_t capacity = std::max(len, kBlockSize);
+    if (spare_ && spareCapacity_ >= capacity) {
+        seg.block = std::move(spare_);
+        seg.capacity = spareCapacity_;
+        spareCapacity_ = 0;
+    } else {
+        // Not zero-filled: every byte is written before it is sent
+        seg.block.reset(static_cast<char*>(SlabPool::allocate(capacity)));
+        seg.capacity = capacity;
+    }
+    std::memcpy(seg.block.get(), data, len);
+    seg.data = seg.block.get();
+    seg.len = len;
+    bytes_ += len;
+}
+
+void OutputQueue::appendBorrowed(std::string_view data) {
+    if (data.empty()) {
+        return;
+    }
+    Segment& seg = pushSegment();
+    seg.data = data.data();
+    seg.len = data.size();
+    bytes_ += data.size();
+}
+
+void OutputQueue::appendShared(std::string_view data,
+                               std::shared_ptr<const void> owner,
+                               bool zeroCopy) {
+    if (data.size() < kMinShareBytes) {
+        append(data);
+        return;
+    }
+    Segment& seg = pushSegment();
+    seg.data = data.data();
+    seg.len = data.size();
+    seg.owner = std::move(owner);
+    seg.zeroCopy = zeroCopy && seg.owner != nullptr;
+    bytes_ += data.size();
+}
+
+void OutputQueue::appendOwned(std::string&& data, size_t offset) {
+    assert(offset <= data.size());
+    const size_t len = data.size() - offset;
+    if (len < kMinShareBytes) {
+        append(data.data() + offset, len);
+        return;
+    }
+    Segment& seg = pushSegment();
+    std::string& stored = seg.storage.emplace<std::string>(std::move(data));
+    seg.data = stored.data() + offset;
+    seg.len = len;
+    bytes_ += len;
+}
+
+void OutputQueue::appendOwned(Buffer&& data, size_t offset) {
+    assert(offset <= data.readableBytes());
+    const size_t len = data.readableBytes() - offset;
+    if (len < kMinShareBytes) {
+        append(data.peek() + offset, len);
+        return;
+    }
+    Segment& seg = pushSegment();
+    Buffer& stored = seg.storage.emplace<Buffer>(std::move(data));
+    seg.data = stored.peek() + offset;
+    seg.len = len;
+    bytes_ += len;
+}
+
+void OutputQueue::appendFile(int fileFd, off_t offset, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    Segment& seg = pushSegment();
+    seg.fileFd = fileFd;
+    seg.fileOffset = offset;
+    seg.len = length;
+    bytes_ += length;
+    fileBytes_ += length;
+}
+
+ssize_t OutputQueue::writeFd(int fd, int* savedErrno) {
+    if (head_ < segments_.size()) {
+        if (segments_[head_].fileFd >= 0) {
+            return writeFile(fd, savedErrno);
+        }
+        if (segments_[head_].zeroCopy) {
+            return writeZeroCopy(fd, savedErrno);
+        }
+    }
+
+    struct iovec vec[kMaxIov];
+    const int count = gather(vec, false, kMaxIov);
+    const ssize_t n = count == 1 ? ::write(fd, vec[0].iov_base, vec[0].iov_len)
+                                 : ::writev(fd, vec, count);
+    if (n < 0) {
+        *savedErrno = errno;
+    } else {
+        retrieve(static_cast<size_t>(n));
+    }
+    return n;
+}
+
+int OutputQueue::peekMemory(struct iovec* vec, int maxCount) const {
+    return gather(vec, false, maxCount);
+}
+
+int OutputQueue::gather(struct iovec* vec, bool zeroCopy,
+                        int maxCount) const {
+    int count = 0;
+    for (size_t i = head_; i < segments_.size() && count < maxCount; ++i) {
+        const Segment& seg = segments_[i];
+        if (seg.fileFd >= 0 || seg.zeroCopy != zeroCopy) {
+            break;
+        }
+        vec[count].iov_base = const_cast<char*>(seg.data);
+        vec[count].iov_len = seg.len;
+        ++count;
+    }
+    return count;
+}
+
+ssize_t OutputQueue::writeZeroCopy(int fd, int* savedErrno) {
+    struct iovec vec[kMaxIov];
+    const int count = gather(vec, true, kMaxIov);
+
+#if defined(__linux__) && defined(MSG_ZEROCOPY)
+    struct msghdr msg {};
+    msg.msg_iov = vec;
+    msg.msg_iovlen = count;
+    ssize_t n = ::sendmsg(fd, &msg, MSG_ZEROCOPY);
+    if (n < 0 && errno == ENOBUFS) {
+        // Out of pinned-page budget (optmem): copy this time
+        n = ::writev(fd, vec, count);
+    } else if (n > 0) {
+        // The kernel reads these pages until the completion arrives
+        size_t covered = 0;
+        for (size_t i = head_; covered < static_cast<size_t>(n); ++i) {
+            pinned_.push_back(Pinned{zeroCopySeq_, segments_[i].owner});
+            covered += segments_[i].len;
+        }
+        ++zeroCopySeq_;
+    }
+#else
+    const ssize_t n = ::writev(fd, vec, count);
+#endif
+
+    if (n < 0) {
+        *savedErrno = errno;
+    } else {
+        retrieve(static_cast<size_t>(n));
+    }
+    return n;
+}
+
+size_t OutputQueue::reapZeroCopy(int fd, size_t* copiedSends) {
+    size_t completed = 0;
+#if defined(__linux__) && defined(MSG_ZEROCOPY)
+    while (!pinned_.empty()) {
+        char control[128];
+        struct msghdr msg {};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (::recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+            break; // EAGAIN: drained
+        }
+
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr;
+             cm = CMSG_NXTHDR(&msg, cm)) {
+            const bool recvErr =
+                (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+            if (!recvErr) {
+                continue;
+            }
+            const auto* err =
+                reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+            if (err->ee_errno != 0 ||
+                err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+
+            // Sends [lo, hi] are done; the counter may wrap
+            const uint32_t lo = err->ee_info;
+            const uint32_t hi = err->ee_data;
+            const uint32_t sends = hi - lo + 1;
+            completed += sends;
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                *copiedSends += sends;
+            }
+            std::erase_if(pinned_, [lo, hi](const Pinned& p) {
+                return p.seq - lo <= hi - lo;
+            });
+        }
+    }
+#else
+    (void)fd;
+    (void)copiedSends;
+#endif
+    return completed;
+}
+
+void OutputQueue::adoptPinned(OutputQueue& other) {
+    pinned_.insert(pinned_.end(),
+                   std::make_move_iterator(other.pinned_.begin()),
+                   std::make_move_iterator(other.pinned_.end()));
+    other.pinned_.clear();
+}
+
+ssize_t OutputQueue::writeFile(int fd, int* savedErrno) {
+    const Segment& seg = segments_[head_];
+    ssize_t n;
+
+#if defined(__linux__)
+    off_t offset = seg.fileOffset;
+    n = ::sendfile(fd, seg.fileFd, &offset, seg.len);
+#elif defined(__APPLE__)
+    // Reports a partial transfer through `sent`, also on EAGAIN
+    off_t sent = static_cast<off_t>(seg.len);
+    int rc = ::sendfile(seg.fileFd, fd, seg.fileOffset, &sent, nullptr, 0);
+    n = (rc == 0 || (errno == EAGAIN && sent > 0)) ? sent : -1;
+#else
+    // No sendfile(): bounce through a stack buffer
+    char buf[64 * 1024];
+    n = ::pread(seg.fileFd, buf, std::min(seg.len, sizeof(buf)),
+                seg.fileOffset);
+    if (n > 0) {
+        n = ::write(fd, buf, n);
+    }
+#endif
+
+    if (n == 0) {
+        errno = EIO; // the file is shorter than the queued range
+        n = -1;
+    }
+    if (n < 0) {
+        *savedErrno = errno;
+    } else {
+        retrieve(static_cast<size_t>(n));
+    }
+    return n;
+}
+
+void OutputQueue::retrieve(size_t len) {
+    assert(len <= bytes_);
+    bytes_ -= len;
+    consumed_ += len;
+
+    while (len > 0) {
+        Segment& seg = segments_[head_];
+        const size_t taken = std::min(len, seg.len);
+        if (seg.fileFd >= 0) {
+            fileBytes_ -= taken;
+        }
+        if (taken < seg.len) {
+            if (seg.fileFd >= 0) {
+                seg.fileOffset += static_cast<off_t>(taken);
+            } else {
+                seg.data += taken;
+            }
+            seg.len -= taken;
+            return;
+        }
+        len -= taken;
+        popSegment();
+    }
+}
+
+void OutputQueue::retrieveAll() {
+    while (head_ < segments_.size()) {
+        popSegment();
+    }
+    consumed_ += bytes_;
+    bytes_ = 0;
+    fileBytes_ = 0;
+}
+
+OutputQueue::Segment& OutputQueue::pushSegment() {
+    // Reclaim the consumed prefix once it dominates the vector
+    if (head_ > 0 && head_ * 2 >= segments_.size()) {
+        std::move(segments_.begin() + head_, segments_.end(),
+                  segments_.begin());
+        segments_.resize(segments_.size() - head_);
+        head_ = 0;
+    }
+    return segments_.emplace_back();
+}
+
+void OutputQueue::popSegment() {
+    Segment& seg = segments_[head_];
+    if (seg.block && seg.capacity >= spareCapacity_ &&
+        seg.capacity <= kMaxSpareBytes) {
+        spare_ = std::move(seg.block);
+        spareCapacity_ = seg.capacity;
+    }
+    seg = Segment();
+
+    if (++head_ == segments_.size()) {
+        segments_.clear(); // keeps capacity
+        head_ = 0;
+    }
+}
+
+} // namespace hayai
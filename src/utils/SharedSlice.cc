@@ -0,0 +1,30 @@
+#include "hayai/utils/SharedSlice.h"
+#include "hayai/utils/SlabPool.h"
+#include <cstring>
+
+namespace hayai {
+
+SharedSlice SharedSlice::copyOf(std::string_view bytes) {
+    if (bytes.empty()) {
+        return {};
+    }
+    // Not zero-filled: every byte is copied in before anyone sees it
+    std::shared_ptr<char[]> block = std::allocate_shared_for_overwrite<char[]>(
+        SlabAllocator<char>(), bytes.size());
+    std::memcpy(block.get(), bytes.data(), bytes.size());
+    const char* data = block.get();
+    return SharedSlice(std::move(block), data, bytes.size());
+}
+
+SharedSlice SharedSlice::adopt(std::string&& bytes) {
+    if (bytes.empty()) {
+        return {};
+    }
+    auto owner = std::allocate_shared<const std::string>(
+        SlabAllocator<std::string>(), std::move(bytes));
+    const char* data = owner->data();
+    const size_t size = owner->size();
+    return SharedSlice(std::move(owner), data, size);
+}
+
+} // namespace hayai
@@ -0,0 +1,192 @@
+#include "hayai/utils/SlabPool.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace hayai {
+namespace {
+constexpr size_t kClasses =
+    std::countr_zero(SlabPool::kMaxBlock) -
+    std::countr_zero(SlabPool::kMinBlock) + 1;
+constexpr uint32_t kHeapClass = UINT32_MAX;
+
+// Slabs are carved one block at a time; small classes share 64KB slabs,
+// large ones get a few blocks per slab
+constexpr size_t kSlabBytes = 64 * 1024;
+constexpr size_t kMinBlocksPerSlab = 4;
+
+// Return stack value once the owner is gone
+void* const kOrphaned = reinterpret_cast<void*>(uintptr_t{1});
+
+thread_local SlabPool* t_current = nullptr;
+
+// Free blocks link through their first bytes
+void*& nextOf(void* block) { return *static_cast<void**>(block); }
+} // namespace
+
+struct SlabPool::Core {
+    // In front of every block; keeps the payload max_align_t-aligned
+    struct alignas(alignof(std::max_align_t)) Header {
+        Core* pool; // nullptr: global heap
+        uint32_t cls;
+    };
+
+    struct Class {
+        void* free{nullptr};
+        char* bump{nullptr}; // uncarved rest of the current slab
+        char* bumpEnd{nullptr};
+    };
+
+    static Header* header(void* block) {
+        return reinterpret_cast<Header*>(block) - 1;
+    }
+
+    static size_t blockSize(uint32_t cls) { return kMinBlock << cls; }
+
+    void* allocate(uint32_t cls) {
+        Class& c = classes[cls];
+        if (c.free == nullptr) {
+            drainRemote();
+        }
+        void* block = c.free;
+        if (block != nullptr) {
+            c.free = nextOf(block);
+        } else {
+            block = carve(cls);
+        }
+        ++outstanding;
+        return block;
+    }
+
+    void releaseLocal(void* block) {
+        Class& c = classes[header(block)->cls];
+        nextOf(block) = c.free;
+        c.free = block;
+        --outstanding;
+    }
+
+    // Returns whether the caller must delete the (orphaned) pool
+    bool releaseRemote(void* block) {
+        void* head = remote.load(std::memory_order_acquire);
+        do {
+            if (head == kOrphaned) {
+                return orphanRefs.fetch_sub(1, std::memory_order_acq_rel) ==
+                       1;
+            }
+            nextOf(block) = head;
+        } while (!remote.compare_exchange_weak(head, block,
+                                               std::memory_order_release,
+                                               std::memory_order_acquire));
+        return false;
+    }
+
+    void drainRemote() {
+        void* block = remote.exchange(nullptr, std::memory_order_acquire);
+        while (block != nullptr) {
+            void* next = nextOf(block);
+            releaseLocal(block);
+            ++remoteReleases;
+            block = next;
+        }
+    }
+
+    void* carve(uint32_t cls) {
+        Class& c = classes[cls];
+        const size_t stride = sizeof(Header) + blockSize(cls);
+        if (static_cast<size_t>(c.bumpEnd - c.bump) < stride) {
+            const size_t bytes =
+                std::max(kSlabBytes, kMinBlocksPerSlab * stride);
+            // Not zero-filled
+            slabs.emplace_back(new char[bytes]);
+            slabBytes += bytes;
+            c.bump = slabs.back().get();
+            c.bumpEnd = c.bump + bytes;
+        }
+        auto* h = reinterpret_cast<Header*>(c.bump);
+        c.bump += stride;
+        h->pool = this;
+        h->cls = cls;
+        return h + 1;
+    }
+
+    // Owner thread only
+    std::array<Class, kClasses> classes{};
+    std::vector<std::unique_ptr<char[]>> slabs;
+    size_t slabBytes{0};
+    size_t remoteReleases{0};
+    int64_t outstanding{0}; // handed out and not yet back on a free list
+
+    // Blocks released by other threads; kOrphaned after the owner left
+    alignas(64) std::atomic<void*> remote{nullptr};
+    // Blocks still out once orphaned; the last one deletes the pool
+    std::atomic<int64_t> orphanRefs{0};
+};
+
+SlabPool::SlabPool() : core_(new Core) {
+    // One pool per thread (one per EventLoop)
+    assert(t_current == nullptr);
+    t_current = this;
+}
+
+SlabPool::~SlabPool() {
+    t_current = nullptr;
+
+    // Publish how many blocks are out, then close the return stack; the
+    // blocks that made it onto the stack are back already
+    core_->orphanRefs.store(core_->outstanding, std::memory_order_relaxed);
+    void* block = core_->remote.exchange(kOrphaned, std::memory_order_acq_rel);
+    int64_t returned = 0;
+    for (; block != nullptr; block = nextOf(block)) {
+        ++returned;
+    }
+    if (core_->orphanRefs.fetch_sub(returned, std::memory_order_acq_rel) ==
+        returned) {
+        delete core_;
+    }
+}
+
+SlabPool* SlabPool::current() { return t_current; }
+
+void* SlabPool::allocate(size_t& size) {
+    using Header = Core::Header;
+    SlabPool* pool = t_current;
+    if (pool == nullptr || size > kMaxBlock) {
+        auto* h = static_cast<Header*>(::operator new(sizeof(Header) + size));
+        h->pool = nullptr;
+        h->cls = kHeapClass;
+        return h + 1;
+    }
+
+    const uint32_t cls =
+        size <= kMinBlock
+            ? 0
+            : std::bit_width(size - 1) - std::countr_zero(kMinBlock);
+    size = Core::blockSize(cls);
+    return pool->core_->allocate(cls);
+}
+
+void SlabPool::release(void* p) noexcept {
+    if (p == nullptr) {
+        return;
+    }
+    Core::Header* h = Core::header(p);
+    Core* owner = h->pool;
+    if (owner == nullptr) {
+        ::operator delete(h);
+    } else if (t_current != nullptr && t_current->core_ == owner) {
+        owner->releaseLocal(p);
+    } else if (owner->releaseRemote(p)) {
+        delete owner;
+    }
+}
+
+size_t SlabPool::slabBytes() const { return core_->slabBytes; }
+
+size_t SlabPool::remoteReleases() const { return core_->remoteReleases; }
+
+} // namespace hayai
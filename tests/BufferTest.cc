@@ -1,5 +1,6 @@
 #include "hayai/utils/Buffer.h"
 #include <cstring>
+#include <string>
 #include <gtest/gtest.h>
 #include <unistd.h>
 
@@ -75,6 +76,50 @@ TEST_F(BufferTest, FindCRLF) {
   EXPECT_EQ(pos, 5);
 }
 
+TEST_F(BufferTest, FindAtEveryPositionAndLength) {
+  // Cover the vector bodies, the tails and the boundaries between them
+  for (size_t len = 2; len < 100; ++len) {
+    for (size_t at = 0; at + 1 < len; ++at) {
+      Buffer buf;
+      std::string data(len, 'a');
+      data[at] = '\r';
+      data[at + 1] = '\n';
+      buf.append(data);
+      ASSERT_EQ(buf.findCRLF(), buf.peek() + at) << len << " " << at;
+      ASSERT_EQ(buf.findEOL(), buf.peek() + at + 1);
+      ASSERT_EQ(buf.findByte('\r'), buf.peek() + at);
+      ASSERT_EQ(buf.findAnyOf(";\n:"), buf.peek() + at + 1);
+    }
+  }
+
+  Buffer buf;
+  buf.append(std::string(200, 'a') + "\r" + std::string(50, 'b') + "\n");
+  EXPECT_EQ(buf.findCRLF(), nullptr); // lone '\r' and '\n'
+  EXPECT_EQ(buf.findByte('z'), nullptr);
+  EXPECT_EQ(buf.findAnyOf(""), nullptr);
+  // Larger sets take the table path
+  EXPECT_EQ(buf.findAnyOf("0123456789b"), buf.peek() + 201);
+}
+
+TEST_F(BufferTest, FindResumesFromOffset) {
+  Buffer buf;
+  buf.append("GET / HTTP/1.1\r");
+  size_t scanned = 0;
+  EXPECT_EQ(buf.findCRLF(scanned), nullptr);
+  scanned = buf.readableBytes();
+
+  // The '\r' seen last time still pairs with the new '\n'
+  buf.append("\nHost: x\r\n");
+  const char *crlf = buf.findCRLF(scanned);
+  ASSERT_NE(crlf, nullptr);
+  EXPECT_EQ(crlf - buf.peek(), 14);
+
+  // Matches before the offset are skipped
+  EXPECT_EQ(buf.findCRLF(16) - buf.peek(), 23);
+  EXPECT_EQ(buf.findByte('T', 3) - buf.peek(), 7);
+  EXPECT_EQ(buf.findAnyOf("xH", 100), nullptr);
+}
+
 TEST_F(BufferTest, RetrievePartial) {
   Buffer buf;
   buf.append("abcdef", 6);
@@ -187,6 +232,65 @@ TEST_F(BufferTest, ReadFdWithExtrabuf) {
   close(pipefd[1]);
 }
 
+TEST_F(BufferTest, ReadFdGrowsToObservedReadSize) {
+  int pipefd[2];
+  ASSERT_EQ(pipe(pipefd), 0);
+  const std::string chunk(32 * 1024, 'r');
+
+  Buffer buf(100);
+  int savedErrno = 0;
+  size_t overflow = 0;
+  ASSERT_EQ(write(pipefd[1], chunk.data(), chunk.size()),
+            static_cast<ssize_t>(chunk.size()));
+  ASSERT_EQ(buf.readFd(pipefd[0], &savedErrno, &overflow),
+            static_cast<ssize_t>(chunk.size()));
+  EXPECT_GT(overflow, 0u); // first large read spills
+  EXPECT_EQ(buf.retrieveAllAsString(), chunk);
+
+  // Steady state: the next read of the same size lands in place
+  for (int i = 0; i < 3; ++i) {
+    overflow = 0;
+    ASSERT_EQ(write(pipefd[1], chunk.data(), chunk.size()),
+              static_cast<ssize_t>(chunk.size()));
+    ASSERT_EQ(buf.readFd(pipefd[0], &savedErrno, &overflow),
+              static_cast<ssize_t>(chunk.size()));
+    EXPECT_EQ(overflow, 0u);
+    EXPECT_EQ(buf.retrieveAllAsString(), chunk);
+  }
+
+  close(pipefd[0]);
+  close(pipefd[1]);
+}
+
+TEST_F(BufferTest, ReadFdWithoutOverflowArea) {
+  int pipefd[2];
+  ASSERT_EQ(pipe(pipefd), 0);
+  const std::string data(4096, 'x');
+  ASSERT_EQ(write(pipefd[1], data.data(), data.size()),
+            static_cast<ssize_t>(data.size()));
+
+  Buffer::setReadOverflowSize(0);
+  Buffer buf(100);
+  int savedErrno = 0;
+  size_t overflow = 0;
+  ssize_t n = buf.readFd(pipefd[0], &savedErrno, &overflow);
+  Buffer::setReadOverflowSize(Buffer::kDefaultReadOverflow);
+
+  // Only the free space was offered to the kernel
+  EXPECT_EQ(n, static_cast<ssize_t>(buf.readableBytes()));
+  EXPECT_LT(static_cast<size_t>(n), data.size());
+  EXPECT_EQ(overflow, 0u);
+
+  // The rest stays in the pipe for the next read
+  while (buf.readableBytes() < data.size()) {
+    ASSERT_GT(buf.readFd(pipefd[0], &savedErrno), 0);
+  }
+  EXPECT_EQ(buf.retrieveAllAsString(), data);
+
+  close(pipefd[0]);
+  close(pipefd[1]);
+}
+
 TEST_F(BufferTest, EmptyBuffer) {
   Buffer buf;
   EXPECT_EQ(buf.readableBytes(), 0);
@@ -196,6 +300,179 @@ TEST_F(BufferTest, EmptyBuffer) {
   EXPECT_NE(ptr, nullptr);
 }
 
+TEST_F(BufferTest, MoveLeavesSourceUsable) {
+  Buffer buf;
+  buf.append("hello world");
+  const char *data = buf.peek();
+
+  Buffer moved(std::move(buf));
+  EXPECT_EQ(moved.peek(), data); // storage moved, not copied
+  EXPECT_EQ(moved.retrieveAllAsString(), "hello world");
+
+  EXPECT_EQ(buf.readableBytes(), 0);
+  buf.append("again");
+  EXPECT_EQ(buf.retrieveAllAsString(), "again");
+  buf.append("and again");
+  EXPECT_EQ(buf.readableBytes(), 9);
+
+  Buffer assigned;
+  assigned = std::move(buf);
+  EXPECT_EQ(assigned.retrieveAllAsString(), "and again");
+}
+
+TEST_F(BufferTest, RingKeepsDataContiguousAcrossTheWrap) {
+  Buffer buf;
+  buf.append("kept");
+  if (!buf.makeRing(4096)) {
+    GTEST_SKIP() << "ring buffers not supported here";
+  }
+  ASSERT_TRUE(buf.isRing());
+  const size_t capacity = buf.capacity();
+  EXPECT_EQ(capacity % 4096, 0u);
+  EXPECT_EQ(buf.retrieveAsString(4), "kept");
+
+  // Stream through several laps, always leaving a partial record behind
+  std::string pending(300, 'p');
+  buf.append(pending);
+  char next = 'a';
+  const char *base = buf.peek() - buf.prependableBytes();
+  for (int i = 0; i < 200; ++i) {
+    std::string chunk(700, next);
+    next = next == 'z' ? 'a' : next + 1;
+    buf.append(chunk);
+    pending += chunk;
+    EXPECT_EQ(std::string_view(buf.peek(), buf.readableBytes()), pending);
+    buf.retrieve(700);
+    pending.erase(0, 700);
+    EXPECT_LT(buf.peek(), base + capacity); // wrapped, never moved
+  }
+  EXPECT_EQ(buf.capacity(), capacity); // no growth, no compaction
+
+  // Growing keeps it a ring and keeps the bytes
+  buf.append(std::string(2 * capacity, 'G'));
+  pending += std::string(2 * capacity, 'G');
+  EXPECT_TRUE(buf.isRing());
+  EXPECT_GT(buf.capacity(), capacity);
+  EXPECT_EQ(buf.retrieveAllAsString(), pending);
+
+  // Copies are plain buffers
+  buf.append("copy me");
+  Buffer copy(buf);
+  EXPECT_FALSE(copy.isRing());
+  EXPECT_EQ(copy.retrieveAllAsString(), "copy me");
+}
+
+TEST_F(BufferTest, RingReadFdFillsTheWrappedFreeSpace) {
+  Buffer buf;
+  if (!buf.makeRing(4096)) {
+    GTEST_SKIP() << "ring buffers not supported here";
+  }
+  const size_t capacity = buf.capacity();
+  int pipefd[2];
+  ASSERT_EQ(pipe(pipefd), 0);
+
+  // Move the reader near the end of the first copy
+  buf.append(std::string(capacity - 100, 'x'));
+  buf.retrieve(capacity - 110);
+  EXPECT_EQ(buf.writableBytes(), capacity - 10);
+
+  const std::string data(capacity - 10, 'y');
+  ASSERT_EQ(write(pipefd[1], data.data(), data.size()),
+            static_cast<ssize_t>(data.size()));
+  int savedErrno = 0;
+  size_t overflow = 0;
+  ASSERT_EQ(buf.readFd(pipefd[0], &savedErrno, &overflow),
+            static_cast<ssize_t>(data.size()));
+  EXPECT_EQ(overflow, 0u); // read in place, across the wrap
+  EXPECT_EQ(buf.retrieveAsString(10), std::string(10, 'x'));
+  EXPECT_EQ(buf.retrieveAllAsString(), data);
+
+  // More than fits while wrapped: the spill grows the ring, nothing lost
+  buf.append(std::string(capacity - 100, 'x'));
+  buf.retrieve(capacity - 110);
+  const std::string more(capacity + 500, 'z');
+  ASSERT_EQ(write(pipefd[1], more.data(), more.size()),
+            static_cast<ssize_t>(more.size()));
+  ASSERT_EQ(buf.readFd(pipefd[0], &savedErrno, &overflow),
+            static_cast<ssize_t>(more.size()));
+  EXPECT_EQ(overflow, 510u);
+  EXPECT_TRUE(buf.isRing());
+  EXPECT_GT(buf.capacity(), capacity);
+  EXPECT_EQ(buf.retrieveAsString(10), std::string(10, 'x'));
+  EXPECT_EQ(buf.retrieveAllAsString(), more);
+
+  close(pipefd[0]);
+  close(pipefd[1]);
+}
+
+TEST_F(BufferTest, FullRingWithoutOverflowAreaStillReads) {
+  Buffer buf;
+  if (!buf.makeRing(4096)) {
+    GTEST_SKIP() << "ring buffers not supported here";
+  }
+  const size_t capacity = buf.capacity();
+  buf.append(std::string(capacity, 'x'));
+  ASSERT_EQ(buf.writableBytes(), 0u);
+
+  int pipefd[2];
+  ASSERT_EQ(pipe(pipefd), 0);
+  ASSERT_EQ(write(pipefd[1], "yz", 2), 2);
+
+  // Not a 0 (EOF) from an empty iovec: the ring grows and reads
+  Buffer::setReadOverflowSize(0);
+  int savedErrno = 0;
+  ssize_t n = buf.readFd(pipefd[0], &savedErrno);
+  Buffer::setReadOverflowSize(Buffer::kDefaultReadOverflow);
+  EXPECT_EQ(n, 2);
+  EXPECT_TRUE(buf.isRing());
+  EXPECT_GT(buf.capacity(), capacity);
+  EXPECT_EQ(buf.retrieveAsString(capacity), std::string(capacity, 'x'));
+  EXPECT_EQ(buf.retrieveAllAsString(), "yz");
+
+  close(pipefd[0]);
+  close(pipefd[1]);
+}
+
+TEST_F(BufferTest, IntegersAreBigEndian) {
+  Buffer buf;
+  buf.appendInt8(-2);
+  buf.appendInt16(0x0102);
+  buf.appendInt32(0x03040506);
+  buf.appendInt64(0x0708090a0b0c0d0e);
+  EXPECT_EQ(std::string_view(buf.peek(), buf.readableBytes()),
+            std::string_view("\xfe\x01\x02\x03\x04\x05\x06"
+                             "\x07\x08\x09\x0a\x0b\x0c\x0d\x0e",
+                             15));
+
+  EXPECT_EQ(buf.peekInt8(), -2);
+  EXPECT_EQ(buf.readInt8(), -2);
+  EXPECT_EQ(buf.readInt16(), 0x0102);
+  EXPECT_EQ(buf.readInt32(), 0x03040506);
+  EXPECT_EQ(buf.peekInt64(), 0x0708090a0b0c0d0e);
+  EXPECT_EQ(buf.readInt64(), 0x0708090a0b0c0d0e);
+  EXPECT_EQ(buf.readableBytes(), 0u);
+
+  buf.appendInt32(-1);
+  EXPECT_EQ(buf.readInt32(), -1);
+}
+
+TEST_F(BufferTest, PrependFillsThePrependSpaceInPlace) {
+  Buffer buf;
+  EXPECT_EQ(buf.prependableBytes(), Buffer::kCheapPrepend);
+  buf.append("payload");
+  const char *payload = buf.peek();
+
+  buf.prependInt32(7);
+  EXPECT_EQ(buf.peek(), payload - 4); // nothing moved
+  EXPECT_EQ(buf.prependableBytes(), Buffer::kCheapPrepend - 4);
+  EXPECT_EQ(buf.readInt32(), 7);
+  EXPECT_EQ(buf.retrieveAllAsString(), "payload");
+
+  buf.append("x");
+  buf.prepend("ab", 2);
+  EXPECT_EQ(buf.retrieveAllAsString(), "abx");
+}
+
 } // namespace test
 } // namespace hayai
 
@@ -1,5 +1,16 @@
 #include "hayai/coro/AsyncConnection.h"
+#include "hayai/coro/spawn.h"
+#include "hayai/net/EventLoop.h"
+#include "hayai/net/InetAddress.h"
 #include <gtest/gtest.h>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 using namespace hayai;
 using namespace hayai::coro;
@@ -15,6 +26,311 @@ protected:
 
 TEST_F(CoroConnectionTest, Compilation) { SUCCEED(); }
 
+TEST_F(CoroConnectionTest, SendResumesOnceWritten) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "coro", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+  AsyncConnection async(conn);
+
+  // Larger than the socket buffer: completion comes from handleWrite
+  constexpr size_t kBytes = 4 * 1024 * 1024;
+  std::atomic<size_t> received{0};
+  size_t receivedAtResume = 0;
+  int sends = 0;
+
+  auto task = [&]() -> Task<void> {
+    co_await async.send("small"); // written directly
+    ++sends;
+    co_await async.send(std::string(kBytes, 'c'));
+    ++sends;
+    receivedAtResume = received.load();
+    // Queued: the frame's cleanup, queued on completion, runs in the
+    // same batch before the loop exits
+    loop.queueInLoop([&] { loop.quit(); });
+  };
+
+  std::thread reader([&] {
+    char buf[65536];
+    while (received < kBytes + 5) {
+      ssize_t n = read(fds[1], buf, sizeof(buf));
+      if (n > 0) {
+        received += n;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  // From inside the loop: a functor queued before loop() would wait out
+  // the first poll
+  loop.runAfter(std::chrono::milliseconds(0), [&] { spawn(&loop, task()); });
+  loop.loop();
+  reader.join();
+
+  EXPECT_EQ(sends, 2);
+  // Resumed only after the last byte left the output queue
+  EXPECT_EQ(conn->outputBytes(), 0u);
+  EXPECT_GT(receivedAtResume, 0u);
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+TEST_F(CoroConnectionTest, SendResumesForItsOwnBytesOnly) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "coro", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+  AsyncConnection async(conn);
+
+  constexpr size_t kBytes = 4 * 1024 * 1024;
+  std::atomic<size_t> received{0};
+  size_t queuedAtResume = 1;
+  auto task = [&]() -> Task<void> {
+    co_await async.send(std::string(kBytes, 'c'));
+    queuedAtResume = conn->outputBytes();
+    loop.queueInLoop([&] { loop.quit(); });
+  };
+
+  std::thread reader([&] {
+    char buf[65536];
+    while (received < kBytes + 5) {
+      ssize_t n = read(fds[1], buf, sizeof(buf));
+      if (n > 0) {
+        received += n;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  // An earlier send's write-complete is already queued when the
+  // coroutine suspends; it must not wake it
+  loop.runAfter(std::chrono::milliseconds(0), [&] {
+    conn->send("early");
+    spawn(&loop, task());
+  });
+  loop.loop();
+  reader.join();
+
+  EXPECT_EQ(queuedAtResume, 0u);
+  EXPECT_EQ(received.load(), kBytes + 5);
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+TEST_F(CoroConnectionTest, SendFailsWhenTheConnectionCloses) {
+  std::signal(SIGPIPE, SIG_IGN); // as any server does; the peer hangs up
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "coro", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  conn->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+  AsyncConnection async(conn);
+
+  int results = 0;
+  bool first = true;
+  bool second = true;
+  auto task = [&]() -> Task<void> {
+    // Never read: still queued when the peer goes away
+    first = co_await async.send(std::string(4 * 1024 * 1024, 'c'));
+    ++results;
+    // Not connected any more: resumes right away
+    second = co_await async.send("late");
+    ++results;
+    loop.queueInLoop([&] { loop.quit(); });
+  };
+
+  loop.runAfter(std::chrono::milliseconds(0), [&] { spawn(&loop, task()); });
+  loop.runAfter(std::chrono::milliseconds(20), [&] { close(fds[1]); });
+  loop.runAfter(std::chrono::seconds(5), [&] { loop.quit(); });
+  loop.loop();
+
+  EXPECT_EQ(results, 2);
+  EXPECT_FALSE(first);
+  EXPECT_FALSE(second);
+  EXPECT_FALSE(conn->connected());
+
+  conn->connectDestroyed();
+}
+
+TEST_F(CoroConnectionTest, SendFileResumesOnceSent) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  std::FILE *file = std::tmpfile();
+  ASSERT_NE(file, nullptr);
+  const std::string content(3 * 1024 * 1024, 'z');
+  ASSERT_EQ(write(fileno(file), content.data(), content.size()),
+            static_cast<ssize_t>(content.size()));
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "coro", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+  AsyncConnection async(conn);
+
+  std::atomic<size_t> received{0};
+  bool sent = false;
+  auto task = [&]() -> Task<void> {
+    sent = co_await async.sendFile(fileno(file), 0, content.size());
+    loop.queueInLoop([&] { loop.quit(); });
+  };
+
+  std::thread reader([&] {
+    char buf[65536];
+    while (received < content.size()) {
+      ssize_t n = read(fds[1], buf, sizeof(buf));
+      if (n > 0) {
+        received += n;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  loop.runAfter(std::chrono::milliseconds(0), [&] { spawn(&loop, task()); });
+  loop.loop();
+  reader.join();
+
+  EXPECT_TRUE(sent);
+  EXPECT_EQ(received.load(), content.size());
+  EXPECT_EQ(conn->ioStats().bytesWritten, content.size());
+
+  close(fds[1]);
+  conn->connectDestroyed();
+  std::fclose(file);
+}
+
+TEST_F(CoroConnectionTest, ReadFrameWaitsForWholeFrames) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "coro-frames", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+  AsyncConnection async(conn);
+
+  LengthFieldCodec codec(4, 64 * 1024);
+  Buffer wire;
+  codec.encode("first", &wire);
+  codec.encode(std::string(20000, 'x'), &wire);
+  codec.encode("third", &wire);
+  wire.appendInt32(100000); // over the limit
+
+  std::vector<std::string> frames;
+  bool rejected = false;
+  auto task = [&]() -> Task<void> {
+    for (;;) {
+      auto frame = co_await async.readFrame(codec);
+      if (!frame) {
+        rejected = true;
+        break;
+      }
+      frames.emplace_back(*frame);
+    }
+    loop.queueInLoop([&] { loop.quit(); });
+  };
+
+  // Dribbled in: the coroutine must only wake for complete frames
+  loop.runAfter(std::chrono::milliseconds(0), [&] {
+    spawn(&loop, task());
+    std::string_view bytes(wire.peek(), wire.readableBytes());
+    for (size_t off = 0; off < bytes.size(); off += 4096) {
+      std::string_view piece = bytes.substr(off, 4096);
+      loop.runAfter(std::chrono::milliseconds(1 + off / 4096), [&, piece] {
+        ASSERT_EQ(write(fds[1], piece.data(), piece.size()),
+                  static_cast<ssize_t>(piece.size()));
+      });
+    }
+  });
+  loop.loop();
+
+  ASSERT_EQ(frames.size(), 3u);
+  EXPECT_EQ(frames[0], "first");
+  EXPECT_EQ(frames[1], std::string(20000, 'x'));
+  EXPECT_EQ(frames[2], "third");
+  EXPECT_TRUE(rejected);
+  EXPECT_FALSE(conn->connected());
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+TEST_F(CoroConnectionTest, ReadFrameEndsWhenThePeerClosesMidFrame) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "coro-frames", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+  AsyncConnection async(conn);
+
+  LengthFieldCodec codec(4, 64 * 1024);
+  Buffer wire;
+  codec.encode("whole", &wire);
+  codec.encode(std::string(1000, 'x'), &wire);
+  // The second frame is cut off halfway
+  const std::string bytes(wire.peek(), wire.readableBytes() - 500);
+
+  std::vector<std::string> frames;
+  bool ended = false;
+  auto task = [&]() -> Task<void> {
+    for (;;) {
+      auto frame = co_await async.readFrame(codec);
+      if (!frame) {
+        ended = true;
+        break;
+      }
+      frames.emplace_back(*frame);
+    }
+    // Closed: a later read returns at once, too
+    ended = ended && !co_await async.readFrame(codec);
+    loop.queueInLoop([&] { loop.quit(); });
+  };
+
+  loop.runAfter(std::chrono::milliseconds(0), [&] {
+    spawn(&loop, task());
+    ASSERT_EQ(write(fds[1], bytes.data(), bytes.size()),
+              static_cast<ssize_t>(bytes.size()));
+    close(fds[1]);
+  });
+  loop.runAfter(std::chrono::seconds(5), [&] { loop.quit(); });
+  loop.loop();
+
+  ASSERT_EQ(frames.size(), 1u);
+  EXPECT_EQ(frames[0], "whole");
+  EXPECT_TRUE(ended);
+  EXPECT_FALSE(conn->connected());
+
+  conn->connectDestroyed();
+}
+
 } // namespace test
 } // namespace hayai
 
@@ -0,0 +1,85 @@
+#include "hayai/net/EventLoop.h"
+#include "hayai/utils/SlabPool.h"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace hayai {
+namespace test {
+
+class EventLoopWakeupTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+  void TearDown() override {}
+};
+
+TEST_F(EventLoopWakeupTest, CrossThreadWakeupsCoalesce) {
+  EventLoop loop;
+  int count = 0;
+
+  // A burst of posts from another thread before the loop drains them
+  std::thread producer([&]() {
+    for (int i = 0; i < 1000; ++i) {
+      loop.queueInLoop([&]() { count++; });
+    }
+  });
+  producer.join();
+
+  EXPECT_EQ(loop.wakeupWrites(), 1u);
+
+  loop.queueInLoop([&]() { loop.quit(); });
+  loop.loop();
+  EXPECT_EQ(count, 1000);
+
+  // Drained: the next post must wake the loop again
+  std::thread again([&]() {
+    loop.queueInLoop([&]() { loop.quit(); });
+  });
+  again.join();
+  EXPECT_EQ(loop.wakeupWrites(), 2u);
+  loop.loop();
+}
+
+TEST_F(EventLoopWakeupTest, PostsBetweenLoopsRecycleNodes) {
+  EventLoop loop;
+  int count = 0;
+  size_t carved = 0;
+  size_t carvedAfter = 0;
+  size_t remote = 0;
+
+  std::thread producer([&]() {
+    EventLoop own; // its SlabPool serves this thread's posts
+    std::atomic<int> drained{0};
+    for (int round = 0; round < 10; ++round) {
+      for (int i = 0; i < 1000; ++i) {
+        loop.queueInLoop([&]() { count++; });
+      }
+      loop.queueInLoop([&]() { drained++; });
+      while (drained.load() == round) {
+        std::this_thread::yield();
+      }
+      if (round == 0) {
+        carved = own.slabPool().slabBytes();
+      }
+    }
+    carvedAfter = own.slabPool().slabBytes();
+    remote = own.slabPool().remoteReleases();
+    loop.queueInLoop([&]() { loop.quit(); });
+  });
+  loop.loop();
+  producer.join();
+
+  EXPECT_EQ(count, 10000);
+  EXPECT_GT(carved, 0u);
+  // Nodes went back to the producer's pool and were reused
+  EXPECT_EQ(carvedAfter, carved);
+  EXPECT_GE(remote, 9000u);
+}
+
+} // namespace test
+} // namespace hayai
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,151 @@
+#include "hayai/net/LengthFieldCodec.h"
+#include "hayai/net/EventLoop.h"
+#include "hayai/net/InetAddress.h"
+#include <chrono>
+#include <gtest/gtest.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace hayai {
+namespace test {
+
+class LengthFieldCodecTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+  void TearDown() override {}
+};
+
+TEST_F(LengthFieldCodecTest, DecodesEveryHeaderWidthByteByByte) {
+  for (size_t width : {1u, 2u, 4u, 8u}) {
+    LengthFieldCodec codec(width);
+    Buffer wire;
+    const std::vector<std::string> frames = {"", "a", std::string(200, 'b'),
+                                             "last"};
+    for (const auto &frame : frames) {
+      codec.encode(frame, &wire);
+    }
+
+    // Fed one byte at a time: a frame only shows once it is whole
+    Buffer in;
+    std::vector<std::string> decoded;
+    for (size_t i = 0; i < wire.readableBytes(); ++i) {
+      in.append(wire.peek() + i, 1);
+      std::string_view frame;
+      while (codec.peekFrame(in, &frame) == LengthFieldCodec::Status::Frame) {
+        decoded.emplace_back(frame);
+        // A view into the input buffer, not a copy
+        EXPECT_EQ(frame.data(), in.peek() + width);
+        in.retrieve(codec.frameBytes(frame));
+      }
+    }
+    EXPECT_EQ(decoded, frames) << "header width " << width;
+    EXPECT_EQ(in.readableBytes(), 0u);
+  }
+}
+
+TEST_F(LengthFieldCodecTest, EncodePrependsTheHeaderInPlace) {
+  LengthFieldCodec codec(4);
+  Buffer buf;
+  buf.append("hello");
+  const char *payload = buf.peek();
+
+  codec.encode(&buf);
+  EXPECT_EQ(buf.peek(), payload - 4);
+  EXPECT_EQ(std::string_view(buf.peek(), buf.readableBytes()),
+            std::string_view("\0\0\0\5hello", 9));
+
+  // A buffer without prepend space left still gets its header
+  LengthFieldCodec wide(8);
+  Buffer consumed;
+  consumed.append("zz");
+  consumed.prepend("12345678", 8); // prepend space used up
+  ASSERT_EQ(consumed.prependableBytes(), 0u);
+  wide.encode(&consumed);
+  EXPECT_EQ(consumed.readInt64(), 10);
+  EXPECT_EQ(consumed.retrieveAllAsString(), "12345678zz");
+}
+
+TEST_F(LengthFieldCodecTest, MaxFrameSizeRejectsLargeHeaders) {
+  LengthFieldCodec codec(4, 1000);
+  Buffer buf;
+  buf.appendInt32(1001);
+  std::string_view frame;
+  uint64_t length = 0;
+  EXPECT_EQ(codec.peekFrame(buf, &frame, &length),
+            LengthFieldCodec::Status::TooLarge);
+  EXPECT_EQ(length, 1001u);
+
+  // Capped by what the header can express
+  LengthFieldCodec narrow(2, 1 << 20);
+  EXPECT_EQ(narrow.maxFrameSize(), 65535u);
+  buf.retrieveAll();
+  buf.appendInt16(-1);
+  EXPECT_EQ(narrow.peekFrame(buf, &frame),
+            LengthFieldCodec::Status::Incomplete);
+}
+
+TEST_F(LengthFieldCodecTest, OnMessageDeliversFramesAndClosesOnOversize) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "codec", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  LengthFieldCodec codec(2, 4096);
+  std::vector<std::string> frames;
+  codec.setFrameCallback([&](const TcpConnectionPtr &, std::string_view f) {
+    frames.emplace_back(f);
+  });
+  conn->setMessageCallback([&codec](const TcpConnectionPtr &c, Buffer *buf) {
+    codec.onMessage(c, buf);
+  });
+  bool closed = false;
+  conn->setCloseCallback([&](const TcpConnectionPtr &) {
+    closed = true;
+    loop.quit();
+  });
+  conn->connectEstablished();
+
+  auto payload = [](int i) {
+    return std::string(i * 37, static_cast<char>('a' + i % 26));
+  };
+  Buffer wire;
+  for (int i = 0; i < 50; ++i) {
+    codec.encode(payload(i), &wire);
+  }
+  wire.appendInt16(5000); // over the limit: the connection is dropped
+
+  // Written in odd pieces, so frames straddle reads
+  loop.runAfter(std::chrono::milliseconds(0), [&] {
+    std::string_view bytes(wire.peek(), wire.readableBytes());
+    for (size_t off = 0; off < bytes.size(); off += 333) {
+      std::string_view piece = bytes.substr(off, 333);
+      loop.runAfter(std::chrono::milliseconds(off / 333), [&, piece] {
+        ASSERT_EQ(write(fds[1], piece.data(), piece.size()),
+                  static_cast<ssize_t>(piece.size()));
+      });
+    }
+  });
+  loop.runAfter(std::chrono::seconds(5), [&] { loop.quit(); });
+  loop.loop();
+
+  ASSERT_EQ(frames.size(), 50u);
+  for (int i = 0; i < 50; ++i) {
+    EXPECT_EQ(frames[i], payload(i));
+  }
+  EXPECT_TRUE(closed);
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+} // namespace test
+} // namespace hayai
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
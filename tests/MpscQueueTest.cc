@@ -0,0 +1,102 @@
+#include "hayai/utils/MpscQueue.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace hayai {
+namespace test {
+
+struct Item : MpscNode {
+    explicit Item(int v) : value(v) {}
+    int value;
+};
+
+class MpscQueueTest : public ::testing::Test {
+  protected:
+    void SetUp() override {}
+    void TearDown() override {}
+};
+
+TEST_F(MpscQueueTest, EmptyQueue) {
+    MpscQueue<Item> queue;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.pop(), nullptr);
+}
+
+TEST_F(MpscQueueTest, FifoOrder) {
+    MpscQueue<Item> queue;
+    Item items[5] = {Item(0), Item(1), Item(2), Item(3), Item(4)};
+    for (auto& item : items) {
+        queue.push(&item);
+    }
+    EXPECT_FALSE(queue.empty());
+
+    for (int i = 0; i < 5; ++i) {
+        Item* item = queue.pop();
+        ASSERT_NE(item, nullptr);
+        EXPECT_EQ(item->value, i);
+    }
+    EXPECT_EQ(queue.pop(), nullptr);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST_F(MpscQueueTest, ReuseAfterDrain) {
+    // The last element is detached by re-inserting the stub node
+    MpscQueue<Item> queue;
+    Item a(1);
+    Item b(2);
+
+    queue.push(&a);
+    EXPECT_EQ(queue.pop(), &a);
+    EXPECT_EQ(queue.pop(), nullptr);
+
+    queue.push(&b);
+    queue.push(&a);
+    EXPECT_EQ(queue.pop(), &b);
+    EXPECT_EQ(queue.pop(), &a);
+    EXPECT_EQ(queue.pop(), nullptr);
+}
+
+TEST_F(MpscQueueTest, MultipleProducers) {
+    constexpr int kProducers = 4;
+    constexpr int kPerProducer = 10000;
+
+    MpscQueue<Item> queue;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&queue, p] {
+            for (int i = 0; i < kPerProducer; ++i) {
+                queue.push(new Item(p * kPerProducer + i));
+            }
+        });
+    }
+
+    // Per-producer order must be preserved
+    std::vector<int> lastSeen(kProducers, -1);
+    int received = 0;
+    while (received < kProducers * kPerProducer) {
+        Item* item = queue.pop();
+        if (item == nullptr) {
+            std::this_thread::yield();
+            continue;
+        }
+        int producer = item->value / kPerProducer;
+        EXPECT_GT(item->value, lastSeen[producer]);
+        lastSeen[producer] = item->value;
+        delete item;
+        ++received;
+    }
+
+    for (auto& t : producers) {
+        t.join();
+    }
+    EXPECT_EQ(queue.pop(), nullptr);
+}
+
+} // namespace test
+} // namespace hayai
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
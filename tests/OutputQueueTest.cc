@@ -0,0 +1,252 @@
+#include "hayai/utils/OutputQueue.h"
+#include "hayai/utils/SharedSlice.h"
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace hayai {
+namespace test {
+
+class OutputQueueTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds_), 0);
+        ::fcntl(fds_[0], F_SETFL, O_NONBLOCK);
+        ::fcntl(fds_[1], F_SETFL, O_NONBLOCK);
+    }
+
+    void TearDown() override {
+        ::close(fds_[0]);
+        ::close(fds_[1]);
+    }
+
+    std::string drainPeer() {
+        std::string out;
+        char buf[65536];
+        ssize_t n;
+        while ((n = ::read(fds_[1], buf, sizeof(buf))) > 0) {
+            out.append(buf, n);
+        }
+        return out;
+    }
+
+    int fds_[2];
+};
+
+TEST_F(OutputQueueTest, EmptyQueue) {
+    OutputQueue queue;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.readableBytes(), 0u);
+    EXPECT_EQ(queue.segmentCount(), 0u);
+}
+
+TEST_F(OutputQueueTest, SmallCopiesShareOneBlock) {
+    OutputQueue queue;
+    for (int i = 0; i < 100; ++i) {
+        queue.append("hello ");
+    }
+    EXPECT_EQ(queue.readableBytes(), 600u);
+    EXPECT_EQ(queue.segmentCount(), 1u);
+
+    int savedErrno = 0;
+    EXPECT_EQ(queue.writeFd(fds_[0], &savedErrno), 600);
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(drainPeer().size(), 600u);
+}
+
+TEST_F(OutputQueueTest, HeaderAndSharedBodyInOneWritev) {
+    OutputQueue queue;
+    auto body = std::make_shared<const std::string>(8192, 'b');
+    std::weak_ptr<const std::string> watch = body;
+
+    queue.append("HEADER\r\n");
+    queue.appendShared(*body, body);
+    queue.append("\r\nTRAILER");
+    body.reset();
+    EXPECT_EQ(queue.segmentCount(), 3u);
+    EXPECT_FALSE(watch.expired()); // the queue holds a reference
+
+    int savedErrno = 0;
+    EXPECT_EQ(queue.writeFd(fds_[0], &savedErrno),
+              static_cast<ssize_t>(8 + 8192 + 9));
+    EXPECT_TRUE(watch.expired()); // released once written
+
+    std::string got = drainPeer();
+    EXPECT_EQ(got, "HEADER\r\n" + std::string(8192, 'b') + "\r\nTRAILER");
+}
+
+TEST_F(OutputQueueTest, SmallSharedPayloadIsCopied) {
+    OutputQueue queue;
+    auto small = std::make_shared<const std::string>("tiny");
+    std::weak_ptr<const std::string> watch = small;
+
+    queue.append("a");
+    queue.appendShared(*small, small);
+    small.reset();
+    EXPECT_TRUE(watch.expired());
+    EXPECT_EQ(queue.segmentCount(), 1u);
+}
+
+TEST_F(OutputQueueTest, BorrowedSegmentIsNotCopied) {
+    static const std::string kResponse(4096, 'r');
+    OutputQueue queue;
+    queue.appendBorrowed(kResponse);
+    queue.append("!");
+    EXPECT_EQ(queue.segmentCount(), 2u);
+
+    int savedErrno = 0;
+    EXPECT_EQ(queue.writeFd(fds_[0], &savedErrno), 4097);
+    EXPECT_EQ(drainPeer(), kResponse + "!");
+}
+
+TEST_F(OutputQueueTest, PartialWritesResumeMidSegment) {
+    OutputQueue queue;
+    auto body = std::make_shared<const std::string>(4 * 1024 * 1024, 'x');
+    queue.append("head");
+    queue.appendShared(*body, body);
+    queue.append("tail");
+    const size_t total = queue.readableBytes();
+
+    std::string got;
+    int savedErrno = 0;
+    while (!queue.empty()) {
+        ssize_t n = queue.writeFd(fds_[0], &savedErrno);
+        if (n < 0) {
+            ASSERT_EQ(savedErrno, EAGAIN);
+        }
+        got += drainPeer();
+    }
+    got += drainPeer();
+
+    ASSERT_EQ(got.size(), total);
+    EXPECT_EQ(got.substr(0, 4), "head");
+    EXPECT_EQ(got.substr(got.size() - 4), "tail");
+    EXPECT_EQ(got.find_first_not_of('x', 4), got.size() - 4);
+}
+
+TEST_F(OutputQueueTest, ManySegmentsAreCappedPerWritev) {
+    OutputQueue queue;
+    static const std::string kChunk(OutputQueue::kMinShareBytes, 'c');
+    constexpr int kSegments = 3000; // more than IOV_MAX
+    for (int i = 0; i < kSegments; ++i) {
+        queue.appendBorrowed(kChunk);
+    }
+    EXPECT_EQ(queue.segmentCount(), static_cast<size_t>(kSegments));
+
+    size_t sent = 0;
+    int savedErrno = 0;
+    while (!queue.empty()) {
+        ssize_t n = queue.writeFd(fds_[0], &savedErrno);
+        if (n > 0) {
+            sent += n;
+        }
+        drainPeer();
+    }
+    EXPECT_EQ(sent, kSegments * kChunk.size());
+}
+
+TEST_F(OutputQueueTest, RetrieveAllReleasesOwners) {
+    OutputQueue queue;
+    auto body = std::make_shared<const std::string>(2048, 'z');
+    std::weak_ptr<const std::string> watch = body;
+    std::string_view view(*body);
+    queue.appendShared(view, std::move(body));
+    queue.append("more");
+
+    queue.retrieveAll();
+    EXPECT_TRUE(queue.empty());
+    EXPECT_TRUE(watch.expired());
+}
+
+TEST_F(OutputQueueTest, FileSegmentKeepsStreamOrder) {
+    std::FILE* file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+    std::string content;
+    for (int i = 0; i < 20000; ++i) {
+        content += static_cast<char>('a' + i % 26);
+    }
+    ASSERT_EQ(::write(::fileno(file), content.data(), content.size()),
+              static_cast<ssize_t>(content.size()));
+
+    OutputQueue queue;
+    queue.append("HEAD|");
+    queue.appendFile(::fileno(file), 100, 10000);
+    queue.append("|TAIL");
+    EXPECT_EQ(queue.readableBytes(), 10010u);
+    EXPECT_EQ(queue.bufferedBytes(), 10u); // the file range isn't in memory
+
+    std::string out;
+    int savedErrno = 0;
+    while (!queue.empty()) {
+        ASSERT_GT(queue.writeFd(fds_[0], &savedErrno), 0);
+        out += drainPeer();
+    }
+    EXPECT_EQ(out, "HEAD|" + content.substr(100, 10000) + "|TAIL");
+    EXPECT_EQ(queue.consumedBytes(), 10010u);
+    EXPECT_EQ(queue.bufferedBytes(), 0u);
+    std::fclose(file);
+}
+
+TEST_F(OutputQueueTest, TruncatedFileFails) {
+    std::FILE* file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+    ASSERT_EQ(::write(::fileno(file), "short", 5), 5);
+
+    OutputQueue queue;
+    queue.appendFile(::fileno(file), 0, 100);
+
+    int savedErrno = 0;
+    EXPECT_EQ(queue.writeFd(fds_[0], &savedErrno), 5);
+    EXPECT_EQ(queue.writeFd(fds_[0], &savedErrno), -1);
+    EXPECT_EQ(savedErrno, EIO);
+    EXPECT_EQ(queue.readableBytes(), 95u);
+    std::fclose(file);
+}
+
+TEST_F(OutputQueueTest, SharedSliceCopiesViewOneBlock) {
+    const std::string payload(8192, 's');
+    SharedSlice slice = SharedSlice::copyOf(payload);
+    EXPECT_EQ(slice.view(), payload);
+    EXPECT_NE(slice.data(), payload.data());
+
+    SharedSlice copy = slice;
+    SharedSlice tail = slice.slice(8000);
+    EXPECT_EQ(copy.data(), slice.data());
+    EXPECT_EQ(tail.data(), slice.data() + 8000);
+    EXPECT_EQ(tail.size(), 192u);
+    EXPECT_EQ(slice.useCount(), 3);
+
+    // adopt() keeps the string's own bytes
+    std::string body(4096, 'b');
+    const char* bytes = body.data();
+    SharedSlice adopted = SharedSlice::adopt(std::move(body));
+    EXPECT_EQ(adopted.data(), bytes);
+    EXPECT_EQ(adopted.size(), 4096u);
+
+    EXPECT_TRUE(SharedSlice::copyOf("").empty());
+}
+
+TEST_F(OutputQueueTest, SharedSliceFreedAfterLastQueueFlushes) {
+    // The same slice queued on two "connections": held until both wrote it
+    SharedSlice slice = SharedSlice::copyOf(std::string(4096, 'f'));
+    OutputQueue first;
+    OutputQueue second;
+    first.appendShared(slice.view(), slice.owner());
+    second.appendShared(slice.view(), slice.owner());
+    EXPECT_EQ(slice.useCount(), 3);
+
+    int savedErrno = 0;
+    EXPECT_EQ(first.writeFd(fds_[0], &savedErrno), 4096);
+    EXPECT_EQ(slice.useCount(), 2);
+    EXPECT_EQ(second.writeFd(fds_[0], &savedErrno), 4096);
+    EXPECT_EQ(slice.useCount(), 1);
+    EXPECT_EQ(drainPeer(), std::string(8192, 'f'));
+}
+
+} // namespace test
+} // namespace hayai
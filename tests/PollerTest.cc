@@ -0,0 +1,352 @@
+#include "hayai/net/Poller.h"
+#include "hayai/net/Channel.h"
+#include "hayai/net/EventLoop.h"
+#include "hayai/net/InetAddress.h"
+#include "hayai/net/Socket.h"
+#include "hayai/net/TcpConnection.h"
+#include <chrono>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+
+namespace hayai {
+namespace test {
+
+// Parameter: value of HAYAI_USE_IO_URING ("" = unset, default backend)
+class PollerTest : public ::testing::TestWithParam<std::string> {
+  protected:
+    void SetUp() override {
+        if (GetParam().empty()) {
+            unsetenv("HAYAI_USE_IO_URING");
+        } else {
+            setenv("HAYAI_USE_IO_URING", GetParam().c_str(), 1);
+        }
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds_), 0);
+    }
+    void TearDown() override {
+        unsetenv("HAYAI_USE_IO_URING");
+        close(fds_[0]);
+        close(fds_[1]);
+    }
+
+    int fds_[2];
+};
+
+TEST_P(PollerTest, DefaultBackend) {
+    EventLoop loop;
+    auto poller = Poller::newDefaultPoller(&loop);
+    ASSERT_NE(poller, nullptr);
+#if defined(__linux__)
+    if (GetParam().empty()) {
+        EXPECT_STREQ(poller->backendName(), "epoll");
+    } else {
+        // io_uring when the kernel supports it, epoll otherwise
+        EXPECT_TRUE(std::string(poller->backendName()) == "io_uring" ||
+                    std::string(poller->backendName()) == "epoll");
+    }
+#else
+    EXPECT_STREQ(poller->backendName(), "kqueue");
+#endif
+}
+
+TEST_P(PollerTest, ReadableChannelIsReported) {
+    EventLoop loop;
+    Channel channel(&loop, fds_[0]);
+    bool readCalled = false;
+    channel.setReadCallback([&] {
+        readCalled = true;
+        loop.quit();
+    });
+    channel.enableReading();
+
+    ASSERT_EQ(write(fds_[1], "x", 1), 1);
+    loop.loop();
+    EXPECT_TRUE(readCalled);
+
+    channel.disableAll();
+    channel.remove();
+}
+
+TEST_P(PollerTest, UnreadDataIsReportedAgain) {
+    // Level-triggered contract: data left in the socket wakes us again
+    EventLoop loop;
+    Channel channel(&loop, fds_[0]);
+    int readCount = 0;
+    channel.setReadCallback([&] {
+        if (++readCount == 3) {
+            loop.quit();
+        }
+    });
+    channel.enableReading();
+
+    ASSERT_EQ(write(fds_[1], "x", 1), 1);
+    loop.loop();
+    EXPECT_EQ(readCount, 3);
+
+    channel.disableAll();
+    channel.remove();
+}
+
+TEST_P(PollerTest, WritableChannelIsReported) {
+    EventLoop loop;
+    Channel channel(&loop, fds_[0]);
+    int writeCount = 0;
+    channel.setWriteCallback([&] {
+        ++writeCount;
+        channel.disableWriting();
+        loop.quit();
+    });
+    channel.enableWriting();
+
+    loop.loop();
+    EXPECT_EQ(writeCount, 1);
+
+    channel.remove();
+}
+
+TEST_P(PollerTest, DisabledChannelIsNotReported) {
+    EventLoop loop;
+    Channel channel(&loop, fds_[0]);
+    bool readCalled = false;
+    channel.setReadCallback([&] { readCalled = true; });
+    channel.enableReading();
+    channel.disableReading();
+
+    // The peer end is always writable: use it to end the iteration
+    Channel peer(&loop, fds_[1]);
+    peer.setWriteCallback([&] { loop.quit(); });
+    peer.enableWriting();
+
+    ASSERT_EQ(write(fds_[1], "x", 1), 1);
+    loop.loop();
+    EXPECT_FALSE(readCalled);
+
+    peer.disableAll();
+    peer.remove();
+    channel.remove();
+}
+
+TEST_P(PollerTest, InterestChangesAreBatched) {
+    EventLoop loop;
+    Channel channel(&loop, fds_[0]);
+    channel.setReadCallback([&] { loop.quit(); });
+    channel.enableReading();
+
+    const Poller* poller = loop.poller();
+    const uint64_t syscallsBefore = poller->changeSyscalls();
+
+    // Write interest toggled back and forth within one iteration
+    for (int i = 0; i < 100; ++i) {
+        channel.enableWriting();
+        channel.disableWriting();
+    }
+
+    ASSERT_EQ(write(fds_[1], "x", 1), 1);
+    loop.loop();
+
+    // At most the initial registrations (ours and the loop's wakeup
+    // channel) reach the kernel
+    EXPECT_LE(poller->changeSyscalls() - syscallsBefore, 2u);
+    EXPECT_GE(poller->changeSyscallsAvoided(), 200u);
+
+    channel.disableAll();
+    channel.remove();
+}
+
+TEST_P(PollerTest, ChannelRemovedBeforeThePollCostsNoSyscall) {
+    EventLoop loop;
+    const Poller* poller = loop.poller();
+    const uint64_t syscallsBefore = poller->changeSyscalls();
+
+    // Its registration is still queued: nothing to undo in the kernel
+    Channel channel(&loop, fds_[0]);
+    channel.enableReading();
+    channel.enableWriting();
+    channel.disableAll();
+    channel.remove();
+    EXPECT_EQ(poller->changeSyscalls(), syscallsBefore);
+
+    // The fd is registered afresh and still works
+    Channel again(&loop, fds_[0]);
+    again.setReadCallback([&] { loop.quit(); });
+    again.enableReading();
+    ASSERT_EQ(write(fds_[1], "x", 1), 1);
+    loop.loop();
+
+    again.disableAll();
+    again.remove();
+}
+
+TEST_P(PollerTest, CompletionRecvAndSendDoTheIo) {
+    EventLoop loop;
+    Channel channel(&loop, fds_[0]);
+    if (!channel.completionIo()) {
+        GTEST_SKIP() << "readiness backend";
+    }
+
+    std::string received;
+    int sent = -1;
+    channel.setCompletionCallback([&](const Channel::Completion& c) {
+        if (c.op == Channel::Completion::Op::Recv) {
+            ASSERT_GT(c.res, 0);
+            received.append(c.data, c.res);
+        } else {
+            sent = c.res;
+        }
+        if (received == "ping" && sent >= 0) {
+            loop.quit();
+        }
+    });
+    // The read callback never runs: the poller reads
+    channel.setReadCallback([] { FAIL(); });
+    channel.setReadOp(Channel::ReadOp::Recv);
+    channel.enableReading();
+
+    char head[] = "po";
+    char tail[] = "ng";
+    struct iovec iov[2] = {{head, 2}, {tail, 2}};
+    channel.send(iov, 2);
+    ASSERT_EQ(write(fds_[1], "ping", 4), 4);
+    loop.loop();
+
+    EXPECT_EQ(sent, 4);
+    char buf[8];
+    ASSERT_EQ(read(fds_[1], buf, sizeof(buf)), 4);
+    EXPECT_EQ(std::string(buf, 4), "pong");
+
+    channel.disableAll();
+    channel.remove();
+}
+
+TEST_P(PollerTest, CompletionAcceptHandsOverTheConnection) {
+    EventLoop loop;
+    Socket listener(Socket::createTcpSocket());
+    listener.bind(InetAddress(0, true));
+    listener.listen();
+    Channel channel(&loop, listener.fd());
+    if (!channel.completionIo()) {
+        GTEST_SKIP() << "readiness backend";
+    }
+
+    sockaddr_in local{};
+    socklen_t len = sizeof(local);
+    ASSERT_EQ(getsockname(listener.fd(), reinterpret_cast<sockaddr*>(&local),
+                          &len),
+              0);
+
+    int accepted = -1;
+    int family = -1;
+    channel.setCompletionCallback([&](const Channel::Completion& c) {
+        ASSERT_EQ(c.op, Channel::Completion::Op::Accept);
+        accepted = c.res;
+        family = c.peer->sa_family;
+        loop.quit();
+    });
+    channel.setReadOp(Channel::ReadOp::Accept);
+    channel.enableReading();
+
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(client, 0);
+    ASSERT_EQ(connect(client, reinterpret_cast<sockaddr*>(&local), len), 0);
+    loop.loop();
+
+    ASSERT_GE(accepted, 0);
+    EXPECT_EQ(family, AF_INET);
+    ASSERT_EQ(write(client, "x", 1), 1);
+    char c;
+    EXPECT_EQ(read(accepted, &c, 1), 1);
+
+    close(accepted);
+    close(client);
+    channel.disableAll();
+    channel.remove();
+}
+
+TEST_P(PollerTest, SendInFlightKeepsItsOwnerPastRemoval) {
+    EventLoop loop;
+    auto channel = std::make_shared<Channel>(&loop, fds_[0]);
+    if (!channel->completionIo()) {
+        GTEST_SKIP() << "readiness backend";
+    }
+    channel->tie(channel);
+    channel->enableReading();
+
+    // The socket is full: the send stays in flight
+    const std::string filler(4096, 'f');
+    while (send(fds_[0], filler.data(), filler.size(), MSG_DONTWAIT) > 0) {
+    }
+    auto payload = std::make_shared<std::string>(4096, 's');
+    struct iovec iov = {payload->data(), payload->size()};
+    channel->send(&iov, 1);
+    loop.runAfter(std::chrono::milliseconds(20), [&] { loop.quit(); });
+    loop.loop();
+
+    std::weak_ptr<Channel> weak = channel;
+    channel->disableAll();
+    channel->remove();
+    channel.reset();
+    EXPECT_FALSE(weak.expired()); // the kernel may still read the bytes
+
+    // The cancelled send completes, and the poller lets go
+    loop.runAfter(std::chrono::milliseconds(20), [&] { loop.quit(); });
+    loop.loop();
+    EXPECT_TRUE(weak.expired());
+}
+
+TEST_P(PollerTest, ConnectionEchoesThroughCompletions) {
+    EventLoop loop;
+    auto conn = std::make_shared<TcpConnection>(
+        &loop, "echo", dup(fds_[0]), InetAddress(), InetAddress());
+    conn->setMessageCallback([](const TcpConnectionPtr& c, Buffer* buf) {
+        c->send(buf->retrieveAllAsString());
+    });
+    conn->setCloseCallback([&](const TcpConnectionPtr&) { loop.quit(); });
+    conn->connectEstablished();
+    const bool completion = loop.poller()->completionIo();
+
+    const std::string message(256 * 1024, 'e');
+    std::string echoed;
+    std::thread peer([&] {
+        size_t off = 0;
+        char buf[65536];
+        while (echoed.size() < message.size()) {
+            if (off < message.size()) {
+                ssize_t n = write(fds_[1], message.data() + off,
+                                  std::min<size_t>(4096, message.size() - off));
+                off += n > 0 ? n : 0;
+            }
+            ssize_t n = recv(fds_[1], buf, sizeof(buf), MSG_DONTWAIT);
+            if (n > 0) {
+                echoed.append(buf, n);
+            }
+        }
+        shutdown(fds_[1], SHUT_WR);
+    });
+    loop.loop();
+    peer.join();
+
+    EXPECT_EQ(echoed, message);
+    if (completion) {
+        // Bytes moved, yet no read() or write() of our own: the ring
+        // operations are all we count
+        EXPECT_EQ(conn->ioStats().bytesRead, message.size());
+        EXPECT_EQ(conn->ioStats().bytesWritten, message.size());
+    }
+    conn->connectDestroyed();
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, PollerTest,
+                         ::testing::Values(std::string(), std::string("1")));
+
+} // namespace test
+} // namespace hayai
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
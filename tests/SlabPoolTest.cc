@@ -0,0 +1,169 @@
+#include "hayai/utils/SlabPool.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace hayai {
+namespace test {
+
+class SlabPoolTest : public ::testing::Test {
+  protected:
+    void SetUp() override {}
+    void TearDown() override {}
+};
+
+TEST_F(SlabPoolTest, NoPoolFallsBackToHeap) {
+    ASSERT_EQ(SlabPool::current(), nullptr);
+    size_t size = 100;
+    void* p = SlabPool::allocate(size);
+    ASSERT_NE(p, nullptr);
+    EXPECT_EQ(size, 100u); // not rounded
+    std::memset(p, 0xab, size);
+    SlabPool::release(p);
+    SlabPool::release(nullptr);
+}
+
+TEST_F(SlabPoolTest, SizeClassesAndLocalReuse) {
+    SlabPool pool;
+    EXPECT_EQ(SlabPool::current(), &pool);
+
+    size_t size = 1;
+    void* small = SlabPool::allocate(size);
+    EXPECT_EQ(size, SlabPool::kMinBlock);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(small) % alignof(std::max_align_t),
+              0u);
+
+    size = 1032;
+    void* p = SlabPool::allocate(size);
+    EXPECT_EQ(size, 2048u);
+    std::memset(p, 0xcd, size);
+    SlabPool::release(p);
+
+    // The freed block is the next one handed out in its class
+    size = 1500;
+    EXPECT_EQ(SlabPool::allocate(size), p);
+    SlabPool::release(p);
+
+    size = SlabPool::kMaxBlock + 1;
+    void* big = SlabPool::allocate(size);
+    EXPECT_EQ(size, SlabPool::kMaxBlock + 1);
+    SlabPool::release(big);
+    SlabPool::release(small);
+
+    const size_t carved = pool.slabBytes();
+    for (int i = 0; i < 1000; ++i) {
+        size = 200;
+        SlabPool::release(SlabPool::allocate(size));
+    }
+    EXPECT_LE(pool.slabBytes(), carved + 64 * 1024);
+}
+
+TEST_F(SlabPoolTest, BlocksFreedElsewhereComeHome) {
+    SlabPool pool;
+    std::vector<void*> blocks;
+    for (int i = 0; i < 64; ++i) {
+        size_t size = 256;
+        blocks.push_back(SlabPool::allocate(size));
+    }
+
+    std::thread([&] {
+        for (void* p : blocks) {
+            SlabPool::release(p);
+        }
+    }).join();
+    EXPECT_EQ(pool.remoteReleases(), 0u); // taken back lazily
+
+    const size_t carved = pool.slabBytes();
+    for (void*& p : blocks) {
+        size_t size = 256;
+        p = SlabPool::allocate(size);
+    }
+    EXPECT_EQ(pool.remoteReleases(), blocks.size());
+    EXPECT_EQ(pool.slabBytes(), carved); // reused, nothing new carved
+    for (void* p : blocks) {
+        SlabPool::release(p);
+    }
+}
+
+TEST_F(SlabPoolTest, BlocksOutliveTheirPool) {
+    // Released after the pool is gone, on this thread and another; the
+    // last one frees the slabs (the ASan build reports a leak otherwise)
+    std::vector<void*> blocks;
+    {
+        SlabPool pool;
+        for (int i = 0; i < 8; ++i) {
+            size_t size = 512;
+            blocks.push_back(SlabPool::allocate(size));
+        }
+        std::thread([&] { SlabPool::release(blocks[0]); }).join();
+    }
+    EXPECT_EQ(SlabPool::current(), nullptr);
+
+    SlabPool::release(blocks[1]);
+    std::thread([&] {
+        for (size_t i = 2; i < blocks.size(); ++i) {
+            SlabPool::release(blocks[i]);
+        }
+    }).join();
+}
+
+TEST_F(SlabPoolTest, ConcurrentRemoteReleases) {
+    SlabPool pool;
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 2000;
+
+    std::vector<void*> blocks;
+    for (int i = 0; i < kThreads * kPerThread; ++i) {
+        size_t size = 64;
+        blocks.push_back(SlabPool::allocate(size));
+    }
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kPerThread; ++i) {
+                SlabPool::release(blocks[t * kPerThread + i]);
+            }
+        });
+    }
+    // Meanwhile the owner keeps allocating and draining
+    for (int i = 0; i < 1000; ++i) {
+        size_t size = 64;
+        SlabPool::release(SlabPool::allocate(size));
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    // Every block is back once the owner has allocated its way through
+    // its local free list
+    std::vector<void*> again;
+    while (pool.remoteReleases() < blocks.size() &&
+           again.size() < 2 * blocks.size()) {
+        size_t size = 64;
+        again.push_back(SlabPool::allocate(size));
+    }
+    EXPECT_EQ(pool.remoteReleases(), blocks.size());
+    for (void* p : again) {
+        SlabPool::release(p);
+    }
+}
+
+TEST_F(SlabPoolTest, AllocateSharedRoundTrip) {
+    SlabPool pool;
+    auto value = std::allocate_shared<std::vector<int>>(
+        SlabAllocator<std::vector<int>>(), 3, 7);
+    EXPECT_EQ(value->size(), 3u);
+    std::thread([v = std::move(value)]() mutable { v.reset(); }).join();
+
+    size_t size = 1;
+    SlabPool::release(SlabPool::allocate(size));
+    EXPECT_EQ(pool.remoteReleases(), 1u);
+}
+
+} // namespace test
+} // namespace hayai
@@ -0,0 +1,121 @@
+#include "hayai/utils/SmallFunction.h"
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <gtest/gtest.h>
+#include <memory>
+#include <new>
+#include <string>
+
+namespace {
+std::atomic<size_t> g_allocations{0};
+} // namespace
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace hayai {
+namespace test {
+
+class SmallFunctionTest : public ::testing::Test {
+  protected:
+    void SetUp() override {}
+    void TearDown() override {}
+};
+
+TEST_F(SmallFunctionTest, EmptyByDefault) {
+    SmallFunction<void()> fn;
+    EXPECT_FALSE(fn);
+    EXPECT_FALSE(fn.isInline());
+
+    SmallFunction<void()> fromNull(nullptr);
+    EXPECT_FALSE(fromNull);
+}
+
+TEST_F(SmallFunctionTest, InvokesWithArguments) {
+    SmallFunction<int(int, const std::string&)> fn =
+        [](int a, const std::string& s) { return a + static_cast<int>(s.size()); };
+    ASSERT_TRUE(fn);
+    EXPECT_EQ(fn(1, "abc"), 4);
+}
+
+TEST_F(SmallFunctionTest, SmallCaptureDoesNotAllocate) {
+    int counter = 0;
+    std::shared_ptr<int> guard; // shared_ptr capture, as in TcpConnection
+
+    size_t before = g_allocations.load();
+    SmallFunction<void()> fn = [&counter, guard] { ++counter; };
+    SmallFunction<void()> moved = std::move(fn);
+    moved();
+    EXPECT_EQ(g_allocations.load(), before);
+
+    EXPECT_TRUE(moved.isInline());
+    EXPECT_FALSE(fn); // NOLINT(bugprone-use-after-move)
+    EXPECT_EQ(counter, 1);
+}
+
+TEST_F(SmallFunctionTest, StringCaptureStaysInline) {
+    // Mirrors TcpConnection::send's cross-thread lambda
+    std::string message = "short";
+    std::string out;
+    SmallFunction<void()> fn = [&out, msg = std::move(message)] { out = msg; };
+    EXPECT_TRUE(fn.isInline());
+    fn();
+    EXPECT_EQ(out, "short");
+}
+
+TEST_F(SmallFunctionTest, LargeCaptureFallsBackToHeap) {
+    std::array<char, 256> big{};
+    big[0] = 'x';
+    char seen = 0;
+
+    SmallFunction<void()> fn = [big, &seen] { seen = big[0]; };
+    EXPECT_TRUE(fn);
+    EXPECT_FALSE(fn.isInline());
+
+    SmallFunction<void()> moved = std::move(fn);
+    moved();
+    EXPECT_EQ(seen, 'x');
+}
+
+TEST_F(SmallFunctionTest, MoveOnlyCallable) {
+    auto value = std::make_unique<int>(42);
+    SmallFunction<int()> fn = [v = std::move(value)] { return *v; };
+    EXPECT_EQ(fn(), 42);
+}
+
+TEST_F(SmallFunctionTest, EmptyStdFunctionStaysEmpty) {
+    std::function<void(int)> empty;
+    SmallFunction<void(int)> fn(empty);
+    EXPECT_FALSE(fn);
+
+    std::function<void(int)> set = [](int) {};
+    SmallFunction<void(int)> wrapped(set);
+    EXPECT_TRUE(wrapped);
+    EXPECT_TRUE(wrapped.isInline());
+}
+
+TEST_F(SmallFunctionTest, DestroysTarget) {
+    auto tracked = std::make_shared<int>(0);
+    {
+        SmallFunction<void()> fn = [tracked] {};
+        EXPECT_EQ(tracked.use_count(), 2);
+        fn = nullptr;
+        EXPECT_EQ(tracked.use_count(), 1);
+        fn = [tracked] {};
+        EXPECT_EQ(tracked.use_count(), 2);
+    }
+    EXPECT_EQ(tracked.use_count(), 1);
+}
+
+} // namespace test
+} // namespace hayai
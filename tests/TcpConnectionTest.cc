@@ -1,19 +1,42 @@
 #include "hayai/net/TcpConnection.h"
 #include "hayai/net/EventLoop.h"
 #include "hayai/net/InetAddress.h"
+#include "hayai/net/Poller.h"
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
 #include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <string>
 #include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 namespace hayai {
 namespace test {
 
-class TcpConnectionTest : public ::testing::Test {
+// Parameter: value of HAYAI_USE_IO_URING ("" = unset, default backend)
+class TcpConnectionTest : public ::testing::TestWithParam<std::string> {
 protected:
-  void SetUp() override {}
-  void TearDown() override {}
+  void SetUp() override {
+    if (GetParam().empty()) {
+      unsetenv("HAYAI_USE_IO_URING");
+    } else {
+      setenv("HAYAI_USE_IO_URING", GetParam().c_str(), 1);
+    }
+  }
+  void TearDown() override { unsetenv("HAYAI_USE_IO_URING"); }
+
+  // The poller sends and receives: writes are batched per iteration
+  static bool completionIo(const EventLoop &loop) {
+    return loop.poller()->completionIo();
+  }
 };
 
-TEST_F(TcpConnectionTest, Construction) {
+TEST_P(TcpConnectionTest, Construction) {
   // Test basic construction and initial state
   EventLoop loop;
   int fds[2];
@@ -35,7 +58,7 @@ TEST_F(TcpConnectionTest, Construction) {
   conn->connectDestroyed();
 }
 
-TEST_F(TcpConnectionTest, AddressGetters) {
+TEST_P(TcpConnectionTest, AddressGetters) {
   // Test address getters
   EventLoop loop;
   int fds[2];
@@ -55,7 +78,7 @@ TEST_F(TcpConnectionTest, AddressGetters) {
   conn->connectDestroyed();
 }
 
-TEST_F(TcpConnectionTest, CallbackSetters) {
+TEST_P(TcpConnectionTest, CallbackSetters) {
   // Test that callbacks can be set without invoking them
   EventLoop loop;
   int fds[2];
@@ -77,7 +100,7 @@ TEST_F(TcpConnectionTest, CallbackSetters) {
   conn->connectDestroyed();
 }
 
-TEST_F(TcpConnectionTest, SendBeforeConnected) {
+TEST_P(TcpConnectionTest, SendBeforeConnected) {
   // Test that send() before connected doesn't crash
   EventLoop loop;
   int fds[2];
@@ -98,7 +121,7 @@ TEST_F(TcpConnectionTest, SendBeforeConnected) {
   conn->connectDestroyed();
 }
 
-TEST_F(TcpConnectionTest, SharedPtrLifetime) {
+TEST_P(TcpConnectionTest, SharedPtrLifetime) {
   // Test that shared_ptr lifetime management works
   EventLoop loop;
   int fds[2];
@@ -124,6 +147,1051 @@ TEST_F(TcpConnectionTest, SharedPtrLifetime) {
   close(fds[1]);
 }
 
+TEST_P(TcpConnectionTest, EdgeTriggeredDrainsWithBudget) {
+  // Edge-triggered mode must deliver everything even though only one
+  // readiness edge fires per burst, and respect the per-wakeup budget
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  constexpr size_t kBudget = 16 * 1024;
+  const std::string payload(100 * 1024, 'e');
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "conn6", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  conn->setEdgeTriggered(true, kBudget);
+  EXPECT_TRUE(conn->edgeTriggered());
+
+  size_t received = 0;
+  int callbacks = 0;
+  conn->setMessageCallback([&](const TcpConnectionPtr &, Buffer *buf) {
+    ++callbacks;
+    received += buf->readableBytes();
+    buf->retrieveAll();
+    if (received == payload.size()) {
+      loop.quit();
+    }
+  });
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+
+  std::thread writer([&] {
+    size_t sent = 0;
+    while (sent < payload.size()) {
+      ssize_t n = write(fds[1], payload.data() + sent, payload.size() - sent);
+      if (n > 0) {
+        sent += n;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  loop.loop();
+  writer.join();
+
+  EXPECT_EQ(received, payload.size());
+  EXPECT_EQ(conn->ioStats().bytesRead, payload.size());
+  // The budget stops a wakeup from swallowing the whole burst
+  EXPECT_GE(callbacks, 2);
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+TEST_P(TcpConnectionTest, EdgeTriggeredSendDrainsOutputBuffer) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "conn7", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  conn->setEdgeTriggered(true, 8 * 1024);
+  conn->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+
+  // Larger than the socket buffer: the rest goes to outputQueue_
+  const std::string payload(1024 * 1024, 's');
+  conn->send(payload);
+
+  size_t received = 0;
+  std::thread reader([&] {
+    char buf[65536];
+    while (received < payload.size()) {
+      ssize_t n = read(fds[1], buf, sizeof(buf));
+      if (n > 0) {
+        received += n;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    loop.quit();
+  });
+
+  loop.loop();
+  reader.join();
+
+  EXPECT_EQ(received, payload.size());
+  EXPECT_EQ(conn->ioStats().bytesWritten, payload.size());
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+TEST_P(TcpConnectionTest, SharedBodyIsQueuedByReference) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "conn8", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  conn->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+
+  auto body = std::make_shared<const std::string>(1024 * 1024, 'b');
+  std::weak_ptr<const std::string> watch = body;
+  conn->send("HTTP/1.1 200 OK\r\n\r\n");
+  conn->send(std::move(body));
+  conn->sendBorrowed("!");
+  // Part of the body is still queued and owned by the connection
+  EXPECT_FALSE(watch.expired());
+
+  const size_t expected = 19 + 1024 * 1024 + 1;
+  std::string received;
+  std::thread reader([&] {
+    char buf[65536];
+    while (received.size() < expected) {
+      ssize_t n = read(fds[1], buf, sizeof(buf));
+      if (n > 0) {
+        received.append(buf, n);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    loop.quit();
+  });
+
+  loop.loop();
+  reader.join();
+
+  ASSERT_EQ(received.size(), expected);
+  EXPECT_EQ(received.substr(0, 19), "HTTP/1.1 200 OK\r\n\r\n");
+  EXPECT_EQ(received.back(), '!');
+  EXPECT_TRUE(watch.expired());
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+TEST_P(TcpConnectionTest, MovedSendFromAnotherThread) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "conn9", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  conn->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+
+  // Built on a "worker" and moved to the loop, larger than the socket
+  // buffer so most of it is queued
+  const size_t kSize = 1024 * 1024;
+  std::thread worker([&] {
+    std::string str(kSize, 's');
+    conn->send(std::move(str));
+    Buffer buf;
+    buf.append(std::string(kSize, 'b'));
+    conn->send(std::move(buf));
+  });
+
+  std::string received;
+  std::thread reader([&] {
+    char buf[65536];
+    while (received.size() < 2 * kSize) {
+      ssize_t n = read(fds[1], buf, sizeof(buf));
+      if (n > 0) {
+        received.append(buf, n);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    loop.quit();
+  });
+
+  loop.loop();
+  worker.join();
+  reader.join();
+
+  ASSERT_EQ(received.size(), 2 * kSize);
+  EXPECT_EQ(received.find_first_not_of('s'), kSize);
+  EXPECT_EQ(received.find_first_not_of('b', kSize), std::string::npos);
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+TEST_P(TcpConnectionTest, CorkedSendsShareOneWrite) {
+  for (bool corked : {false, true}) {
+    EventLoop loop;
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+    auto conn = std::make_shared<TcpConnection>(&loop, "cork", fds[0],
+                                                InetAddress(8080),
+                                                InetAddress(9090));
+    conn->setCorked(corked);
+    conn->setMessageCallback([&](const TcpConnectionPtr &c, Buffer *buf) {
+      buf->retrieveAll();
+      c->send("HEADER|");
+      c->send("BODY|");
+      c->send("TRAILER");
+      c->shutdown(); // must not overtake the corked bytes
+      loop.queueInLoop([&] { loop.quit(); });
+    });
+    conn->setCloseCallback([](const TcpConnectionPtr &) {});
+    conn->connectEstablished();
+
+    ASSERT_EQ(write(fds[1], "req", 3), 3);
+    loop.loop();
+
+    char buf[64];
+    ssize_t n = read(fds[1], buf, sizeof(buf));
+    ASSERT_GT(n, 0);
+    EXPECT_EQ(std::string(buf, n), "HEADER|BODY|TRAILER");
+    EXPECT_EQ(read(fds[1], buf, sizeof(buf)), 0); // FIN after the data
+    // Completion I/O batches every iteration's sends
+    EXPECT_EQ(conn->ioStats().writeCalls,
+              corked || completionIo(loop) ? 1u : 3u);
+
+    close(fds[1]);
+    conn->connectDestroyed();
+  }
+}
+
+TEST_P(TcpConnectionTest, IdleTimeoutClosesQuietConnections) {
+  EventLoop loop;
+  constexpr int kConns = 3;
+  int peers[kConns];
+  std::vector<TcpConnectionPtr> conns;
+  int closed = 0;
+
+  for (int i = 0; i < kConns; ++i) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    peers[i] = fds[1];
+    auto conn = std::make_shared<TcpConnection>(
+        &loop, "idle" + std::to_string(i), fds[0], InetAddress(8080),
+        InetAddress(9090));
+    conn->setIdleTimeout(std::chrono::milliseconds(30));
+    conn->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+    conn->setCloseCallback([&](const TcpConnectionPtr &c) {
+      EXPECT_TRUE(c->reapedIdle());
+      if (++closed == kConns) {
+        loop.quit();
+      }
+    });
+    conn->connectEstablished();
+    conns.push_back(conn);
+  }
+
+  auto start = EventLoop::Clock::now();
+  loop.loop();
+
+  EXPECT_EQ(closed, kConns);
+  EXPECT_GE(EventLoop::Clock::now() - start, std::chrono::milliseconds(30));
+  EXPECT_EQ(loop.timerCount(), 0u);
+
+  for (int i = 0; i < kConns; ++i) {
+    EXPECT_FALSE(conns[i]->connected());
+    close(peers[i]);
+    conns[i]->connectDestroyed();
+  }
+}
+
+TEST_P(TcpConnectionTest, IdleTimeoutRefreshedByActivity) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "idle", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  conn->setIdleTimeout(std::chrono::milliseconds(50));
+  conn->setMessageCallback(
+      [](const TcpConnectionPtr &, Buffer *buf) { buf->retrieveAll(); });
+
+  EventLoop::Clock::time_point lastWrite;
+  EventLoop::Clock::time_point closedAt;
+  conn->setCloseCallback([&](const TcpConnectionPtr &) {
+    closedAt = EventLoop::Clock::now();
+    loop.quit();
+  });
+  conn->connectEstablished();
+
+  // Keep the peer chatty for well over one timeout, then go quiet
+  int writes = 0;
+  TimerId chatter;
+  chatter = loop.runEvery(std::chrono::milliseconds(10), [&] {
+    ASSERT_EQ(write(fds[1], "x", 1), 1);
+    lastWrite = EventLoop::Clock::now();
+    if (++writes == 15) {
+      loop.cancel(chatter);
+    }
+  });
+
+  loop.loop();
+
+  EXPECT_EQ(writes, 15);
+  EXPECT_TRUE(conn->reapedIdle());
+  EXPECT_GE(closedAt - lastWrite, std::chrono::milliseconds(40));
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+TEST_P(TcpConnectionTest, HighWaterMarkThrottlesReads) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "hwm", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  constexpr size_t kHigh = 256 * 1024;
+  constexpr size_t kLow = 64 * 1024;
+  constexpr size_t kBody = 4 * 1024 * 1024;
+  conn->setWaterMarks(kHigh, kLow);
+  conn->setThrottleReads(true);
+
+  int messages = 0;
+  size_t reportedBytes = 0;
+  int lowWaterCalls = 0;
+  conn->setMessageCallback([&](const TcpConnectionPtr &c, Buffer *buf) {
+    buf->retrieveAll();
+    if (++messages == 1) {
+      c->send(std::string(kBody, 'x')); // the peer is not reading yet
+    } else {
+      loop.quit();
+    }
+  });
+  conn->setHighWaterMarkCallback([&](const TcpConnectionPtr &c, size_t n) {
+    reportedBytes = n;
+    EXPECT_TRUE(c->aboveHighWater());
+    // Input arriving now must wait until the output drains
+    ASSERT_EQ(write(fds[1], "more", 4), 4);
+  });
+  conn->setLowWaterMarkCallback([&](const TcpConnectionPtr &c) {
+    ++lowWaterCalls;
+    EXPECT_FALSE(c->aboveHighWater());
+    EXPECT_EQ(messages, 1);
+  });
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+
+  ASSERT_EQ(write(fds[1], "req", 3), 3);
+
+  // Slow reader: start draining only after the throttle kicked in
+  size_t drained = 0;
+  loop.runEvery(std::chrono::milliseconds(5), [&] {
+    char buf[64 * 1024];
+    ssize_t n;
+    while (reportedBytes > 0 && (n = read(fds[1], buf, sizeof(buf))) > 0) {
+      drained += n;
+    }
+  });
+  loop.loop();
+
+  EXPECT_GE(reportedBytes, kHigh);
+  EXPECT_EQ(lowWaterCalls, 1);
+  EXPECT_EQ(messages, 2);
+  EXPECT_GT(drained, 0u);
+  EXPECT_LE(conn->outputBytes(), kLow);
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+TEST_P(TcpConnectionTest, HighWaterMarkThrottlesUpstream) {
+  EventLoop loop;
+  int down[2];
+  int up[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, down), 0);
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, up), 0);
+
+  // Proxy shape: whatever arrives upstream is relayed downstream
+  auto downstream = std::make_shared<TcpConnection>(
+      &loop, "down", down[0], InetAddress(8080), InetAddress(9090));
+  auto upstream = std::make_shared<TcpConnection>(
+      &loop, "up", up[0], InetAddress(8081), InetAddress(9091));
+  downstream->setWaterMarks(128 * 1024, 0);
+  downstream->setThrottleUpstream(upstream);
+
+  size_t relayed = 0;
+  upstream->setMessageCallback([&](const TcpConnectionPtr &, Buffer *buf) {
+    relayed += buf->readableBytes();
+    downstream->send(buf->retrieveAllAsString());
+  });
+  downstream->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+  for (auto *c : {&upstream, &downstream}) {
+    (*c)->setCloseCallback([](const TcpConnectionPtr &) {});
+    (*c)->connectEstablished();
+  }
+
+  // Upstream floods, downstream never reads: relaying must stall once the
+  // mark is crossed instead of buffering everything
+  std::string chunk(64 * 1024, 'u');
+  size_t offered = 0;
+  bool stopping = false;
+  loop.runEvery(std::chrono::milliseconds(2), [&] {
+    ssize_t n;
+    while ((n = write(up[1], chunk.data(), chunk.size())) > 0) {
+      offered += n;
+    }
+    if (!stopping && (offered > 8 * 1024 * 1024 ||
+                      downstream->aboveHighWater())) {
+      stopping = true;
+      loop.runAfter(std::chrono::milliseconds(50), [&] { loop.quit(); });
+    }
+  });
+  loop.loop();
+
+  EXPECT_TRUE(downstream->aboveHighWater());
+  EXPECT_LE(offered, 8 * 1024 * 1024u); // the flood stalled on its own
+  EXPECT_LT(downstream->outputBytes(), 1024 * 1024u);
+  EXPECT_LE(relayed, offered);
+
+  close(down[1]);
+  close(up[1]);
+  downstream->connectDestroyed();
+  upstream->connectDestroyed();
+}
+
+TEST_P(TcpConnectionTest, WriteCompleteFiresWhenOutputDrains) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "wc", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  // Completion I/O: the large send queues behind the first, still in
+  // flight, and the output drains once
+  const int expected = completionIo(loop) ? 1 : 2;
+  int completions = 0;
+  conn->setWriteCompleteCallback([&](const TcpConnectionPtr &c) {
+    if (++completions == expected) {
+      EXPECT_EQ(c->outputBytes(), 0u);
+      loop.quit();
+    }
+  });
+  conn->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+
+  conn->send("direct"); // written (or submitted) inside send(): no callback yet
+  EXPECT_EQ(completions, 0);
+
+  const size_t kBytes = 4 * 1024 * 1024;
+  conn->send(std::string(kBytes, 'w'));
+
+  size_t received = 0;
+  std::thread reader([&] {
+    char buf[65536];
+    while (received < kBytes + 6) {
+      ssize_t n = read(fds[1], buf, sizeof(buf));
+      if (n > 0) {
+        received += n;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  loop.loop();
+  reader.join();
+
+  EXPECT_EQ(completions, expected);
+  EXPECT_EQ(conn->ioStats().bytesWritten, kBytes + 6);
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+TEST_P(TcpConnectionTest, SendFileInterleavesWithQueuedData) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  // Larger than the socket buffer, so the file waits behind queued bytes
+  std::FILE *file = std::tmpfile();
+  ASSERT_NE(file, nullptr);
+  std::string content(2 * 1024 * 1024, 'f');
+  for (size_t i = 0; i < content.size(); i += 4096) {
+    content[i] = static_cast<char>('0' + (i / 4096) % 10);
+  }
+  ASSERT_EQ(write(fileno(file), content.data(), content.size()),
+            static_cast<ssize_t>(content.size()));
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "file", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  conn->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+
+  const std::string header(1024 * 1024, 'h');
+  std::vector<bool> results;
+  conn->send(std::string(header));
+  conn->sendFile(fileno(file), 0, content.size(),
+                 [&](const TcpConnectionPtr &, bool sent) {
+                   results.push_back(sent);
+                 });
+  conn->send("TRAILER");
+  conn->sendFile(fileno(file), 0, 0, [&](const TcpConnectionPtr &, bool sent) {
+    results.push_back(sent); // empty range: completes after the trailer
+    loop.quit();
+  });
+
+  std::string received;
+  const size_t expected = header.size() + content.size() + 7;
+  std::thread reader([&] {
+    char buf[65536];
+    while (received.size() < expected) {
+      ssize_t n = read(fds[1], buf, sizeof(buf));
+      if (n > 0) {
+        received.append(buf, n);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  loop.loop();
+  reader.join();
+
+  EXPECT_EQ(results, (std::vector<bool>{true, true}));
+  ASSERT_EQ(received.size(), expected);
+  EXPECT_TRUE(received == header + content + "TRAILER");
+
+  close(fds[1]);
+  conn->connectDestroyed();
+  std::fclose(file);
+}
+
+TEST_P(TcpConnectionTest, SendFileReportsCloseBeforeCompletion) {
+  std::signal(SIGPIPE, SIG_IGN); // as any server does; the peer hangs up
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  std::FILE *file = std::tmpfile();
+  ASSERT_NE(file, nullptr);
+  std::string content(4 * 1024 * 1024, 'x');
+  ASSERT_EQ(write(fileno(file), content.data(), content.size()),
+            static_cast<ssize_t>(content.size()));
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "file", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  conn->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+
+  int calls = 0;
+  bool result = true;
+  conn->sendFile(fileno(file), 0, content.size(),
+                 [&](const TcpConnectionPtr &, bool sent) {
+                   ++calls;
+                   result = sent;
+                   loop.quit();
+                 });
+  close(fds[1]); // the peer goes away without reading
+  loop.loop();
+
+  EXPECT_EQ(calls, 1);
+  EXPECT_FALSE(result);
+  EXPECT_FALSE(conn->connected());
+
+  conn->connectDestroyed();
+  std::fclose(file);
+}
+
+// Connected TCP pair over loopback (MSG_ZEROCOPY needs a real TCP socket)
+static bool tcpPair(int fds[2]) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (listener < 0 ||
+      bind(listener, reinterpret_cast<sockaddr *>(&addr), len) < 0 ||
+      listen(listener, 1) < 0 ||
+      getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len) < 0) {
+    return false;
+  }
+  fds[1] = socket(AF_INET, SOCK_STREAM, 0);
+  bool ok = connect(fds[1], reinterpret_cast<sockaddr *>(&addr), len) == 0 &&
+            (fds[0] = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK)) >= 0;
+  close(listener);
+  return ok;
+}
+
+TEST_P(TcpConnectionTest, ZeroCopyUnsupportedFallsBackToCopy) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "zc", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  EXPECT_FALSE(conn->setZeroCopy(true)); // not a TCP socket
+  conn->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+
+  conn->send(std::make_shared<const std::string>(64 * 1024, 'u'));
+  EXPECT_EQ(conn->zeroCopyPending(), 0u);
+
+  char buf[65536];
+  size_t received = 0;
+  ssize_t n;
+  while ((n = read(fds[1], buf, sizeof(buf))) > 0) {
+    received += n;
+  }
+  EXPECT_EQ(received, 64 * 1024u);
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+TEST_P(TcpConnectionTest, ZeroCopyPinsPayloadUntilCompletion) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_TRUE(tcpPair(fds));
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "zc", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  if (!conn->setZeroCopy(true)) {
+    close(fds[1]);
+    conn->connectDestroyed();
+    GTEST_SKIP() << "SO_ZEROCOPY not supported here";
+  }
+  conn->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+
+  constexpr size_t kBytes = 4 * 1024 * 1024;
+  auto body = std::make_shared<const std::string>(kBytes, 'z');
+  std::weak_ptr<const std::string> watch = body;
+  conn->send(std::move(body));
+  conn->send("|small"); // below the threshold: copied, ordered after
+
+  std::atomic<size_t> received{0};
+  std::string tail;
+  std::thread reader([&] {
+    char buf[65536];
+    while (received < kBytes + 6) {
+      ssize_t n = read(fds[1], buf, sizeof(buf));
+      if (n > 0) {
+        received += n;
+        tail.assign(buf, n);
+      }
+    }
+  });
+
+  // Consumed from the queue is not enough: the payload stays pinned
+  // until the kernel reports completion
+  loop.runEvery(std::chrono::milliseconds(1), [&] {
+    if (conn->zeroCopyPending() > 0) {
+      EXPECT_FALSE(watch.expired());
+    }
+    if (conn->outputBytes() == 0 && conn->zeroCopyPending() == 0 &&
+        received == kBytes + 6) {
+      loop.quit();
+    }
+  });
+  loop.loop();
+  reader.join();
+
+  EXPECT_TRUE(watch.expired());
+  EXPECT_GT(conn->ioStats().zeroCopyCompleted, 0u);
+  EXPECT_EQ(tail.substr(tail.size() - 6), "|small");
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+TEST_P(TcpConnectionTest, ZeroCopyOwnersOutliveTheConnection) {
+  EventLoop loop;
+  int fds[2];
+  ASSERT_TRUE(tcpPair(fds));
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "zc", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  if (!conn->setZeroCopy(true)) {
+    close(fds[1]);
+    conn->connectDestroyed();
+    GTEST_SKIP() << "SO_ZEROCOPY not supported here";
+  }
+  conn->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+
+  // The peer reads nothing yet: the kernel still holds the pages
+  auto body = std::make_shared<const std::string>(4 * 1024 * 1024, 'z');
+  std::weak_ptr<const std::string> watch = body;
+  conn->send(std::move(body));
+  ASSERT_GT(conn->zeroCopyPending(), 0u);
+
+  conn->connectDestroyed();
+  conn.reset();
+  EXPECT_FALSE(watch.expired());
+  EXPECT_EQ(loop.parkedZeroCopy(), 1u);
+
+  std::thread reader([&] {
+    char buf[65536];
+    while (read(fds[1], buf, sizeof(buf)) > 0) {
+    }
+  });
+  loop.runEvery(std::chrono::milliseconds(1), [&] {
+    if (loop.parkedZeroCopy() == 0) {
+      loop.quit();
+    }
+  });
+  loop.runAfter(std::chrono::seconds(10), [&] { loop.quit(); });
+  loop.loop();
+  reader.join(); // EOF: the parked descriptor was shut down
+
+  EXPECT_TRUE(watch.expired());
+  EXPECT_EQ(loop.parkedZeroCopy(), 0u);
+  close(fds[1]);
+}
+
+TEST_P(TcpConnectionTest, RelayMovesBytesBothWaysAndPassesEof) {
+  EventLoop loop;
+  int left[2];
+  int right[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, left), 0);
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, right), 0);
+
+  auto a = std::make_shared<TcpConnection>(&loop, "a", left[0],
+                                           InetAddress(8080),
+                                           InetAddress(9090));
+  auto b = std::make_shared<TcpConnection>(&loop, "b", right[0],
+                                           InetAddress(8081),
+                                           InetAddress(9091));
+  int messages = 0;
+  int closes = 0;
+  for (auto *c : {&a, &b}) {
+    (*c)->setMessageCallback(
+        [&](const TcpConnectionPtr &, Buffer *) { ++messages; });
+    // As TcpServer does: destroyed after the close callback
+    (*c)->setCloseCallback([&](const TcpConnectionPtr &conn) {
+      ++closes;
+      loop.queueInLoop([conn] { conn->connectDestroyed(); });
+    });
+    (*c)->connectEstablished();
+  }
+  if (!a->relayTo(b)) {
+    close(left[1]);
+    close(right[1]);
+    a->connectDestroyed();
+    b->connectDestroyed();
+    GTEST_SKIP() << "splice() relay not supported here";
+  }
+  ASSERT_TRUE(b->relayTo(a));
+
+  ASSERT_EQ(write(left[1], "ping", 4), 4);
+  ASSERT_EQ(write(right[1], "pong", 4), 4);
+  ASSERT_EQ(shutdown(left[1], SHUT_WR), 0);
+
+  std::string atRight;
+  std::string atLeft;
+  bool rightEof = false;
+  bool leftEof = false;
+  loop.runEvery(std::chrono::milliseconds(1), [&] {
+    char buf[64];
+    ssize_t n;
+    while ((n = read(right[1], buf, sizeof(buf))) > 0) {
+      atRight.append(buf, n);
+    }
+    if (n == 0 && !rightEof) {
+      rightEof = true;
+      EXPECT_FALSE(b->connected()); // half-closed towards the right
+      EXPECT_EQ(closes, 0);         // still relaying right -> left
+      ASSERT_EQ(shutdown(right[1], SHUT_WR), 0);
+    }
+    while ((n = read(left[1], buf, sizeof(buf))) > 0) {
+      atLeft.append(buf, n);
+    }
+    leftEof = leftEof || n == 0;
+    if (leftEof && closes == 2) {
+      loop.quit();
+    }
+  });
+  loop.runAfter(std::chrono::seconds(5), [&] { loop.quit(); });
+  loop.loop();
+
+  EXPECT_EQ(atRight, "ping");
+  EXPECT_EQ(atLeft, "pong");
+  EXPECT_TRUE(rightEof);
+  EXPECT_TRUE(leftEof);
+  EXPECT_EQ(messages, 0); // never surfaced to user space
+  // Both directions ended: both connections closed on their own
+  EXPECT_EQ(closes, 2);
+  EXPECT_FALSE(a->connected());
+  EXPECT_FALSE(b->connected());
+  EXPECT_EQ(loop.pipePool().idleCount(), 2u); // both pipes drained, reused
+
+  close(left[1]);
+  close(right[1]);
+}
+
+TEST_P(TcpConnectionTest, RelayBackpressureStopsReading) {
+  EventLoop loop;
+  int left[2];
+  int right[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, left), 0);
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, right), 0);
+
+  auto a = std::make_shared<TcpConnection>(&loop, "a", left[0],
+                                           InetAddress(8080),
+                                           InetAddress(9090));
+  auto b = std::make_shared<TcpConnection>(&loop, "b", right[0],
+                                           InetAddress(8081),
+                                           InetAddress(9091));
+  for (auto *c : {&a, &b}) {
+    (*c)->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+    (*c)->setCloseCallback([](const TcpConnectionPtr &) {});
+    (*c)->connectEstablished();
+  }
+  if (!a->relayTo(b)) {
+    close(left[1]);
+    close(right[1]);
+    a->connectDestroyed();
+    b->connectDestroyed();
+    GTEST_SKIP() << "splice() relay not supported here";
+  }
+
+  // The right side doesn't read: the flood must stall once the sockets
+  // and the pipe are full, not pile up anywhere in between
+  const std::string chunk(64 * 1024, 'r');
+  size_t offered = 0;
+  size_t stalls = 0;
+  TimerId writer = loop.runEvery(std::chrono::milliseconds(2), [&] {
+    ssize_t n;
+    bool wrote = false;
+    while ((n = write(left[1], chunk.data(), chunk.size())) > 0) {
+      offered += n;
+      wrote = true;
+    }
+    if (!wrote && ++stalls == 10) {
+      loop.quit();
+    }
+  });
+  loop.loop();
+  loop.cancel(writer); // `offered` is final from here
+
+  EXPECT_LT(offered, 64 * 1024 * 1024u);
+  EXPECT_LT(a->ioStats().bytesRead, offered); // the rest waits in the socket
+  EXPECT_EQ(a->outputBytes() + b->outputBytes(), 0u);
+
+  // Now drain the right side: everything arrives, reading resumed
+  size_t received = 0;
+  loop.runEvery(std::chrono::milliseconds(1), [&] {
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(right[1], buf, sizeof(buf))) > 0) {
+      received += n;
+    }
+    if (received == offered) {
+      loop.quit();
+    }
+  });
+  loop.loop();
+
+  EXPECT_EQ(received, offered);
+  EXPECT_EQ(a->ioStats().bytesRead, offered);
+
+  close(left[1]);
+  close(right[1]);
+  a->connectDestroyed();
+  b->connectDestroyed();
+}
+
+TEST_P(TcpConnectionTest, RelayKeepsAHighWaterReadThrottle) {
+  EventLoop loop;
+  int left[2];
+  int right[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, left), 0);
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, right), 0);
+
+  auto a = std::make_shared<TcpConnection>(&loop, "a", left[0],
+                                           InetAddress(8080),
+                                           InetAddress(9090));
+  auto b = std::make_shared<TcpConnection>(&loop, "b", right[0],
+                                           InetAddress(8081),
+                                           InetAddress(9091));
+  for (auto *c : {&a, &b}) {
+    (*c)->setMessageCallback([](const TcpConnectionPtr &, Buffer *) {});
+    (*c)->setCloseCallback([](const TcpConnectionPtr &) {});
+    (*c)->connectEstablished();
+  }
+  if (!a->relayTo(b)) {
+    close(left[1]);
+    close(right[1]);
+    a->connectDestroyed();
+    b->connectDestroyed();
+    GTEST_SKIP() << "splice() relay not supported here";
+  }
+
+  // Stall the relay with bytes left in its pipe
+  const std::string chunk(64 * 1024, 'r');
+  size_t offered = 0;
+  size_t stalls = 0;
+  TimerId writer = loop.runEvery(std::chrono::milliseconds(2), [&] {
+    ssize_t n;
+    bool wrote = false;
+    while ((n = write(left[1], chunk.data(), chunk.size())) > 0) {
+      offered += n;
+      wrote = true;
+    }
+    if (!wrote && ++stalls == 10) {
+      loop.quit();
+    }
+  });
+  loop.loop();
+  loop.cancel(writer);
+
+  // `a` goes above its own high-water mark: its reads are throttled
+  a->setThrottleReads(true);
+  a->setWaterMarks(64 * 1024, 0);
+  a->send(std::string(4 * 1024 * 1024, 'a'));
+  ASSERT_TRUE(a->aboveHighWater());
+  const size_t throttledAt = a->ioStats().bytesRead;
+  ASSERT_LT(throttledAt, offered);
+
+  // Draining the right side empties the pipe; the relay must not resume
+  // reading behind the throttle's back
+  size_t received = 0;
+  int idle = 0;
+  TimerId drain = loop.runEvery(std::chrono::milliseconds(1), [&] {
+    char buf[65536];
+    ssize_t n;
+    bool got = false;
+    while ((n = read(right[1], buf, sizeof(buf))) > 0) {
+      received += n;
+      got = true;
+    }
+    if (!got && ++idle == 50) {
+      loop.quit();
+    }
+  });
+  loop.loop();
+  loop.cancel(drain);
+
+  EXPECT_EQ(received, throttledAt);
+  EXPECT_EQ(a->ioStats().bytesRead, throttledAt);
+
+  // Once the left side takes `a`'s output, reads resume
+  loop.runEvery(std::chrono::milliseconds(1), [&] {
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(left[1], buf, sizeof(buf))) > 0) {
+    }
+    while ((n = read(right[1], buf, sizeof(buf))) > 0) {
+      received += n;
+    }
+    if (received == offered) {
+      loop.quit();
+    }
+  });
+  loop.runAfter(std::chrono::seconds(5), [&] { loop.quit(); });
+  loop.loop();
+
+  EXPECT_FALSE(a->aboveHighWater());
+  EXPECT_EQ(received, offered);
+
+  close(left[1]);
+  close(right[1]);
+  a->connectDestroyed();
+  b->connectDestroyed();
+}
+
+TEST_P(TcpConnectionTest, RingInputDeliversLinesAcrossTheWrap) {
+  // Lines are consumed as they complete, so a partial one is always left
+  // behind; with a ring input buffer it wraps instead of being compacted
+  EventLoop loop;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+  auto conn = std::make_shared<TcpConnection>(&loop, "conn-ring", fds[0],
+                                              InetAddress(8080),
+                                              InetAddress(9090));
+  if (!conn->setRingInputBuffer(64 * 1024)) {
+    close(fds[1]);
+    GTEST_SKIP() << "ring buffers unsupported here";
+  }
+  EXPECT_TRUE(conn->ringInputBuffer());
+
+  std::string payload;
+  for (int i = 0; i < 500; ++i) {
+    payload += std::string(100 + i % 700, static_cast<char>('a' + i % 26));
+    payload += '\n';
+  }
+
+  std::string received;
+  size_t lines = 0;
+  conn->setMessageCallback([&](const TcpConnectionPtr &, Buffer *buf) {
+    while (const char *eol = buf->findEOL()) {
+      received.append(buf->peek(), eol + 1);
+      buf->retrieve(eol + 1 - buf->peek());
+      ++lines;
+    }
+    if (received.size() == payload.size()) {
+      loop.quit();
+    }
+  });
+  conn->setCloseCallback([](const TcpConnectionPtr &) {});
+  conn->connectEstablished();
+
+  std::thread writer([&] {
+    // Odd-sized writes so reads rarely end on a line boundary
+    size_t sent = 0;
+    while (sent < payload.size()) {
+      size_t len = std::min<size_t>(1237, payload.size() - sent);
+      ssize_t n = write(fds[1], payload.data() + sent, len);
+      if (n > 0) {
+        sent += n;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  loop.loop();
+  writer.join();
+
+  EXPECT_EQ(lines, 500u);
+  EXPECT_EQ(received, payload);
+  EXPECT_TRUE(conn->ringInputBuffer());
+
+  close(fds[1]);
+  conn->connectDestroyed();
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, TcpConnectionTest,
+                         ::testing::Values(std::string(), std::string("1")));
+
 } // namespace test
 } // namespace hayai
 
@@ -1,7 +1,15 @@
 #include "hayai/net/TcpServer.h"
 #include "hayai/net/EventLoop.h"
 #include "hayai/net/InetAddress.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
 #include <gtest/gtest.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 namespace hayai {
 namespace test {
@@ -59,6 +67,79 @@ TEST_F(TcpServerTest, CallbackSetters) {
   SUCCEED();
 }
 
+TEST_F(TcpServerTest, BroadcastReachesEveryConnection) {
+  EventLoop loop;
+  InetAddress addr(19987);
+  TcpServer server(&loop, addr, "BroadcastServer");
+  server.setIoLoopNum(2);
+
+  constexpr int kClients = 6;
+  std::atomic<int> connected{0};
+  server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+    connected += conn->connected() ? 1 : -1;
+  });
+  server.start();
+
+  const SharedSlice payload =
+      SharedSlice::copyOf(std::string(256 * 1024, 'b'));
+  std::vector<std::string> received(kClients);
+  std::atomic<bool> released{false};
+
+  std::thread clients([&] {
+    sockaddr_in peer{};
+    peer.sin_family = AF_INET;
+    peer.sin_port = htons(19987);
+    peer.sin_addr.s_addr = inet_addr("127.0.0.1");
+    std::vector<int> fds;
+    for (int i = 0; i < kClients; ++i) {
+      int fd = socket(AF_INET, SOCK_STREAM, 0);
+      auto *sa = reinterpret_cast<sockaddr *>(&peer);
+      if (connect(fd, sa, sizeof(peer)) == 0) {
+        fds.push_back(fd);
+      } else {
+        close(fd);
+      }
+    }
+    while (connected < static_cast<int>(fds.size())) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    server.broadcast(payload);
+
+    char buf[65536];
+    for (size_t i = 0; i < fds.size(); ++i) {
+      while (received[i].size() < payload.size()) {
+        ssize_t n = read(fds[i], buf, sizeof(buf));
+        if (n <= 0) {
+          break;
+        }
+        received[i].append(buf, n);
+      }
+    }
+    // Every queue drops its reference once it has written the payload
+    for (int i = 0; i < 2000 && payload.useCount() > 1; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    released = payload.useCount() == 1;
+
+    for (int fd : fds) {
+      close(fd);
+    }
+    while (connected > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    loop.queueInLoop([&] { loop.quit(); });
+  });
+
+  loop.loop();
+  clients.join();
+
+  for (const auto &bytes : received) {
+    EXPECT_EQ(bytes, payload.view());
+  }
+  EXPECT_TRUE(released);
+}
+
 } // namespace test
 } // namespace hayai
 
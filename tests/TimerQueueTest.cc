@@ -0,0 +1,314 @@
+#include "hayai/net/TimerQueue.h"
+#include "hayai/net/EventLoop.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace hayai {
+namespace test {
+
+using Clock = TimerQueue::Clock;
+using std::chrono::hours;
+using std::chrono::milliseconds;
+
+class TimerQueueTest : public ::testing::Test {
+  protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    // Fake time: tests drive the wheel explicitly
+    const Clock::time_point origin_ = Clock::now();
+    Clock::time_point at(int64_t ms) const { return origin_ + milliseconds(ms); }
+};
+
+TEST_F(TimerQueueTest, OneShotFiresAtDeadline) {
+    TimerQueue queue(origin_);
+    int fired = 0;
+    queue.add(at(5), Clock::duration::zero(), [&] { ++fired; });
+    EXPECT_EQ(queue.size(), 1u);
+
+    EXPECT_EQ(queue.expire(at(4)), 0u);
+    EXPECT_EQ(fired, 0);
+    EXPECT_EQ(queue.expire(at(5)), 1u);
+    EXPECT_EQ(fired, 1);
+    EXPECT_TRUE(queue.empty());
+
+    EXPECT_EQ(queue.expire(at(100)), 0u);
+    EXPECT_EQ(fired, 1);
+}
+
+TEST_F(TimerQueueTest, PastDeadlineFiresOnNextExpire) {
+    TimerQueue queue(origin_);
+    queue.expire(at(10));
+    int fired = 0;
+    queue.add(at(3), Clock::duration::zero(), [&] { ++fired; });
+    queue.expire(at(11));
+    EXPECT_EQ(fired, 1);
+}
+
+TEST_F(TimerQueueTest, CancelPreventsFiring) {
+    TimerQueue queue(origin_);
+    int fired = 0;
+    TimerId id = queue.add(at(5), Clock::duration::zero(), [&] { ++fired; });
+    EXPECT_TRUE(id.valid());
+
+    EXPECT_TRUE(queue.cancel(id));
+    EXPECT_FALSE(queue.cancel(id)); // stale
+    EXPECT_TRUE(queue.empty());
+
+    queue.expire(at(10));
+    EXPECT_EQ(fired, 0);
+
+    // The recycled slot gets a new generation
+    TimerId reused =
+        queue.add(at(20), Clock::duration::zero(), [&] { ++fired; });
+    EXPECT_FALSE(queue.cancel(id));
+    queue.expire(at(20));
+    EXPECT_EQ(fired, 1);
+    EXPECT_FALSE(queue.cancel(reused));
+}
+
+TEST_F(TimerQueueTest, RepeatingTimerCancelsItself) {
+    TimerQueue queue(origin_);
+    int fired = 0;
+    TimerId id;
+    id = queue.add(at(10), milliseconds(10), [&] {
+        if (++fired == 3) {
+            EXPECT_TRUE(queue.cancel(id));
+        }
+    });
+
+    for (int ms = 1; ms <= 100; ++ms) {
+        queue.expire(at(ms));
+    }
+    EXPECT_EQ(fired, 3);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST_F(TimerQueueTest, RepeatingTimerSkipsMissedPeriods) {
+    TimerQueue queue(origin_);
+    int fired = 0;
+    queue.add(at(10), milliseconds(10), [&] { ++fired; });
+
+    // One long stall: fires once, then re-arms relative to the new time
+    queue.expire(at(1000));
+    EXPECT_EQ(fired, 1);
+    queue.expire(at(1009));
+    EXPECT_EQ(fired, 1);
+    queue.expire(at(1010));
+    EXPECT_EQ(fired, 2);
+}
+
+TEST_F(TimerQueueTest, FarTimersCascadeToExactTick) {
+    TimerQueue queue(origin_);
+    std::vector<int64_t> firedAt;
+    int64_t now = 0;
+    const int64_t deadlines[] = {63, 64, 65, 4095, 4096, 262145, 3600000};
+    for (int64_t d : deadlines) {
+        queue.add(at(d), Clock::duration::zero(),
+                  [&firedAt, &now] { firedAt.push_back(now); });
+    }
+
+    // Step to each next timeout like the event loop does
+    while (!queue.empty()) {
+        auto wait = queue.nextTimeout(at(now), hours(24));
+        now += wait.count();
+        queue.expire(at(now));
+    }
+    EXPECT_EQ(firedAt, std::vector<int64_t>(std::begin(deadlines),
+                                            std::end(deadlines)));
+}
+
+TEST_F(TimerQueueTest, HugeDelayAfterTheWheelAdvanced) {
+    // Once current_ > 0, current_ + 2^36 lies in the next top-level
+    // window, where the wheel has no slot for it: held in the overflow
+    TimerQueue queue(origin_);
+    queue.expire(at(10));
+    const auto years = std::chrono::duration_cast<Clock::duration>(
+        hours(24 * 365 * 3));
+    const int64_t deadline =
+        std::chrono::duration_cast<milliseconds>(years).count();
+    int fired = 0;
+    TimerId far = queue.add(origin_ + years, Clock::duration::zero(),
+                            [&] { ++fired; });
+    int near = 0;
+    queue.add(at(20), Clock::duration::zero(), [&] { ++near; });
+
+    EXPECT_EQ(queue.expire(at(1000)), 1u);
+    EXPECT_EQ(near, 1);
+    EXPECT_EQ(fired, 0);
+    EXPECT_GT(queue.nextTimeout(at(1000), hours(24)), milliseconds(0));
+    EXPECT_TRUE(queue.cancel(far));
+    EXPECT_TRUE(queue.empty());
+
+    // Added again, it survives the window end and fires at its deadline
+    constexpr int64_t kWindowEnd = (int64_t{1} << 36) - 1;
+    queue.add(origin_ + years, Clock::duration::zero(), [&] { ++fired; });
+    EXPECT_EQ(queue.expire(at(kWindowEnd)), 0u);
+    EXPECT_EQ(queue.expire(at(kWindowEnd + 1)), 0u);
+    EXPECT_EQ(queue.nextTimeout(at(kWindowEnd + 1), hours(24)), hours(24));
+    EXPECT_EQ(queue.expire(at(deadline - 1)), 0u);
+    EXPECT_EQ(fired, 0);
+    EXPECT_EQ(queue.expire(at(deadline)), 1u);
+    EXPECT_EQ(fired, 1);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST_F(TimerQueueTest, TimersAddedOnTheLastTickOfTheWindow) {
+    constexpr int64_t kWindowEnd = (int64_t{1} << 36) - 1;
+    TimerQueue queue(origin_);
+    queue.expire(at(kWindowEnd));
+
+    // Everything ahead lies in the next window; nothing may get lost or
+    // loop
+    int fired = 0;
+    queue.add(at(kWindowEnd + 1000000), Clock::duration::zero(),
+              [&] { ++fired; });
+    EXPECT_EQ(queue.nextTimeout(at(kWindowEnd), hours(24)), milliseconds(1));
+
+    int ticks = 0;
+    TimerId ticker =
+        queue.add(at(kWindowEnd + 1), milliseconds(5), [&] { ++ticks; });
+    queue.add(at(kWindowEnd + 1), Clock::duration::zero(), [&] { ++fired; });
+    EXPECT_EQ(queue.expire(at(kWindowEnd + 1)), 2u);
+    EXPECT_EQ(fired, 1);
+    EXPECT_EQ(queue.expire(at(kWindowEnd + 6)), 1u);
+    EXPECT_EQ(ticks, 2);
+    EXPECT_TRUE(queue.cancel(ticker));
+
+    EXPECT_EQ(queue.expire(at(kWindowEnd + 999999)), 0u);
+    EXPECT_EQ(queue.expire(at(kWindowEnd + 1000000)), 1u);
+    EXPECT_EQ(fired, 2);
+}
+
+TEST_F(TimerQueueTest, TimersNearTheWindowEndNeverFireEarly) {
+    // A deadline past the window end must wait for it, not be cut short
+    constexpr int64_t kWindowEnd = (int64_t{1} << 36) - 1;
+    const int64_t start = kWindowEnd - 4;
+    TimerQueue queue(origin_);
+    queue.expire(at(start));
+
+    std::vector<int64_t> firedAt;
+    int64_t now = start;
+    queue.add(at(start + 10000), Clock::duration::zero(),
+              [&] { firedAt.push_back(now); });
+
+    // A repeating timer crossing the window end keeps its period
+    int64_t lastTick = start;
+    std::vector<int64_t> periods;
+    queue.add(at(start + 3), milliseconds(3), [&] {
+        periods.push_back(now - lastTick);
+        lastTick = now;
+    });
+
+    while (firedAt.empty()) {
+        auto wait = queue.nextTimeout(at(now), hours(24));
+        ASSERT_GT(wait, milliseconds(0));
+        now += wait.count();
+        queue.expire(at(now));
+    }
+    EXPECT_EQ(firedAt, std::vector<int64_t>{start + 10000});
+    ASSERT_FALSE(periods.empty());
+    for (int64_t period : periods) {
+        EXPECT_EQ(period, 3);
+    }
+}
+
+TEST_F(TimerQueueTest, NextTimeoutTracksNearestDeadline) {
+    TimerQueue queue(origin_);
+    EXPECT_EQ(queue.nextTimeout(at(0), milliseconds(10000)),
+              milliseconds(10000));
+
+    queue.add(at(30), Clock::duration::zero(), [] {});
+    TimerId near = queue.add(at(7), Clock::duration::zero(), [] {});
+    EXPECT_EQ(queue.nextTimeout(at(0), milliseconds(10000)), milliseconds(7));
+    EXPECT_EQ(queue.nextTimeout(at(0), milliseconds(5)), milliseconds(5));
+
+    queue.cancel(near);
+    EXPECT_EQ(queue.nextTimeout(at(0), milliseconds(10000)),
+              milliseconds(30));
+    EXPECT_EQ(queue.nextTimeout(at(40), milliseconds(10000)),
+              milliseconds(0));
+}
+
+TEST_F(TimerQueueTest, NextTimeoutNeverOvershoots) {
+    // A far timer's slot may wake the loop early (to cascade), never late
+    TimerQueue queue(origin_);
+    queue.add(at(100000), Clock::duration::zero(), [] {});
+    auto wait = queue.nextTimeout(at(0), hours(24));
+    EXPECT_GT(wait.count(), 0);
+    EXPECT_LE(wait, milliseconds(100000));
+}
+
+TEST_F(TimerQueueTest, ManyRandomTimersFireOnTime) {
+    TimerQueue queue(origin_);
+    constexpr int kTimers = 100000;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int64_t> delay(1, 300000);
+
+    std::vector<int64_t> deadline(kTimers);
+    std::vector<TimerId> ids(kTimers);
+    int64_t now = 0;
+    int64_t late = 0;
+    int fired = 0;
+
+    for (int i = 0; i < kTimers; ++i) {
+        deadline[i] = delay(rng);
+        ids[i] = queue.add(at(deadline[i]), Clock::duration::zero(), [&, i] {
+            late += (now != deadline[i]);
+            ++fired;
+        });
+    }
+    // Cancel every tenth one
+    int cancelled = 0;
+    for (int i = 0; i < kTimers; i += 10) {
+        EXPECT_TRUE(queue.cancel(ids[i]));
+        ++cancelled;
+    }
+
+    while (!queue.empty()) {
+        now += queue.nextTimeout(at(now), hours(24)).count();
+        queue.expire(at(now));
+    }
+    EXPECT_EQ(fired, kTimers - cancelled);
+    EXPECT_EQ(late, 0);
+}
+
+TEST_F(TimerQueueTest, EventLoopRunAfterWakesPoll) {
+    EventLoop loop;
+    int fired = 0;
+    auto start = Clock::now();
+
+    loop.runAfter(milliseconds(20), [&] { ++fired; });
+    loop.runAfter(milliseconds(40), [&] { loop.quit(); });
+    TimerId never = loop.runAfter(milliseconds(30), [&] { fired += 100; });
+    loop.cancel(never);
+    EXPECT_EQ(loop.timerCount(), 2u);
+
+    loop.loop();
+
+    // Without deadline-derived timeouts poll() would sleep 10s
+    auto elapsed = Clock::now() - start;
+    EXPECT_GE(elapsed, milliseconds(40));
+    EXPECT_LT(elapsed, milliseconds(2000));
+    EXPECT_EQ(fired, 1);
+    EXPECT_EQ(loop.timerCount(), 0u);
+}
+
+TEST_F(TimerQueueTest, EventLoopRunEvery) {
+    EventLoop loop;
+    int ticks = 0;
+    TimerId id;
+    id = loop.runEvery(milliseconds(5), [&] {
+        if (++ticks == 4) {
+            loop.cancel(id);
+            loop.quit();
+        }
+    });
+    loop.loop();
+    EXPECT_EQ(ticks, 4);
+    EXPECT_EQ(loop.timerCount(), 0u);
+}
+
+} // namespace test
+} // namespace hayai